@@ -24,6 +24,15 @@
 #error !!! unknown architecture !!!
 #endif
 
+/// @brief Limits of the memory locality tables, from the SRAT and SLIT.
+#define kNumaMaxNodes  (8U)
+#define kNumaMaxRanges (16U)
+#define kNumaMaxCores  (256U)
+
+/// @brief SLIT distances of a node to itself, and to the others when there's no SLIT.
+#define kNumaLocalDistance	(10U)
+#define kNumaRemoteDistance (20U)
+
 namespace OpenNE
 {
 	inline SSizeT rt_hash_seed(const Char* seed, int mul)
@@ -61,7 +70,70 @@ namespace OpenNE
 
 	namespace HAL
 	{
+		/// @brief Memory locality, as the firmware describes it.
+		/// Nodes are numbered in order of discovery, fDomain gives their firmware proximity domain.
+		struct NUMA_TOPOLOGY final
+		{
+			struct
+			{
+				UIntPtr fBase;
+				SizeT	fSize;
+				UInt32	fNode;
+			} fRanges[kNumaMaxRanges];
+
+			SizeT  fRangeCount{0UL};
+			SizeT  fNodeCount{0UL};
+			UInt32 fDomain[kNumaMaxNodes];
+			UInt8  fDistance[kNumaMaxNodes][kNumaMaxNodes];
+			UInt8  fCoreNode[kNumaMaxCores];
+		};
+
+		/// @brief Set the memory locality, before mm_init_bitmap partitions the pages by node.
+		auto mm_set_topology(const NUMA_TOPOLOGY& topology) -> Void;
+
+		/// @brief Node of a core, by APIC ID (or the architecture's equivalent).
+		auto mm_node_of(UInt32 core_id) -> UInt32;
+
+		/// @brief Free pages of a node, zero if it doesn't exist.
+		auto mm_free_pages_of(UInt32 node) -> SizeT;
+
+		/// @brief Owner of a block of frames, see PAGE_FRAME.
+		enum
+		{
+			kPageOwnerNone,
+			kPageOwnerKernel,
+			kPageOwnerUser,
+			kPageOwnerHeap, // mm_new_heap block, its header is the descriptor.
+			kPageOwnerCount,
+		};
+
+		/// @brief Descriptor of a page frame, one per frame of the page allocator.
+		/// fState and fOwner are kept on the first frame of a block, fRefs on every frame.
+		struct PAGE_FRAME final
+		{
+			UInt8  fState;	 // free or used, and the block's order.
+			UInt8  fOwner;	 // kPageOwnerXXX
+			UInt16 fFlags;	 // set by the owner.
+			UInt32 fRefs;	 // mappings sharing the frame copy-on-write, zero when it has one owner.
+			UInt64 fPrivate; // set by the owner.
+		};
+
+		auto mm_init_bitmap(VoidPtr base, SizeT size) -> Bool;
 		auto mm_is_bitmap(VoidPtr ptr) -> Bool;
+		auto mm_resize_bitmap(VoidPtr ptr, SizeT size, Boolean wr, Boolean user) -> Bool;
+		auto mm_size_of_bitmap(VoidPtr ptr) -> SizeT;
+
+		/// @brief Descriptor of the frame holding ptr, in O(1) and without touching the frame.
+		auto mm_frame_of(VoidPtr ptr) -> PAGE_FRAME*;
+
+		/// @brief Frees at least pages pages, returns how many it freed.
+		typedef SizeT (*mm_reclaim_proc)(SizeT pages);
+
+		/// @brief Set what mm_reclaim_idle calls when the allocator runs out of pages.
+		auto mm_set_reclaim(mm_reclaim_proc proc) -> Void;
+
+		/// @brief Run the reclaimer if the allocator runs low on pages, from a safe point only.
+		auto mm_reclaim_idle() -> Bool;
 	}
 } // namespace OpenNE
 
@@ -300,6 +300,20 @@ namespace OpenNE
 									_Input SizeT					   dataSz,
 									_Input const Char* forkName);
 
+		/// @brief Write in place inside the data fork of a page catalog, its data is one extent.
+		/// @return if the drive took the data.
+		_Output Bool WriteCatalogAt(_Input ONEFS_CATALOG_STRUCT* catalog,
+									_Input SizeT				 off,
+									_Input VoidPtr				 data,
+									_Input SizeT				 sz);
+
+		/// @brief Read in place from the data fork of a page catalog, into data.
+		/// @return if the drive gave the data.
+		_Output Bool ReadCatalogAt(_Input ONEFS_CATALOG_STRUCT* catalog,
+								   _Input SizeT					off,
+								   _Input VoidPtr				data,
+								   _Input SizeT					sz);
+
 		_Output Bool Seek(_Input _Output ONEFS_CATALOG_STRUCT* catalog, SizeT off);
 
 		_Output SizeT Tell(_Input _Output ONEFS_CATALOG_STRUCT* catalog);
@@ -0,0 +1,319 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+	File: HalAddressSpaceAMD64.cc
+	Purpose: Address spaces, their PCIDs and the cores which ran them.
+
+------------------------------------------- */
+
+#include <HALKit/AMD64/Processor.h>
+#include <KernelKit/UserProcessScheduler.h>
+
+/// @brief PCIDs of a generation, PCID 0 is the kernel's and is never handed out.
+#define kPCIDCount (4096U)
+
+/// @brief Address spaces tracked at once, the kernel's takes the first slot.
+#define kAddressSpaceCount (kSchedProcessLimitPerTeam * 2)
+
+namespace OpenNE::HAL
+{
+	/***********************************************************************************/
+	/// @brief An address space, fTag holds its generation above its PCID.
+	/***********************************************************************************/
+	struct HAL_ADDRESS_SPACE final
+	{
+		UIntPtr fPML4;
+		UInt64	fTag;
+		UInt64	fCoreMask;	 // APIC ids of the cores which ran it.
+		UInt64	fLoadedMask; // APIC ids which hold translations of its current PCID.
+	};
+
+	STATIC HAL_ADDRESS_SPACE kAddressSpaces[kAddressSpaceCount] = {0};
+	STATIC Bool				 kAddressSpaceLock					= No;
+
+	STATIC UInt64 kPCIDGeneration = 1UL;
+	STATIC UInt64 kPCIDNext		  = 1UL;
+	STATIC Bool	  kHasInvPCID	  = No;
+
+	/***********************************************************************************/
+	/// @brief The calling core's bit inside a core mask.
+	/***********************************************************************************/
+	STATIC UInt64 mmi_core_bit()
+	{
+		UInt32 apic_id = hal_apic_id();
+		return apic_id < 64 ? 1ULL << apic_id : 0UL;
+	}
+
+	/***********************************************************************************/
+	/// @brief Find the address space cr3, optionally tracking it when it's new.
+	/// @return The address space, or nullptr when untracked and the table is full.
+	/***********************************************************************************/
+	STATIC HAL_ADDRESS_SPACE* mmi_address_space_of(VoidPtr cr3, Bool track)
+	{
+		UIntPtr pml4 = (UIntPtr)cr3 & kPageAddressMask;
+
+		if (!pml4)
+			return nullptr;
+
+		for (SizeT index = 0; index < kAddressSpaceCount; ++index)
+		{
+			if (__atomic_load_n(&kAddressSpaces[index].fPML4, __ATOMIC_ACQUIRE) == pml4)
+				return &kAddressSpaces[index];
+		}
+
+		if (!track)
+			return nullptr;
+
+		while (__atomic_test_and_set(&kAddressSpaceLock, __ATOMIC_ACQUIRE))
+			;
+
+		HAL_ADDRESS_SPACE* space = nullptr;
+
+		// the kernel's slot is never handed out.
+		for (SizeT index = 1; index < kAddressSpaceCount; ++index)
+		{
+			if (kAddressSpaces[index].fPML4 == pml4)
+			{
+				space = &kAddressSpaces[index];
+				break;
+			}
+
+			if (!space && kAddressSpaces[index].fPML4 == 0)
+				space = &kAddressSpaces[index];
+		}
+
+		if (space && space->fPML4 != pml4)
+		{
+			space->fTag		   = 0UL;
+			space->fCoreMask   = 0UL;
+			space->fLoadedMask = 0UL;
+
+			__atomic_store_n(&space->fPML4, pml4, __ATOMIC_RELEASE);
+		}
+
+		__atomic_clear(&kAddressSpaceLock, __ATOMIC_RELEASE);
+
+		return space;
+	}
+
+	/***********************************************************************************/
+	/// @brief PCID of an address space, a new one is handed out when its generation is over.
+	/// When the PCIDs run out a new generation starts, so no PCID is shared inside one.
+	/***********************************************************************************/
+	STATIC UInt64 mmi_tag_of(HAL_ADDRESS_SPACE* space)
+	{
+		if (space == &kAddressSpaces[0])
+			return 0UL;
+
+		UInt64 tag = __atomic_load_n(&space->fTag, __ATOMIC_ACQUIRE);
+
+		if ((tag >> 12) == __atomic_load_n(&kPCIDGeneration, __ATOMIC_ACQUIRE))
+			return tag;
+
+		while (__atomic_test_and_set(&kAddressSpaceLock, __ATOMIC_ACQUIRE))
+			;
+
+		tag = space->fTag;
+
+		if ((tag >> 12) != kPCIDGeneration)
+		{
+			if (kPCIDNext == kPCIDCount)
+			{
+				__atomic_add_fetch(&kPCIDGeneration, 1, __ATOMIC_RELEASE);
+				kPCIDNext = 1UL;
+			}
+
+			tag = (kPCIDGeneration << 12) | kPCIDNext;
+			++kPCIDNext;
+
+			// the PCID may hold another space's translations, every core flushes it on first use.
+			__atomic_store_n(&space->fLoadedMask, 0UL, __ATOMIC_RELEASE);
+			__atomic_store_n(&space->fTag, tag, __ATOMIC_RELEASE);
+		}
+
+		__atomic_clear(&kAddressSpaceLock, __ATOMIC_RELEASE);
+
+		return tag;
+	}
+
+	/***********************************************************************************/
+	/// @brief Invalidate translations of a PCID, type 0 is one address, type 1 the whole PCID.
+	/***********************************************************************************/
+	STATIC Void mmi_invpcid(UInt64 type, UInt64 pcid, UIntPtr addr)
+	{
+		struct
+		{
+			UInt64 fPCID;
+			UInt64 fAddress;
+		} desc = {pcid, addr};
+
+		asm volatile("invpcid %0, %1" : : "m"(desc), "r"(type) : "memory");
+	}
+
+	Bool hal_has_pcid() noexcept
+	{
+		return (hal_read_cr4() & kCR4PCIDE) != 0;
+	}
+
+	Bool hal_init_pcid() noexcept
+	{
+		UIntPtr cr3 = (UIntPtr)hal_read_cr3();
+
+		kAddressSpaces[0].fPML4 = cr3 & kPageAddressMask;
+		kAddressSpaces[0].fTag	= 0UL;
+
+		__atomic_fetch_or(&kAddressSpaces[0].fCoreMask, mmi_core_bit(), __ATOMIC_RELEASE);
+		__atomic_fetch_or(&kAddressSpaces[0].fLoadedMask, mmi_core_bit(), __ATOMIC_RELEASE);
+
+		UInt32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+		__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+		if (!(ecx & kCPUFeaturePCID))
+			return No;
+
+		if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+			kHasInvPCID = (ebx & (1 << 10)) != 0;
+
+		// CR4.PCIDE can only be set while running PCID 0.
+		if (cr3 & kCR3PCIDMask)
+			hal_write_cr3((VoidPtr)(cr3 & ~kCR3PCIDMask));
+
+		hal_write_cr4(hal_read_cr4() | kCR4PCIDE);
+
+		return Yes;
+	}
+
+	Bool hal_init_global_pages() noexcept
+	{
+		UInt32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+		__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+		if (!(edx & kCPUFeaturePGE))
+			return No;
+
+		hal_write_cr4(hal_read_cr4() | kCR4PGE);
+
+		return Yes;
+	}
+
+	Void hal_flush_tlb_global() noexcept
+	{
+		UInt64 cr4 = hal_read_cr4();
+
+		if (!(cr4 & kCR4PGE))
+		{
+			hal_flush_tlb();
+			return;
+		}
+
+		// toggling CR4.PGE drops every translation, whatever its PCID.
+		hal_write_cr4(cr4 & ~kCR4PGE);
+		hal_write_cr4(cr4);
+	}
+
+	Void hal_switch_address_space(VoidPtr cr3) noexcept
+	{
+		UInt64 flags = 0UL;
+
+		// the shootdown handler mustn't run between the loaded mask and CR3.
+		asm volatile("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+
+		UInt64			   self	 = mmi_core_bit();
+		HAL_ADDRESS_SPACE* space = mmi_address_space_of(cr3, Yes);
+
+		if (space)
+			__atomic_fetch_or(&space->fCoreMask, self, __ATOMIC_RELEASE);
+
+		if (!hal_has_pcid())
+		{
+			hal_write_cr3(cr3);
+		}
+		else if (!space)
+		{
+			// untracked, borrow PCID 0 and make the kernel flush it when it comes back.
+			__atomic_fetch_and(&kAddressSpaces[0].fLoadedMask, ~self, __ATOMIC_RELEASE);
+			hal_write_cr3((VoidPtr)((UIntPtr)cr3 & kPageAddressMask));
+		}
+		else
+		{
+			UInt64 tag	  = mmi_tag_of(space);
+			Bool   loaded = (__atomic_fetch_or(&space->fLoadedMask, self, __ATOMIC_ACQ_REL) & self) != 0;
+			UInt64 value  = (space->fPML4 & kPageAddressMask) | (tag & kCR3PCIDMask);
+
+			hal_write_cr3((VoidPtr)(loaded ? value | kCR3NoFlush : value));
+		}
+
+		if (flags & (1 << 9))
+			asm volatile("sti");
+	}
+
+	Void hal_invalidate_address_space(VoidPtr cr3, TLB_SHOOTDOWN_RANGES& ranges) noexcept
+	{
+		HAL_ADDRESS_SPACE* space = mmi_address_space_of(cr3, No);
+
+		if (!space)
+			return;
+
+		UInt64 self = mmi_core_bit();
+
+		if (!(__atomic_load_n(&space->fLoadedMask, __ATOMIC_ACQUIRE) & self))
+			return;
+
+		if (!kHasInvPCID)
+		{
+			// flushed when this core loads it again.
+			__atomic_fetch_and(&space->fLoadedMask, ~self, __ATOMIC_RELEASE);
+			return;
+		}
+
+		UInt64 pcid	 = __atomic_load_n(&space->fTag, __ATOMIC_ACQUIRE) & kCR3PCIDMask;
+		SizeT  pages = 0;
+
+		for (SizeT index = 0; index < ranges.fCount; ++index)
+			pages += (ranges.fSize[index] + kPageSize - 1) / kPageSize;
+
+		if (ranges.fFlushAll || pages > kPageFlushThreshold)
+		{
+			mmi_invpcid(1, pcid, 0);
+			return;
+		}
+
+		// a single address invpcid leaves global translations, invlpg doesn't.
+		for (SizeT index = 0; index < ranges.fCount; ++index)
+		{
+			for (UIntPtr addr = ranges.fStart[index]; addr < ranges.fStart[index] + ranges.fSize[index]; addr += kPageSize)
+			{
+				if (addr >= kKernelHalfBase)
+					hal_invl_tlb(reinterpret_cast<VoidPtr>(addr));
+				else
+					mmi_invpcid(0, pcid, addr);
+			}
+		}
+	}
+
+	Void mp_mark_address_space(VoidPtr cr3, UInt32 apic_id) noexcept
+	{
+		HAL_ADDRESS_SPACE* space = mmi_address_space_of(cr3, Yes);
+
+		if (space && apic_id < 64)
+			__atomic_fetch_or(&space->fCoreMask, 1ULL << apic_id, __ATOMIC_RELEASE);
+	}
+
+	UInt64 mp_address_space_cores(VoidPtr cr3) noexcept
+	{
+		HAL_ADDRESS_SPACE* space = mmi_address_space_of(cr3, No);
+		return space ? __atomic_load_n(&space->fCoreMask, __ATOMIC_ACQUIRE) : 0UL;
+	}
+
+	Void mp_forget_address_space(VoidPtr cr3) noexcept
+	{
+		HAL_ADDRESS_SPACE* space = mmi_address_space_of(cr3, No);
+
+		// its PCID isn't handed out again before the next generation.
+		if (space && space != &kAddressSpaces[0])
+			__atomic_store_n(&space->fPML4, 0UL, __ATOMIC_RELEASE);
+	}
+} // namespace OpenNE::HAL
@@ -22,6 +22,12 @@
 #define kAPIC_SIPI_Vector 0x00500
 #define kAPIC_EIPI_Vector 0x00400
 
+#define kAPIC_ID  0x20
+#define kAPIC_EOI 0xB0
+
+/// @brief How long the initiator spins for acknowledgements, before sending the IPI again.
+#define kAPIC_TLB_AckSpin 10000000
+
 #define kAPIC_BASE_MSR		  0x1B
 #define kAPIC_BASE_MSR_BSP	  0x100
 #define kAPIC_BASE_MSR_ENABLE 0x800
@@ -44,6 +50,14 @@ namespace OpenNE::HAL
 		HAL::StackFramePtr mFrame;
 	};
 
+	/// @brief Shootdown in flight, written by the initiator and read by its targets.
+	struct PROCESS_TLB_SHOOTDOWN final
+	{
+		TLB_SHOOTDOWN_RANGES fRanges;
+		VoidPtr				 fCr3;	   // address space of the ranges.
+		UInt64				 fPending; // APIC ids which didn't acknowledge yet.
+	};
+
 	EXTERN_C Void _hal_spin_core(Void);
 
 	STATIC struct PROCESS_APIC_MADT* kMADTBlock = nullptr;
@@ -52,6 +66,11 @@ namespace OpenNE::HAL
 
 	STATIC UIntPtr kApicBaseAddress = 0UL;
 
+	STATIC UInt64				 kSMPCoreMask		 = 0UL;
+	STATIC VoidPtr				 kKernelAddressSpace = nullptr;
+	STATIC PROCESS_TLB_SHOOTDOWN kTLBShootdown;
+	STATIC Bool					 kTLBShootdownLock = No;
+
 	STATIC Int32   kSMPInterrupt						   = 0;
 	STATIC UInt64  kAPICLocales[kSchedProcessLimitPerTeam] = {0};
 	STATIC VoidPtr kRawMADT								   = nullptr;
@@ -147,8 +166,184 @@ namespace OpenNE::HAL
 		}
 	}
 
+	/***********************************************************************************/
+	/// @brief Send a fixed interrupt to a core.
+	/// @param target target APIC adress.
+	/// @param apic_id the core's APIC id.
+	/// @param vector vector interrupt.
+	/***********************************************************************************/
+	Void hal_send_ipi(UInt32 target, UInt32 apic_id, UInt8 vector)
+	{
+		OpenNE::ke_dma_write<UInt32>(target, kAPIC_ICR_High, apic_id << 24);
+		OpenNE::ke_dma_write<UInt32>(target, kAPIC_ICR_Low, 0x00004000 | vector);
+
+		while (OpenNE::ke_dma_read<UInt32>(target, kAPIC_ICR_Low) & 0x1000)
+		{
+			;
+		}
+	}
+
+	/***********************************************************************************/
+	/// @brief APIC id of the calling core.
+	/***********************************************************************************/
+	UInt32 hal_apic_id() noexcept
+	{
+		if (!kApicBaseAddress)
+			return 0;
+
+		return OpenNE::ke_dma_read<UInt32>(kApicBaseAddress, kAPIC_ID) >> 24;
+	}
+
 	STATIC PROCESS_CONTROL_BLOCK kProcessBlocks[kSchedProcessLimitPerTeam] = {0};
 
+	/***********************************************************************************/
+	/// @brief APIC ids of the cores which ran the address space cr3.
+	/// The kernel's address space is shared by every core.
+	/***********************************************************************************/
+	STATIC UInt64 mp_cores_of(VoidPtr cr3, Bool global)
+	{
+		// kernel half translations may be cached by any core, whatever it runs.
+		if (global ||
+			((UIntPtr)cr3 & kPageAddressMask) == ((UIntPtr)kKernelAddressSpace & kPageAddressMask))
+			return kSMPCoreMask;
+
+		return mp_address_space_cores(cr3);
+	}
+
+	/***********************************************************************************/
+	/// @brief Invalidate the ranges on this core, a full flush is cheaper past kPageFlushThreshold pages.
+	/***********************************************************************************/
+	STATIC Void mp_invalidate_ranges(TLB_SHOOTDOWN_RANGES& ranges)
+	{
+		SizeT pages = 0;
+
+		for (SizeT index = 0; index < ranges.fCount; ++index)
+			pages += (ranges.fSize[index] + kPageSize - 1) / kPageSize;
+
+		if (ranges.fFlushAll || pages > kPageFlushThreshold)
+		{
+			if (ranges.fGlobal)
+				hal_flush_tlb_global();
+			else
+				hal_flush_tlb();
+
+			return;
+		}
+
+		for (SizeT index = 0; index < ranges.fCount; ++index)
+		{
+			for (UIntPtr addr = ranges.fStart[index]; addr < ranges.fStart[index] + ranges.fSize[index]; addr += kPageSize)
+				hal_invl_tlb(reinterpret_cast<VoidPtr>(addr));
+		}
+	}
+
+	/***********************************************************************************/
+	/// @brief Run the pending shootdown if it targets this core, then acknowledge it.
+	/// The initiator holds the block until every target acknowledged, so it can't change while our bit is set.
+	/// With PCIDs, a space which isn't loaded here may still have translations tagged with its PCID.
+	/***********************************************************************************/
+	STATIC Void mp_service_tlb_shootdown(Void)
+	{
+		UInt32 self_id = hal_apic_id();
+
+		// a late or repeated IPI, the shootdown it was sent for is over.
+		if (self_id >= 64 ||
+			!(__atomic_load_n(&kTLBShootdown.fPending, __ATOMIC_ACQUIRE) & (1ULL << self_id)))
+			return;
+
+		UIntPtr current = (UIntPtr)hal_read_cr3() & kPageAddressMask;
+
+		if (!hal_has_pcid() || current == ((UIntPtr)kTLBShootdown.fCr3 & kPageAddressMask))
+		{
+			mp_invalidate_ranges(kTLBShootdown.fRanges);
+		}
+		else
+		{
+			hal_invalidate_address_space(kTLBShootdown.fCr3, kTLBShootdown.fRanges);
+
+			// global translations were cached whatever this core runs.
+			if (kTLBShootdown.fRanges.fGlobal)
+				mp_invalidate_ranges(kTLBShootdown.fRanges);
+		}
+
+		__atomic_fetch_and(&kTLBShootdown.fPending, ~(1ULL << self_id), __ATOMIC_RELEASE);
+	}
+
+	/***********************************************************************************/
+	/// @brief Shootdown IPI handler, invalidates then acknowledges.
+	/***********************************************************************************/
+	EXTERN_C Void idt_handle_tlb_shootdown(Void)
+	{
+		mp_service_tlb_shootdown();
+
+		OpenNE::ke_dma_write<UInt32>(kApicBaseAddress, kAPIC_EOI, 0);
+	}
+
+	/***********************************************************************************/
+	/// @brief Invalidate ranges of the address space cr3 on the other cores which ran it.
+	/// @param cr3 the address space.
+	/// @param ranges the ranges to invalidate, coalesced into one IPI per core.
+	/// @return Yes once every targeted core acknowledged, the frames may be freed then.
+	/***********************************************************************************/
+	Bool mp_tlb_shootdown(VoidPtr cr3, TLB_SHOOTDOWN_RANGES& ranges) noexcept
+	{
+		if (!kSMPAware || !kApicBaseAddress || ranges.Empty())
+			return Yes;
+
+		UInt32 self_id = hal_apic_id();
+		UInt64 targets = mp_cores_of(cr3, ranges.fGlobal);
+
+		if (self_id < 64)
+			targets &= ~(1ULL << self_id);
+
+		if (!targets)
+			return Yes;
+
+		// one shootdown at a time, the block is shared with the targets.
+		// the owner may be waiting on us, with interrupts off here its IPI would never be taken.
+		while (__atomic_test_and_set(&kTLBShootdownLock, __ATOMIC_ACQUIRE))
+			mp_service_tlb_shootdown();
+
+		kTLBShootdown.fRanges = ranges;
+		kTLBShootdown.fCr3	  = cr3;
+		__atomic_store_n(&kTLBShootdown.fPending, targets, __ATOMIC_RELEASE);
+
+		for (UInt32 apic_id = 0; apic_id < 64; ++apic_id)
+		{
+			if (targets & (1ULL << apic_id))
+				hal_send_ipi(kApicBaseAddress, apic_id, kTLBShootdownInterruptId);
+		}
+
+		// the frames behind the ranges are freed once we return, so there's no giving up:
+		// a core which is slow to answer gets the IPI again, in case it was lost.
+		Int64 spin	 = kAPIC_TLB_AckSpin;
+		Bool  warned = No;
+
+		while (UInt64 pending = __atomic_load_n(&kTLBShootdown.fPending, __ATOMIC_ACQUIRE))
+		{
+			if (--spin > 0)
+				continue;
+
+			if (!warned)
+			{
+				kout << "SMP: TLB shootdown is slow to be acknowledged, sending it again.\r";
+				warned = Yes;
+			}
+
+			for (UInt32 apic_id = 0; apic_id < 64; ++apic_id)
+			{
+				if (pending & (1ULL << apic_id))
+					hal_send_ipi(kApicBaseAddress, apic_id, kTLBShootdownInterruptId);
+			}
+
+			spin = kAPIC_TLB_AckSpin;
+		}
+
+		__atomic_clear(&kTLBShootdownLock, __ATOMIC_RELEASE);
+
+		return Yes;
+	}
+
 	EXTERN_C HAL::StackFramePtr mp_get_current_context(Int64 pid)
 	{
 		const auto process_index = pid % kSchedProcessLimitPerTeam;
@@ -165,6 +360,9 @@ namespace OpenNE::HAL
 
 		auto first_id = kAPICLocales[0];
 
+		// remember where this address space runs, for TLB shootdowns.
+		mp_mark_address_space(UserProcessScheduler::The().CurrentTeam().AsArray()[process_index].VMRegister, first_id);
+
 		hal_send_sipi(kApicBaseAddress, first_id, (UInt8)(((UIntPtr)stack_frame->BP) >> 12));
 
 		return YES;
@@ -219,7 +417,12 @@ namespace OpenNE::HAL
 
 			kout << "SMP: Starting APs...\r";
 
-			kApicBaseAddress = kMADTBlock->Address;
+			kApicBaseAddress	= kMADTBlock->Address;
+			kKernelAddressSpace = hal_read_cr3();
+			kSMPCoreMask		= 0UL;
+
+			if (hal_apic_id() < 64)
+				kSMPCoreMask |= 1ULL << hal_apic_id();
 
 			constexpr auto kMemoryAPStart = 0x7C000;
 			Char*		   ptr_ap_code	  = reinterpret_cast<Char*>(kMemoryAPStart);
@@ -243,6 +446,9 @@ namespace OpenNE::HAL
 					kAPICLocales[kSMPCount] = kMADTBlock->List[kSMPCount].LAPIC.ProcessorID;
 					kout << "SMP: APIC ID: " << number(kAPICLocales[kSMPCount]) << endl;
 
+					if (kAPICLocales[kSMPCount] < 64)
+						kSMPCoreMask |= 1ULL << kAPICLocales[kSMPCount];
+
 					// I'll just make the AP start from scratch here.
 
 					hal_send_start_ipi(kApicBaseAddress, kAPICLocales[kSMPCount]);
@@ -32,12 +32,44 @@ hal_ap_start:
     or eax, 1 << 5   
     mov cr4, eax
 
+;; global kernel pages like on the boot core, see hal_init_global_pages.
+    mov eax, 1
+    cpuid
+    test edx, 1 << 13
+    jz .hal_ap_start_no_pge
+
+    mov eax, cr4
+    or eax, 1 << 7
+    mov cr4, eax
+.hal_ap_start_no_pge:
+
+;; same PAT as the boot core before paging is on, see kPATValue and mm_init_pat.
+    mov eax, 1
+    cpuid
+    test edx, 1 << 16
+    jz .hal_ap_start_no_pat
+
+    mov ecx, 0x277
+    mov eax, 0x00070406
+    mov edx, 0x00070401
+    wrmsr
+.hal_ap_start_no_pat:
+
     mov eax, cr3
     mov cr3, eax     
 
+;; EFER.NXE too when the CPU has it, else the NX bit of the shared tables is reserved here.
+    mov eax, 0x80000001
+    cpuid
+    mov esi, edx
+
     mov ecx, 0xC0000080 
     rdmsr
     or eax, 1         
+    test esi, 1 << 20
+    jz .hal_ap_start_no_nx
+    or eax, 1 << 11
+.hal_ap_start_no_nx:
     wrmsr
 
     mov eax, cr0
@@ -61,6 +93,21 @@ hal_ap_64bit_entry:
     mov ss, ax
     mov rsp, [hal_ap_64bit_entry_stack_end]
 
+;; PCIDs like on the boot core, see hal_init_pcid, CR4.PCIDE needs long mode and PCID 0.
+    mov eax, 1
+    cpuid
+    test ecx, 1 << 17
+    jz .hal_ap_no_pcid
+
+    mov rax, cr3
+    and rax, ~0xFFF
+    mov cr3, rax
+
+    mov rax, cr4
+    or rax, 1 << 17
+    mov cr4, rax
+.hal_ap_no_pcid:
+
     push 0x33                 
     push qword [hal_ap_64bit_entry_loop]      
     o64 pushf               
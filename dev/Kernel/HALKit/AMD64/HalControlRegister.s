@@ -9,6 +9,8 @@
 .globl hal_read_cr2
 .globl hal_read_cr3
 .globl hal_read_cr0
+.globl hal_read_cr4
+.globl hal_write_cr4
 .globl hal_flush_tlb
 .globl hal_invl_tlb
 
@@ -43,3 +45,11 @@ hal_write_cr3:
 hal_write_cr0:
     movq %rcx, %cr0
     retq
+
+hal_read_cr4:
+    movq %cr4, %rax
+    retq
+
+hal_write_cr4:
+    movq %rcx, %cr4
+    retq
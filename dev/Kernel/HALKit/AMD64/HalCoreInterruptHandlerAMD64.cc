@@ -38,7 +38,7 @@ EXTERN_C void idt_handle_gpf(OpenNE::UIntPtr rsp)
 	process.Leak().Crash();
 }
 
-/// @brief Handle page fault.
+/// @brief Handle page fault, first touches of reserved ranges are backed by a zeroed page.
 /// @param rsp
 EXTERN_C void idt_handle_pf(OpenNE::UIntPtr rsp)
 {
@@ -47,11 +47,16 @@ EXTERN_C void idt_handle_pf(OpenNE::UIntPtr rsp)
 	if (process.Leak().Status != OpenNE::ProcessStatusKind::kRunning)
 		return;
 
+	// demand-zero, the faulting instruction runs again.
+	if (process.Leak().Fault(hal_read_cr2()))
+		return;
+
 	kIsScheduling = NO;
 
 	kout << "KTrace: Page Fault.\r";
 
-	process.Leak().ProcessSignal.SignalArg		= 0UL;
+	// the faulting address, a stack overflow was reported by Fault.
+	process.Leak().ProcessSignal.SignalArg		= (OpenNE::UIntPtr)hal_read_cr2();
 	process.Leak().ProcessSignal.SignalID		= SIGKILL;
 	process.Leak().ProcessSignal.PreviousStatus = process.Leak().Status;
 
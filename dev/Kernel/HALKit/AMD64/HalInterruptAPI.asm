@@ -205,18 +205,50 @@ __OPENNE_INT_13:
     
     o64 iret
 
+;; Page fault, resolved faults (demand-zero, copy-on-write, swap-in, stack growth) resume the faulting code.
+;; It's an exception, not an IRQ: no EOI, every register is saved and the error code is dropped before iretq.
 __OPENNE_INT_14:
     cld
 
-    mov al, 0x20
-    out 0xA0, al
-    out 0x20, al
-
+    push rax
+    push rbx
     push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+
+    ;; error code and 15 registers on top of the aligned frame, 8 more bytes realign the call.
+    mov rcx, rsp
+    sub rsp, 40
     call idt_handle_pf
+    add rsp, 40
+
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rbp
+    pop rdi
+    pop rsi
+    pop rdx
     pop rcx
+    pop rbx
+    pop rax
 
-    std
+    add rsp, 8
 
     o64 iret
 
@@ -327,7 +359,34 @@ IntNormal 52
 IntNormal 53
 IntNormal 54
 IntNormal 55
-IntNormal 56
+
+[extern idt_handle_tlb_shootdown]
+
+;; TLB shootdown IPI, may land anywhere in the kernel so save the volatile registers.
+__OPENNE_INT_56:
+    cld
+
+    push rax
+    push rcx
+    push rdx
+    push r8
+    push r9
+    push r10
+    push r11
+
+    sub rsp, 32
+    call idt_handle_tlb_shootdown
+    add rsp, 32
+
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rdx
+    pop rcx
+    pop rax
+
+    o64 iret
 IntNormal 57
 IntNormal 58
 IntNormal 59
@@ -11,6 +11,7 @@
 #include <Mod/ACPI/ACPIFactoryInterface.h>
 #include <NetworkKit/IPC.h>
 #include <CFKit/Property.h>
+#include <NewKit/PageMgr.h>
 #include <Mod/CoreGfx/TextMgr.h>
 
 EXTERN_C OpenNE::VoidPtr kInterruptVectorTable[];
@@ -61,6 +62,31 @@ EXTERN_C void hal_init_platform(
 	kKernelBitMpStart = reinterpret_cast<OpenNE::VoidPtr>(
 		reinterpret_cast<OpenNE::UIntPtr>(kHandoverHeader->f_BitMapStart));
 
+	// split the pages by NUMA node when the firmware describes them.
+	OpenNE::HAL::NUMA_TOPOLOGY	 topology;
+	OpenNE::ACPIFactoryInterface acpi(kHandoverHeader->f_HardwareTables.f_VendorPtr);
+
+	if (acpi.Topology(topology))
+		OpenNE::HAL::mm_set_topology(topology);
+
+	OpenNE::HAL::mm_init_bitmap(kKernelBitMpStart, kKernelBitMpSize);
+
+	/************************************** */
+	/*     MAP PHYSICAL MEMORY.             */
+	/************************************** */
+
+	OpenNE::HAL::mm_init_direct_map((OpenNE::UIntPtr)kKernelBitMpStart + kKernelBitMpSize);
+
+	// processes share the kernel half from now on, instead of copying it.
+	OpenNE::HAL::mm_init_kernel_half();
+
+	// the framebuffer is written through a write combining buffer, instead of uncached.
+	if (OpenNE::HAL::mm_init_pat() && kHandoverHeader->f_GOP.f_The)
+		OpenNE::HAL::mm_map_range(reinterpret_cast<OpenNE::VoidPtr>(kHandoverHeader->f_GOP.f_The),
+								  reinterpret_cast<OpenNE::VoidPtr>(kHandoverHeader->f_GOP.f_The),
+								  kHandoverHeader->f_GOP.f_Size,
+								  OpenNE::HAL::kMMFlagsPresent | OpenNE::HAL::kMMFlagsWr | OpenNE::HAL::kMMFlagsWC);
+
 	/************************************** */
 	/*     INITIALIZE GDT AND SEGMENTS. */
 	/************************************** */
@@ -95,6 +121,15 @@ EXTERN_C OpenNE::Void hal_real_init(OpenNE::Void) noexcept
 
 	OpenNE::HAL::mp_get_cores(kHandoverHeader->f_HardwareTables.f_VendorPtr);
 
+	// tag the kernel's address space with PCID 0, processes get theirs on first switch.
+	OpenNE::HAL::hal_init_pcid();
+
+	// kernel half translations stay cached across address space switches.
+	OpenNE::HAL::hal_init_global_pages();
+
+	// once out of pages, or short on them when idle, cold process pages are swapped out.
+	OpenNE::HAL::mm_set_reclaim(OpenNE::UserProcessHelper::Reclaim);
+
 	OpenNE::HAL::Register64 idt_reg;
 
 	idt_reg.Base = (OpenNE::UIntPtr)kInterruptVectorTable;
@@ -103,8 +138,13 @@ EXTERN_C OpenNE::Void hal_real_init(OpenNE::Void) noexcept
 
 	idt_loader.Load(idt_reg);
 
+	OpenNE::PageMgr page_mgr;
+
+	// nothing else to do on this core, zero freed pages for the zeroed page reserve.
+	// it also keeps the free pages over the low watermark, reclaim may write to the disk so only this core does it.
 	while (YES)
 	{
-		continue;
+		OpenNE::HAL::mm_reclaim_idle();
+		page_mgr.ZeroIdle();
 	}
 }
@@ -7,6 +7,7 @@
 
 ------------------------------------------- */
 
+#include <ArchKit/ArchKit.h>
 #include <HALKit/AMD64/Paging.h>
 #include <HALKit/AMD64/Processor.h>
 
@@ -14,6 +15,17 @@ namespace OpenNE::HAL
 {
 	typedef UInt32 PageTableIndex;
 
+	/***********************************************************************************/
+	/// \brief Paging levels, a mapping made at kPageLevelPD or kPageLevelPDPT has the PS bit.
+	/***********************************************************************************/
+	enum
+	{
+		kPageLevelPT   = 1,
+		kPageLevelPD   = 2,
+		kPageLevelPDPT = 3,
+		kPageLevelPML4 = 4,
+	};
+
 	/***********************************************************************************/
 	/// \brief Page store type.
 	/***********************************************************************************/
@@ -24,6 +36,7 @@ namespace OpenNE::HAL
 			PDE*	fPde{nullptr};
 			PTE*	fPte{nullptr};
 			VoidPtr fVAddr{nullptr};
+			UInt64	fCr3{0};
 		} fInternalStore;
 
 		Bool fStoreOp{No}; // Store operation is in progress.
@@ -43,6 +56,15 @@ namespace OpenNE::HAL
 			return pte && pte->User;
 		}
 
+		/// @brief Forget the cached entry, to be called when tables are split or replaced.
+		Void Invalidate()
+		{
+			fInternalStore.fPde	  = nullptr;
+			fInternalStore.fPte	  = nullptr;
+			fInternalStore.fVAddr = nullptr;
+			fInternalStore.fCr3	  = 0;
+		}
+
 		static OPENNE_PAGE_STORE& The()
 		{
 			static OPENNE_PAGE_STORE the;
@@ -50,6 +72,79 @@ namespace OpenNE::HAL
 		}
 	};
 
+	/***********************************************************************************/
+	/// \brief Invalidations deferred to the end of a range operation.
+	/// Past kPageFlushThreshold pages, one full flush is cheaper than many invlpg.
+	/// The other cores get the same ranges through one shootdown.
+	/// A full flush of the kernel half has to drop global translations as well.
+	/***********************************************************************************/
+	struct OPENNE_TLB_BATCH final
+	{
+		UIntPtr				 fAddress[kPageFlushThreshold];
+		SizeT				 fCount{0};
+		Bool				 fFlushAll{No};
+		TLB_SHOOTDOWN_RANGES fRemote;
+
+		Void Add(UIntPtr virtual_address)
+		{
+			fRemote.Add(virtual_address, kPageSize);
+
+			if (fFlushAll)
+				return;
+
+			if (fCount == kPageFlushThreshold)
+			{
+				fFlushAll = Yes;
+				return;
+			}
+
+			fAddress[fCount++] = virtual_address;
+		}
+
+		Void FlushAll(UIntPtr virtual_address)
+		{
+			fFlushAll		  = Yes;
+			fRemote.fFlushAll = Yes;
+
+			if (virtual_address >= kKernelHalfBase)
+				fRemote.fGlobal = Yes;
+		}
+
+		Void Commit()
+		{
+			if (fFlushAll)
+			{
+				if (fRemote.fGlobal)
+					hal_flush_tlb_global();
+				else
+					hal_flush_tlb();
+			}
+			else
+			{
+				for (SizeT index = 0; index < fCount; ++index)
+					hal_invl_tlb(reinterpret_cast<VoidPtr>(fAddress[index]));
+			}
+
+			if (!fRemote.Empty())
+				mp_tlb_shootdown(hal_read_cr3(), fRemote);
+
+			fCount	  = 0;
+			fFlushAll = No;
+			fRemote	  = TLB_SHOOTDOWN_RANGES{};
+		}
+	};
+
+	/***********************************************************************************/
+	/// \brief Invalidate a single page on every core using it.
+	/***********************************************************************************/
+	STATIC Void mmi_invalidate_page(UIntPtr virtual_address)
+	{
+		OPENNE_TLB_BATCH batch;
+
+		batch.Add(virtual_address);
+		batch.Commit();
+	}
+
 	/***********************************************************************************/
 	/// \brief Retrieve the page status of a PTE.
 	/// \param pte Page Table Entry pointer.
@@ -64,6 +159,293 @@ namespace OpenNE::HAL
 
 	STATIC Int32 mmi_map_page_table_entry(VoidPtr virtual_address, VoidPtr physical_address, UInt32 flags, OPENNE_PTE* pt_entry, OPENNE_PDE* pd_entry);
 
+	/***********************************************************************************/
+	/// @brief Size covered by one entry of a given level.
+	/***********************************************************************************/
+	STATIC UInt64 mmi_level_size(SizeT level)
+	{
+		return 1ULL << (12 + 9 * (level - 1));
+	}
+
+	STATIC UInt64 mmi_level_index(UIntPtr virtual_address, SizeT level)
+	{
+		return (virtual_address >> (12 + 9 * (level - 1))) & (kPageMax - 1);
+	}
+
+	/// @brief Table pointed to by an entry, reached through the direct map.
+	STATIC UInt64* mmi_table_of(UInt64 entry)
+	{
+		return reinterpret_cast<UInt64*>(mm_phys_to_virt(entry & kPageAddressMask));
+	}
+
+	/// @brief Is PA4 of the PAT write combining? Set by mm_init_pat.
+	STATIC Bool kHasPAT = No;
+
+	/***********************************************************************************/
+	/// @brief Cache bits of the memory type inside flags, PCD and PWT pick PA0-PA3, the PAT bit PA4.
+	/// @param level the level of the entry, the PAT bit is bit 12 on a PS entry.
+	/***********************************************************************************/
+	STATIC UInt64 mmi_type_flags(UInt32 flags, SizeT level)
+	{
+		if (flags & kMMFlagsUC)
+			return kPageFlagWt | kPageFlagCache;
+
+		if (flags & kMMFlagsWC)
+		{
+			// without a PAT, uncached is the closest type which is still correct.
+			if (!kHasPAT)
+				return kPageFlagWt | kPageFlagCache;
+
+			return level > kPageLevelPT ? kPageFlagPATLarge : kPageFlagPAT;
+		}
+
+		if (flags & kMMFlagsWT)
+			return kPageFlagWt;
+
+		return 0;
+	}
+
+	/***********************************************************************************/
+	/// @brief Translate kMMFlags into the access and cache bits of an entry.
+	/***********************************************************************************/
+	STATIC UInt64 mmi_entry_flags(UInt32 flags, SizeT level = kPageLevelPT)
+	{
+		UInt64 entry = kPageFlagPresent;
+
+		if (flags & kMMFlagsWr)
+			entry |= kPageFlagWr;
+
+		if (flags & kMMFlagsUser)
+			entry |= kPageFlagUser;
+
+		if (flags & kMMFlagsNX)
+			entry |= kPageFlagNX;
+
+		if (flags & kMMFlagsGlobal)
+			entry |= kPageFlagGlobal;
+
+		return entry | mmi_type_flags(flags, level);
+	}
+
+	/***********************************************************************************/
+	/// @brief Program the PAT, PA4 becomes write combining.
+	/// Lines cached with the old types are written back before and after the switch.
+	/***********************************************************************************/
+	Bool mm_init_pat() noexcept
+	{
+		UInt32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+		__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+		if (!(edx & kCPUFeaturePAT))
+			return No;
+
+		asm volatile("wbinvd" : : : "memory");
+
+		hal_set_msr(kPATMsr, (UInt32)kPATValue, (UInt32)(kPATValue >> 32));
+
+		asm volatile("wbinvd" : : : "memory");
+
+		hal_flush_tlb_global();
+
+		kHasPAT = Yes;
+
+		return Yes;
+	}
+
+	/***********************************************************************************/
+	/// @brief Does the CPU support 1 GiB pages? (CPUID 0x80000001, EDX bit 26)
+	/***********************************************************************************/
+	STATIC Bool mmi_has_huge_pages()
+	{
+		STATIC Int32 has_huge = -1;
+
+		if (has_huge < 0)
+		{
+			UInt32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+			has_huge = __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (edx & (1 << 26));
+		}
+
+		return has_huge;
+	}
+
+	/***********************************************************************************/
+	/// @brief Allocate a zeroed page table.
+	/// @return The table's physical address, zero if out of memory.
+	/***********************************************************************************/
+	STATIC UInt64 mmi_new_table()
+	{
+		VoidPtr block = mm_alloc_bitmap(Yes, No, kPageSize, Yes);
+
+		if (!block)
+			return 0;
+
+		UInt64* table = mmi_table_of((UInt64)block);
+
+		for (SizeT index = 0; index < kPageMax; ++index)
+			table[index] = 0;
+
+		return (UInt64)block;
+	}
+
+	/***********************************************************************************/
+	/// @brief Release a table made by mmi_new_table, alongside the tables below it.
+	/// Tables which weren't made by us (the boot loader's) are left alone.
+	/***********************************************************************************/
+	STATIC Void mmi_free_table(UInt64* table, SizeT level)
+	{
+		VoidPtr block = reinterpret_cast<VoidPtr>(mm_virt_to_phys(table));
+
+		if (!table || !mm_is_bitmap(block))
+			return;
+
+		if (level > kPageLevelPT)
+		{
+			for (SizeT index = 0; index < kPageMax; ++index)
+			{
+				if ((table[index] & kPageFlagPresent) && !(table[index] & kPageFlagPS))
+					mmi_free_table(mmi_table_of(table[index]), level - 1);
+			}
+		}
+
+		mm_free_bitmap(block);
+	}
+
+	/***********************************************************************************/
+	/// @brief Split a PS entry into a table of 512 smaller pages with the same attributes.
+	/// @param entry the PD or PDPT entry.
+	/// @param level the level of entry.
+	/// @param virtual_address an address inside the page.
+	/***********************************************************************************/
+	STATIC Bool mmi_split_entry(UInt64* entry, SizeT level, UIntPtr virtual_address)
+	{
+		UInt64 table_phys = mmi_new_table();
+
+		if (!table_phys)
+			return No;
+
+		UInt64* table = mmi_table_of(table_phys);
+
+		const UInt64 cSize		= mmi_level_size(level);
+		const UInt64 cChildSize = mmi_level_size(level - 1);
+
+		UInt64 phys	 = *entry & kPageAddressMask & ~(cSize - 1);
+		UInt64 attrs = *entry & ~kPageAddressMask & ~kPageFlagPS;
+
+		// PAT is bit 12 on a PS entry, but bit 7 (PS) on a 4 KiB one.
+		Bool pat = *entry & kPageFlagPATLarge;
+
+		for (SizeT index = 0; index < kPageMax; ++index)
+		{
+			UInt64 child = (phys + index * cChildSize) | attrs;
+
+			if (level - 1 > kPageLevelPT)
+				child |= kPageFlagPS | (pat ? kPageFlagPATLarge : 0);
+			else if (pat)
+				child |= kPageFlagPS;
+
+			table[index] = child;
+		}
+
+		*entry = table_phys | kPageFlagPresent | kPageFlagWr | kPageFlagUser;
+
+		mmi_invalidate_page(virtual_address & ~(cSize - 1));
+
+		OPENNE_PAGE_STORE::The().Invalidate();
+
+		return Yes;
+	}
+
+	/***********************************************************************************/
+	/// @brief Find the entry mapping virtual_address, along with its level.
+	/// @return The leaf entry, nullptr if nothing maps virtual_address.
+	/// level_out is then the level of the missing entry.
+	/***********************************************************************************/
+	STATIC UInt64* mmi_lookup_entry(UIntPtr virtual_address, SizeT* level_out)
+	{
+		UInt64* table = mmi_table_of((UInt64)hal_read_cr3());
+
+		for (SizeT level = kPageLevelPML4; level >= kPageLevelPT; --level)
+		{
+			UInt64* entry = &table[mmi_level_index(virtual_address, level)];
+
+			if (!(*entry & kPageFlagPresent))
+			{
+				if (level_out)
+					*level_out = level;
+
+				return nullptr;
+			}
+
+			if (level == kPageLevelPT ||
+				(level <= kPageLevelPDPT && (*entry & kPageFlagPS)))
+			{
+				if (level_out)
+					*level_out = level;
+
+				return entry;
+			}
+
+			table = mmi_table_of(*entry);
+		}
+
+		return nullptr;
+	}
+
+	/***********************************************************************************/
+	/// @brief Walk down to the entry of virtual_address at target_level.
+	/// Missing tables are made, and bigger pages on the way are split.
+	/// @param cr3 the address space to walk, the current one when null.
+	/***********************************************************************************/
+	STATIC UInt64* mmi_walk_entry(UIntPtr virtual_address, SizeT target_level, VoidPtr cr3 = nullptr)
+	{
+		UInt64* table = mmi_table_of((UInt64)(cr3 ? cr3 : hal_read_cr3()));
+
+		for (SizeT level = kPageLevelPML4; level > target_level; --level)
+		{
+			UInt64* entry = &table[mmi_level_index(virtual_address, level)];
+
+			if (!(*entry & kPageFlagPresent))
+			{
+				UInt64 new_table = mmi_new_table();
+
+				if (!new_table)
+					return nullptr;
+
+				// access is decided by the leaf, keep the upper levels permissive.
+				*entry = new_table | kPageFlagPresent | kPageFlagWr | kPageFlagUser;
+			}
+			else if (*entry & kPageFlagPS)
+			{
+				if (!mmi_split_entry(entry, level, virtual_address))
+					return nullptr;
+			}
+
+			table = mmi_table_of(*entry);
+		}
+
+		return &table[mmi_level_index(virtual_address, target_level)];
+	}
+
+	/***********************************************************************************/
+	/// @brief Is virtual_address already mapped to physical_address with these flags?
+	/// Saves a split when the page is covered by a bigger one which already fits.
+	/***********************************************************************************/
+	STATIC Bool mmi_is_mapped_as(UInt64* entry, SizeT level, UIntPtr virtual_address, UIntPtr physical_address, UInt32 flags)
+	{
+		if (!entry)
+			return No;
+
+		const UInt64 cSize	= mmi_level_size(level);
+		const UInt64 cType	= kPageFlagWt | kPageFlagCache | (level > kPageLevelPT ? kPageFlagPATLarge : kPageFlagPAT);
+		const UInt64 cMask	= kPageFlagPresent | kPageFlagWr | kPageFlagUser | kPageFlagNX | kPageFlagGlobal | cType;
+		UInt64		 target = (*entry & kPageAddressMask & ~(cSize - 1)) + (virtual_address & (cSize - 1));
+
+		return (target & ~(kPageSize - 1)) == (physical_address & ~(kPageSize - 1)) &&
+			   (*entry & cMask) == mmi_entry_flags(flags, level);
+	}
+
 	/***********************************************************************************/
 	/// @brief Maps or allocates a page from virtual_address.
 	/// @param virtual_address a valid virtual address.
@@ -78,50 +460,38 @@ namespace OpenNE::HAL
 			!flags)
 			return 0;
 
-		// Constants for table index bits
-		const UInt64 cPmlIndexMask = 0x1FFULL; // Mask for PML4, PDPT, PD, PT index (9 bits)
-		const UInt64 cPtIndexMask  = 0xFFFULL; // Mask for page table index (12 bits)
-
-		UInt64 cr3 = (UInt64)hal_read_cr3();
-
 		OPENNE_PAGE_STORE& page_store = OPENNE_PAGE_STORE::The();
 
-		// Extract the indices from the virtual address
-		UInt64 pml4_index = ((UIntPtr)virtual_address >> 39) & cPmlIndexMask;
-		UInt64 pdpt_index = ((UIntPtr)virtual_address >> 30) & cPmlIndexMask;
-		UInt64 pd_index	  = ((UIntPtr)virtual_address >> 21) & cPmlIndexMask;
-		UInt64 pt_index	  = ((UIntPtr)virtual_address >> 12) & cPmlIndexMask;
-
 		page_store.fStoreOp = Yes;
 
-		if (page_store.fInternalStore.fVAddr == virtual_address)
+		if (page_store.fInternalStore.fVAddr == virtual_address &&
+			page_store.fInternalStore.fCr3 == (UInt64)hal_read_cr3())
 		{
 			page_store.fStoreOp = No;
 			return mmi_map_page_table_entry(page_store.fInternalStore.fVAddr, physical_address, flags, page_store.fInternalStore.fPte, page_store.fInternalStore.fPde);
 		}
 
-		const auto cPmlEntrySize = 8;
+		SizeT	level	  = 0;
+		UInt64* cur_entry = mmi_lookup_entry((UIntPtr)virtual_address, &level);
 
-		// Read the PML4 entry from memory
-		UInt64 pml4_base  = cr3 & ~cPtIndexMask;					  // CR3 points to the PML4 table base, mask off lower bits
-		UInt64 pml4_entry = (pml4_base + pml4_index * cPmlEntrySize); // Each entry is 8 bytes
-
-		// Read the PDPT entry
-		UInt64 pdpt_base  = pml4_entry & ~cPtIndexMask; // Get the PDPT base physical address
-		UInt64 pdpt_entry = (pdpt_base + pdpt_index * cPmlEntrySize);
+		if (mmi_is_mapped_as(cur_entry, level, (UIntPtr)virtual_address, (UIntPtr)physical_address, flags))
+		{
+			page_store.fStoreOp = No;
+			return 0;
+		}
 
-		// Read the PD entry
-		UInt64 pd_base	= pdpt_entry & ~cPtIndexMask; // Get the Page Directory base physical address
-		UInt64 pd_entry = (pd_base + pd_index * cPmlEntrySize);
+		UInt64* pt_entry = mmi_walk_entry((UIntPtr)virtual_address, kPageLevelPT);
 
-		// Read the PT entry
-		UInt64 pt_base	= pd_entry & ~cPtIndexMask; // Get the Page Table base physical address
-		UInt64 pt_entry = (pt_base + pt_index * cPmlEntrySize);
+		if (!pt_entry)
+		{
+			page_store.fStoreOp = No;
+			return 1;
+		}
 
 		// Lastly, grab the pte entry.
-		OPENNE_PDE* pde_struct = reinterpret_cast<OPENNE_PDE*>(pt_base);
+		OPENNE_PDE* pde_struct = reinterpret_cast<OPENNE_PDE*>((UIntPtr)pt_entry & ~(kPageSize - 1));
 
-		return mmi_map_page_table_entry(virtual_address, physical_address, flags, pde_struct->fEntries[pt_entry], pde_struct);
+		return mmi_map_page_table_entry(virtual_address, physical_address, flags, reinterpret_cast<OPENNE_PTE*>(pt_entry), pde_struct);
 	}
 
 	/***********************************************************************************/
@@ -133,6 +503,8 @@ namespace OpenNE::HAL
 		if (!pt_entry)
 			return 1;
 
+		Bool was_present = pt_entry->Present;
+
 		pt_entry->Present = true;
 
 		if (flags & kMMFlagsWr)
@@ -150,11 +522,25 @@ namespace OpenNE::HAL
 		else if (flags & ~kMMFlagsUser)
 			pt_entry->User = false;
 
-		pt_entry->PhysicalAddress = (UInt32)(UIntPtr)physical_address;
+		if (flags & kMMFlagsGlobal)
+			pt_entry->Global = true;
+		else if (flags & ~kMMFlagsGlobal)
+			pt_entry->Global = false;
+
+		UInt64 type = mmi_type_flags(flags, kPageLevelPT);
+
+		pt_entry->Wt		 = (type & kPageFlagWt) != 0;
+		pt_entry->Cache		 = (type & kPageFlagCache) != 0;
+		pt_entry->MemoryType = (type & kPageFlagPAT) != 0;
 
-		hal_invl_tlb(reinterpret_cast<VoidPtr>(pt_entry));
+		pt_entry->PhysicalAddress = (UIntPtr)physical_address >> 12;
 
+		if (was_present)
+			mmi_invalidate_page((UIntPtr)virtual_address);
+
+#ifdef __DEBUG__
 		mmi_page_status(pt_entry);
+#endif // __DEBUG__
 
 		OPENNE_PAGE_STORE& page_store = OPENNE_PAGE_STORE::The();
 
@@ -163,30 +549,755 @@ namespace OpenNE::HAL
 		page_store.fInternalStore.fPde	 = pd_entry;
 		page_store.fInternalStore.fPte	 = pt_entry;
 		page_store.fInternalStore.fVAddr = virtual_address;
+		page_store.fInternalStore.fCr3	 = (UInt64)hal_read_cr3();
 
 		page_store.fStoreOp = No;
 
 		return 0;
 	}
 
+	/***********************************************************************************/
+	/// @brief Set a PS entry at the level of page_size, queuing its invalidation in batch.
+	/***********************************************************************************/
+	STATIC Int32 mmi_map_large_entry(UIntPtr virtual_address, UIntPtr physical_address, UInt32 flags, SizeT page_size, OPENNE_TLB_BATCH& batch)
+	{
+		SizeT	level = page_size == kPageSizeHuge ? kPageLevelPDPT : kPageLevelPD;
+		UInt64* entry = mmi_walk_entry(virtual_address, level);
+
+		if (!entry)
+			return 1;
+
+		UInt64 new_entry = (physical_address & kPageAddressMask) | mmi_entry_flags(flags, level) | kPageFlagPS;
+
+		if ((*entry & ~(kPageFlagAccessed | kPageFlagDirty)) == new_entry)
+			return 0;
+
+		Bool was_present = *entry & kPageFlagPresent;
+
+		// the smaller pages which were here are now covered by this one.
+		if (was_present && !(*entry & kPageFlagPS))
+		{
+			UInt64* old_table = mmi_table_of(*entry);
+
+			*entry = new_entry;
+
+			// the old table goes away, so no cached translation may survive.
+			batch.FlushAll(virtual_address);
+			batch.Commit();
+
+			mmi_free_table(old_table, level - 1);
+			OPENNE_PAGE_STORE::The().Invalidate();
+
+			return 0;
+		}
+
+		*entry = new_entry;
+
+		if (was_present)
+			batch.Add(virtual_address);
+
+		return 0;
+	}
+
+	/***********************************************************************************/
+	/// @brief Maps a single page of page_size, with the PS bit for 2 MiB and 1 GiB pages.
+	/// @param virtual_address a virtual address aligned on page_size.
+	/// @param physical_address a physical address aligned on page_size.
+	/// @param flags the flags to put on the page.
+	/// @param page_size kPageSize, kPageSizeLarge or kPageSizeHuge.
+	/// @return Status code of page manipulation process.
+	/***********************************************************************************/
+	EXTERN_C Int32 mm_map_page_sized(VoidPtr virtual_address, VoidPtr physical_address, UInt32 flags, SizeT page_size)
+	{
+		if (page_size == kPageSize)
+			return mm_map_page(virtual_address, physical_address, flags);
+
+		if (!flags ||
+			(page_size != kPageSizeLarge && page_size != kPageSizeHuge) ||
+			(page_size == kPageSizeHuge && !mmi_has_huge_pages()) ||
+			((UIntPtr)virtual_address & (page_size - 1)) ||
+			((UIntPtr)physical_address & (page_size - 1)))
+			return 1;
+
+		OPENNE_TLB_BATCH batch;
+
+		Int32 ret = mmi_map_large_entry((UIntPtr)virtual_address, (UIntPtr)physical_address, flags, page_size, batch);
+		batch.Commit();
+
+		return ret;
+	}
+
+	/***********************************************************************************/
+	/// @brief Maps a range, with the biggest pages the alignment allows.
+	/// Tables are walked once per run of 4 KiB pages, and invalidation happens once at the end.
+	/// @param virtual_address start of the range, rounded down to a page.
+	/// @param physical_address start of the physical range, same page offset as virtual_address.
+	/// @param size size of the range in bytes.
+	/// @param flags the flags to put on the pages.
+	/// @return Status code of page manipulation process.
+	/***********************************************************************************/
+	EXTERN_C Int32 mm_map_range(VoidPtr virtual_address, VoidPtr physical_address, SizeT size, UInt32 flags)
+	{
+		if (!size || !flags ||
+			((UIntPtr)virtual_address & (kPageSize - 1)) != ((UIntPtr)physical_address & (kPageSize - 1)))
+			return 1;
+
+		UIntPtr virt = (UIntPtr)virtual_address & ~(kPageSize - 1);
+		UIntPtr phys = (UIntPtr)physical_address & ~(kPageSize - 1);
+		UIntPtr end	 = ((UIntPtr)virtual_address + size + kPageSize - 1) & ~(kPageSize - 1);
+
+		OPENNE_TLB_BATCH batch;
+		Int32			 ret = 0;
+
+		while (virt < end)
+		{
+			SizeT page_size = mm_fit_page_size(virt, phys, end - virt);
+
+			if (page_size != kPageSize)
+			{
+				if (mmi_map_large_entry(virt, phys, flags, page_size, batch))
+				{
+					ret = 1;
+					break;
+				}
+
+				virt += page_size;
+				phys += page_size;
+
+				continue;
+			}
+
+			SizeT	level	  = 0;
+			UInt64* cur_entry = mmi_lookup_entry(virt, &level);
+
+			// already covered by a bigger page which fits, don't split it.
+			if (level > kPageLevelPT && mmi_is_mapped_as(cur_entry, level, virt, phys, flags))
+			{
+				SizeT skip = mmi_level_size(level) - (virt & (mmi_level_size(level) - 1));
+
+				virt += skip;
+				phys += skip;
+
+				continue;
+			}
+
+			UInt64* pt_entry = mmi_walk_entry(virt, kPageLevelPT);
+
+			if (!pt_entry)
+			{
+				ret = 1;
+				break;
+			}
+
+			// fill this page table up to its end, or the end of the range.
+			do
+			{
+				UInt64 new_entry = (phys & kPageAddressMask) | mmi_entry_flags(flags);
+
+				if ((*pt_entry & ~(kPageFlagAccessed | kPageFlagDirty)) != new_entry)
+				{
+					if (*pt_entry & kPageFlagPresent)
+						batch.Add(virt);
+
+					*pt_entry = new_entry;
+				}
+
+				++pt_entry;
+
+				virt += kPageSize;
+				phys += kPageSize;
+			} while (virt < end && mmi_level_index(virt, kPageLevelPT) != 0);
+		}
+
+		batch.Commit();
+
+		OPENNE_PAGE_STORE::The().Invalidate();
+
+		return ret;
+	}
+
+	/***********************************************************************************/
+	/// @brief Unmaps a range, big pages only partially covered are split first.
+	/// @param virtual_address start of the range, rounded down to a page.
+	/// @param size size of the range in bytes.
+	/// @return Status code of page manipulation process.
+	/***********************************************************************************/
+	EXTERN_C Int32 mm_unmap_range(VoidPtr virtual_address, SizeT size)
+	{
+		if (!size)
+			return 1;
+
+		UIntPtr virt = (UIntPtr)virtual_address & ~(kPageSize - 1);
+		UIntPtr end	 = ((UIntPtr)virtual_address + size + kPageSize - 1) & ~(kPageSize - 1);
+
+		OPENNE_TLB_BATCH batch;
+		Int32			 ret = 0;
+
+		while (virt < end)
+		{
+			SizeT	level = 0;
+			UInt64* entry = mmi_lookup_entry(virt, &level);
+
+			const UInt64 cSize = mmi_level_size(level);
+
+			// nothing is mapped at this level, skip what it covers.
+			if (!entry)
+			{
+				virt = (virt & ~(cSize - 1)) + cSize;
+				continue;
+			}
+
+			if (level > kPageLevelPT)
+			{
+				if (!(virt & (cSize - 1)) && end - virt >= cSize)
+				{
+					*entry = 0;
+					batch.Add(virt);
+
+					virt += cSize;
+					continue;
+				}
+
+				if (!mmi_split_entry(entry, level, virt))
+				{
+					ret = 1;
+					break;
+				}
+
+				continue;
+			}
+
+			do
+			{
+				if (*entry & kPageFlagPresent)
+					batch.Add(virt);
+
+				// swapped entries go away too, they mustn't outlive the range.
+				*entry = 0;
+
+				++entry;
+				virt += kPageSize;
+			} while (virt < end && mmi_level_index(virt, kPageLevelPT) != 0);
+		}
+
+		batch.Commit();
+
+		OPENNE_PAGE_STORE::The().Invalidate();
+
+		return ret;
+	}
+
+	/***********************************************************************************/
+	/// @brief Mappings of a bitmap frame shared copy-on-write, zero when it has one owner.
+	/// The count is kept in the frame's descriptor.
+	/***********************************************************************************/
+	STATIC UInt32* mmi_cow_ref_of(UIntPtr frame)
+	{
+		PAGE_FRAME* descriptor = mm_frame_of(reinterpret_cast<VoidPtr>(frame));
+
+		if (!descriptor)
+			return nullptr;
+
+		return &descriptor->fRefs;
+	}
+
+	EXTERN_C Int32 mm_cow_range(VoidPtr src, VoidPtr dst_space, VoidPtr dst, SizeT size)
+	{
+		if (!size || ((UIntPtr)src & (kPageSize - 1)) || ((UIntPtr)dst & (kPageSize - 1)))
+			return 1;
+
+		// a space which isn't loaded here is invalidated by its PCID, see hal_invalidate_address_space.
+		const Bool cDstCurrent = !dst_space ||
+								 ((UIntPtr)dst_space & kPageAddressMask) == ((UIntPtr)hal_read_cr3() & kPageAddressMask);
+
+		OPENNE_TLB_BATCH	 batch;
+		TLB_SHOOTDOWN_RANGES dst_stale;
+		Int32				 ret = 0;
+
+		for (SizeT offset = 0; offset < size; offset += kPageSize)
+		{
+			UIntPtr virt  = (UIntPtr)src + offset;
+			SizeT	level = 0;
+
+			// unbacked pages stay unbacked on both sides, swapped ones must be read back first.
+			if (!mmi_lookup_entry(virt, &level))
+			{
+				if (mm_is_swapped(reinterpret_cast<VoidPtr>(virt)))
+				{
+					ret = 1;
+					break;
+				}
+
+				continue;
+			}
+
+			UInt64* src_entry = mmi_walk_entry(virt, kPageLevelPT);
+			UInt64	frame	  = *src_entry & kPageAddressMask;
+			UInt32* refs	  = mmi_cow_ref_of(frame);
+
+			if (!refs)
+			{
+				ret = 1;
+				break;
+			}
+
+			UInt64* dst_entry = mmi_walk_entry((UIntPtr)dst + offset, kPageLevelPT, dst_space);
+
+			if (!dst_entry)
+			{
+				ret = 1;
+				break;
+			}
+
+			// both owners read the frame until one of them writes.
+			if (*src_entry & kPageFlagWr)
+			{
+				*src_entry = (*src_entry & ~kPageFlagWr) | kPageFlagCOW;
+				batch.Add(virt);
+			}
+
+			if (*dst_entry & kPageFlagPresent)
+			{
+				if (cDstCurrent)
+					batch.Add((UIntPtr)dst + offset);
+				else
+					dst_stale.Add((UIntPtr)dst + offset, kPageSize);
+			}
+
+			*dst_entry = *src_entry & ~(kPageFlagAccessed | kPageFlagDirty);
+
+			UInt32 expected = 0;
+
+			if (!__atomic_compare_exchange_n(refs, &expected, 2, No, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				__atomic_add_fetch(refs, 1, __ATOMIC_ACQ_REL);
+		}
+
+		batch.Commit();
+
+		if (!dst_stale.Empty())
+		{
+			hal_invalidate_address_space(dst_space, dst_stale);
+			mp_tlb_shootdown(dst_space, dst_stale);
+		}
+
+		OPENNE_PAGE_STORE::The().Invalidate();
+
+		return ret;
+	}
+
+	Bool mm_cow_fault(VoidPtr virtual_address)
+	{
+		UIntPtr virt  = (UIntPtr)virtual_address & ~(kPageSize - 1);
+		SizeT	level = 0;
+
+		UInt64* entry = mmi_lookup_entry(virt, &level);
+
+		if (!entry || level != kPageLevelPT || !(*entry & kPageFlagCOW))
+			return No;
+
+		UInt64	frame = *entry & kPageAddressMask;
+		UInt32* refs  = mmi_cow_ref_of(frame);
+
+		// the last owner keeps the frame.
+		if (!refs || __atomic_load_n(refs, __ATOMIC_ACQUIRE) <= 1)
+		{
+			if (refs)
+				__atomic_store_n(refs, 0, __ATOMIC_RELEASE);
+
+			*entry = (*entry & ~kPageFlagCOW) | kPageFlagWr;
+			mmi_invalidate_page(virt);
+
+			return Yes;
+		}
+
+		VoidPtr copy = mm_alloc_bitmap(Yes, Yes, kPageSize, Yes);
+
+		if (!copy)
+			return No;
+
+		UInt64* from = reinterpret_cast<UInt64*>(mm_phys_to_virt(frame));
+		UInt64* to	 = reinterpret_cast<UInt64*>(mm_phys_to_virt((UIntPtr)copy));
+
+		for (SizeT index = 0; index < kPageSize / sizeof(UInt64); ++index)
+			to[index] = from[index];
+
+		*entry = ((UIntPtr)copy & kPageAddressMask) | (*entry & ~kPageAddressMask & ~kPageFlagCOW) | kPageFlagWr;
+		mmi_invalidate_page(virt);
+
+		mm_put_frame(reinterpret_cast<VoidPtr>(frame));
+
+		return Yes;
+	}
+
+	EXTERN_C Int32 mm_protect_page(VoidPtr virtual_address, UInt32 flags)
+	{
+		UIntPtr virt  = (UIntPtr)virtual_address & ~(kPageSize - 1);
+		SizeT	level = 0;
+
+		UInt64* entry = mmi_lookup_entry(virt, &level);
+
+		if (!entry)
+			return 1;
+
+		UInt64 old = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+		UInt64 access;
+
+		do
+		{
+			access = old & ~(kPageFlagWr | kPageFlagUser | kPageFlagNX);
+
+			if (flags & kMMFlagsUser)
+				access |= kPageFlagUser;
+
+#ifdef __OPENNE_SUPPORT_NX__
+			if (flags & kMMFlagsNX)
+				access |= kPageFlagNX;
+#endif // __OPENNE_SUPPORT_NX__
+
+			// a shared page becomes writable through mm_cow_fault, a read-only one stops being shared.
+			if (!(flags & kMMFlagsWr))
+				access &= ~kPageFlagCOW;
+			else if (!(old & kPageFlagCOW))
+				access |= kPageFlagWr;
+		} while (!__atomic_compare_exchange_n(entry, &old, access, No, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+		if (access == old)
+			return 0;
+
+		OPENNE_TLB_BATCH batch;
+
+		batch.Add(virt);
+		batch.Commit();
+
+		return 0;
+	}
+
+	Bool mm_put_frame(VoidPtr frame)
+	{
+		UInt32* refs = mmi_cow_ref_of((UIntPtr)frame);
+
+		if (refs && __atomic_load_n(refs, __ATOMIC_ACQUIRE) > 0)
+		{
+			// the share ends with one owner left, which keeps the frame.
+			UInt32 left = __atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL);
+
+			if (left > 0)
+			{
+				if (left == 1)
+					__atomic_store_n(refs, 0, __ATOMIC_RELEASE);
+
+				return No;
+			}
+		}
+
+		return mm_free_bitmap(frame);
+	}
+
+	/***********************************************************************************/
+	/// @brief The 4 KiB entry of virtual_address, present or not.
+	/// @return nullptr if a table is missing or a bigger page covers it.
+	/***********************************************************************************/
+	STATIC UInt64* mmi_leaf_entry(UIntPtr virtual_address)
+	{
+		UInt64* table = mmi_table_of((UInt64)hal_read_cr3());
+
+		for (SizeT level = kPageLevelPML4; level > kPageLevelPT; --level)
+		{
+			UInt64 entry = table[mmi_level_index(virtual_address, level)];
+
+			if (!(entry & kPageFlagPresent) || (entry & kPageFlagPS))
+				return nullptr;
+
+			table = mmi_table_of(entry);
+		}
+
+		return &table[mmi_level_index(virtual_address, kPageLevelPT)];
+	}
+
+	Bool mm_clear_accessed(VoidPtr virtual_address)
+	{
+		UInt64* entry = mmi_leaf_entry((UIntPtr)virtual_address);
+
+		if (!entry || !(__atomic_load_n(entry, __ATOMIC_ACQUIRE) & kPageFlagPresent))
+			return No;
+
+		// no flush, a cached translation only delays the next time the bit is set.
+		return (__atomic_fetch_and(entry, ~kPageFlagAccessed, __ATOMIC_ACQ_REL) & kPageFlagAccessed) != 0;
+	}
+
+	UInt64 mm_swap_out_page(VoidPtr virtual_address)
+	{
+		UIntPtr virt  = (UIntPtr)virtual_address & ~(kPageSize - 1);
+		UInt64* entry = mmi_leaf_entry(virt);
+
+		if (!entry)
+			return 0;
+
+		UInt64 old = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+
+		// shared frames stay, every owner would have to let go of them.
+		if (!(old & kPageFlagPresent) || (old & kPageFlagCOW) || !(old & kPageAddressMask))
+			return 0;
+
+		UInt64 swapped = (old & ~(kPageFlagPresent | kPageFlagAccessed | kPageFlagDirty)) | kPageFlagSwapped | kPageFlagSwapBusy;
+
+		// the CPU may set the dirty bit meanwhile, the page is skipped then.
+		if (!__atomic_compare_exchange_n(entry, &old, swapped, No, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return 0;
+
+		mmi_invalidate_page(virt);
+		OPENNE_PAGE_STORE::The().Invalidate();
+
+		return old & kPageAddressMask;
+	}
+
+	Bool mm_swap_commit(VoidPtr virtual_address, UInt64 frame, Int64 slot)
+	{
+		UInt64* entry = mmi_leaf_entry((UIntPtr)virtual_address);
+
+		if (!entry)
+			return No;
+
+		UInt64 old = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+
+		// faulted back in meanwhile, the frame is in use again.
+		if ((old & kPageFlagPresent) || !(old & kPageFlagSwapBusy) || (old & kPageAddressMask) != frame)
+			return No;
+
+		UInt64 next = slot < 0 ? ((old & ~(kPageFlagSwapped | kPageFlagSwapBusy)) | kPageFlagPresent)
+							   : ((old & ~(kPageAddressMask | kPageFlagSwapBusy)) | (((UInt64)slot << 12) & kPageAddressMask));
+
+		if (!__atomic_compare_exchange_n(entry, &old, next, No, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+			slot < 0)
+			return No;
+
+		mm_put_frame(reinterpret_cast<VoidPtr>(frame));
+
+		return Yes;
+	}
+
+	Bool mm_is_swapped(VoidPtr virtual_address)
+	{
+		UInt64* entry = mmi_leaf_entry((UIntPtr)virtual_address);
+
+		if (!entry)
+			return No;
+
+		UInt64 value = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+
+		return !(value & kPageFlagPresent) && (value & kPageFlagSwapped);
+	}
+
+	Int64 mm_swap_slot(VoidPtr virtual_address)
+	{
+		UInt64* entry = mmi_leaf_entry((UIntPtr)virtual_address);
+
+		if (!entry)
+			return -1;
+
+		UInt64 value = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+
+		if ((value & kPageFlagPresent) || !(value & kPageFlagSwapped) || (value & kPageFlagSwapBusy))
+			return -1;
+
+		return (value & kPageAddressMask) >> 12;
+	}
+
+	Bool mm_swap_in_page(VoidPtr virtual_address, VoidPtr frame)
+	{
+		UInt64* entry = mmi_leaf_entry((UIntPtr)virtual_address);
+
+		if (!entry)
+			return No;
+
+		UInt64 old = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+
+		if ((old & kPageFlagPresent) || !(old & kPageFlagSwapped))
+			return No;
+
+		UInt64 next = (old & ~(kPageFlagSwapped | kPageFlagSwapBusy)) | kPageFlagPresent;
+
+		// still being written out, its frame is taken back as is.
+		if (!(old & kPageFlagSwapBusy))
+		{
+			if (!frame)
+				return No;
+
+			next = (next & ~kPageAddressMask) | ((UIntPtr)frame & kPageAddressMask);
+		}
+
+		return __atomic_compare_exchange_n(entry, &old, next, No, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	}
+
+	/***********************************************************************************/
+	/// @brief Biggest page size usable at virt/phys with size bytes left to map.
+	/// @return kPageSizeHuge, kPageSizeLarge or kPageSize.
+	/***********************************************************************************/
+	SizeT mm_fit_page_size(UIntPtr virtual_address, UIntPtr physical_address, SizeT size)
+	{
+		if (mmi_has_huge_pages() && size >= kPageSizeHuge &&
+			!(virtual_address & (kPageSizeHuge - 1)) && !(physical_address & (kPageSizeHuge - 1)))
+			return kPageSizeHuge;
+
+		if (size >= kPageSizeLarge &&
+			!(virtual_address & (kPageSizeLarge - 1)) && !(physical_address & (kPageSizeLarge - 1)))
+			return kPageSizeLarge;
+
+		return kPageSize;
+	}
+
+	/***********************************************************************************/
+	/// @brief Size of the page which maps virtual_address.
+	/// @return kPageSize, kPageSizeLarge, kPageSizeHuge, or zero if it isn't mapped.
+	/***********************************************************************************/
+	SizeT mm_get_page_size(VoidPtr virtual_address)
+	{
+		SizeT level = 0;
+
+		if (!mmi_lookup_entry((UIntPtr)virtual_address, &level))
+			return 0;
+
+		return mmi_level_size(level);
+	}
+
+	/***********************************************************************************/
+	/// @brief Map physical memory below phys_end at kKernelDirectMapBase, with the biggest pages which fit.
+	/// Page tables are reached through it afterwards.
+	/***********************************************************************************/
+	Int32 mm_init_direct_map(UIntPtr phys_end) noexcept
+	{
+		if (kKernelDirectMapSize)
+			return 0;
+
+		SizeT size = (phys_end + kPageSizeLarge - 1) & ~((UIntPtr)kPageSizeLarge - 1);
+
+		if (!size || size > kKernelDirectMapMax)
+			return 1;
+
+		UInt32 flags = kMMFlagsPresent | kMMFlagsWr | kMMFlagsGlobal;
+
+#ifdef __OPENNE_SUPPORT_NX__
+		flags |= kMMFlagsNX;
+#endif // __OPENNE_SUPPORT_NX__
+
+		Int32 ret = mm_map_range(reinterpret_cast<VoidPtr>(kKernelDirectMapBase), nullptr, size, flags);
+
+		if (ret == 0)
+			kKernelDirectMapSize = size;
+
+		return ret;
+	}
+
+	/// @brief The kernel's PML4, every address space shares its kernel half.
+	STATIC UInt64 kKernelHalfPML4 = 0UL;
+
+	/***********************************************************************************/
+	/// @brief Give every PML4 slot of the kernel half its PDPT, so that these slots never change.
+	/// The PDPTs are then shared by every address space instead of being copied.
+	/***********************************************************************************/
+	Int32 mm_init_kernel_half() noexcept
+	{
+		if (kKernelHalfPML4)
+			return 0;
+
+		UInt64	pml4_phys = (UInt64)hal_read_cr3() & kPageAddressMask;
+		UInt64* pml4	  = mmi_table_of(pml4_phys);
+
+		for (SizeT index = kKernelHalfIndex; index < kPageMax; ++index)
+		{
+			if (pml4[index] & kPageFlagPresent)
+				continue;
+
+			UInt64 table = mmi_new_table();
+
+			if (!table)
+				return 1;
+
+			// not present before, so nothing was cached about it.
+			pml4[index] = table | kPageFlagPresent | kPageFlagWr;
+		}
+
+		kKernelHalfPML4 = pml4_phys;
+
+		return 0;
+	}
+
+	/***********************************************************************************/
+	/// @brief Make an address space, its PML4 points at the kernel's tables.
+	/// @return The PML4 as written to CR3, nullptr if out of memory.
+	/***********************************************************************************/
+	VoidPtr mm_new_address_space() noexcept
+	{
+		UInt64 pml4_phys = mmi_new_table();
+
+		if (!pml4_phys || !kKernelHalfPML4)
+			return reinterpret_cast<VoidPtr>(pml4_phys);
+
+		UInt64* kernel = mmi_table_of(kKernelHalfPML4);
+		UInt64* pml4   = mmi_table_of(pml4_phys);
+
+		// the kernel's lower entries too, its image and the bitmap zone are identity mapped.
+		// the reserve window stays empty, each process reserves its own ranges in it.
+		for (SizeT index = 0; index < kKernelSharedLowIndex; ++index)
+			pml4[index] = kernel[index];
+
+		for (SizeT index = kKernelHalfIndex; index < kPageMax; ++index)
+			pml4[index] = kernel[index];
+
+		return reinterpret_cast<VoidPtr>(pml4_phys);
+	}
+
+	/***********************************************************************************/
+	/// @brief Free an address space made by mm_new_address_space.
+	/// Only the tables it doesn't share with the kernel go away, mapped frames are the caller's.
+	/***********************************************************************************/
+	Void mm_delete_address_space(VoidPtr cr3) noexcept
+	{
+		UInt64 pml4_phys = (UIntPtr)cr3 & kPageAddressMask;
+
+		if (!pml4_phys || pml4_phys == kKernelHalfPML4)
+			return;
+
+		UInt64* pml4   = mmi_table_of(pml4_phys);
+		UInt64* kernel = kKernelHalfPML4 ? mmi_table_of(kKernelHalfPML4) : nullptr;
+
+		for (SizeT index = 0; index < kKernelHalfIndex; ++index)
+		{
+			// the CPU sets the accessed bit of each copy on its own, compare the tables only.
+			if (!(pml4[index] & kPageFlagPresent) ||
+				(kernel && (pml4[index] & kPageAddressMask) == (kernel[index] & kPageAddressMask)))
+				continue;
+
+			mmi_free_table(mmi_table_of(pml4[index]), kPageLevelPDPT);
+		}
+
+		mm_free_bitmap(reinterpret_cast<VoidPtr>(pml4_phys));
+
+		// cached entries may point into the tables just freed.
+		OPENNE_PAGE_STORE::The().Invalidate();
+	}
+
 	UInt64 hal_get_phys_address(VoidPtr virtual_address)
 	{
-		UInt64 addr = (UInt64)virtual_address;
-		UInt64 cr3	= (UInt64)hal_read_cr3();
+		UInt64 addr	 = (UInt64)virtual_address;
+		SizeT  level = 0;
+
+		if (mm_is_direct_mapped(virtual_address))
+			return addr - kKernelDirectMapBase;
 
-		// Extract indices for PML4, PDPT, PD, and PT
-		UInt64 pml4_idx = (addr >> 39) & 0x1FF;
-		UInt64 pdpt_idx = (addr >> 30) & 0x1FF;
-		UInt64 pd_idx	= (addr >> 21) & 0x1FF;
-		UInt64 pt_idx	= (addr >> 12) & 0x1FF;
+		// the bitmap zone is identity mapped by the kernel, only other addresses need a walk.
+		if (addr >= (UIntPtr)kKernelBitMpStart && addr < (UIntPtr)kKernelBitMpStart + kKernelBitMpSize)
+			return addr;
+
+		// Walk PML4, PDPT, PD and PT, stopping early on a 1 GiB or 2 MiB page.
+		UInt64* entry = mmi_lookup_entry(addr, &level);
+
+		if (!entry)
+			return 0;
 
-		// Get PML4 Table
-		UInt64* pml4 = (UInt64*)(cr3 & ~0xFFF);
-		UInt64* pdpt = (UInt64*)(pml4[pml4_idx] & ~0xFFF);
-		UInt64* pd	 = (UInt64*)(pdpt[pdpt_idx] & ~0xFFF);
-		UInt64* pt	 = (UInt64*)(pd[pd_idx] & ~0xFFF);
+		UInt64 page_mask = mmi_level_size(level) - 1;
 
 		// Get Physical Address
-		return (pt[pt_idx] & ~0xFFF) + (addr & 0xFFF);
+		return (*entry & kPageAddressMask & ~page_mask) + (addr & page_mask);
 	}
 } // namespace OpenNE::HAL
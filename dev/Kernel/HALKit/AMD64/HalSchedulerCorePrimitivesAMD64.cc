@@ -6,6 +6,7 @@
 
 #include <HALKit/AMD64/Processor.h>
 #include <KernelKit/UserProcessScheduler.h>
+#include <NewKit/PageMgr.h>
 
 namespace OpenNE
 {
@@ -42,11 +43,14 @@ namespace OpenNE
 
 	/// @brief makes the thread sleep on a loop.
 	/// hooks and hangs thread to prevent code from executing.
+	/// The spare cycles zero freed pages, for the zeroed page reserve.
 	Void mp_hang_thread(HAL::StackFrame* stack)
 	{
+		PageMgr page_mgr;
+
 		while (Yes)
 		{
-			/* Nothing to do, code is spinning */
+			page_mgr.ZeroIdle();
 		}
 	}
 } // namespace OpenNE
@@ -154,6 +154,29 @@ namespace OpenNE::PCI
 		return bar & ~0x0F;
 	}
 
+	/// @brief Identity map a memory BAR, write combining when prefetchable, uncached otherwise.
+	/// @param bar_in the BAR's offset.
+	/// @param sz the size of the range to map.
+	/// @return The BAR's address, nullptr if it's an I/O BAR or couldn't be mapped.
+	VoidPtr Device::MapBar(UInt32 bar_in, SizeT sz)
+	{
+		UInt32	bar	 = pci_read_raw(bar_in & 0xFC, fBus, fDevice, fFunction);
+		UIntPtr addr = this->Bar(bar_in);
+
+		if ((bar & PCI_BAR_IO) || !addr || !sz)
+			return nullptr;
+
+		UInt32 flags = HAL::kMMFlagsPresent | HAL::kMMFlagsWr;
+
+		// registers have side effects on reads, only prefetchable memory may be combined.
+		flags |= (bar & PCI_BAR_PREFETCH) ? HAL::kMMFlagsWC : HAL::kMMFlagsUC;
+
+		if (HAL::mm_map_range(reinterpret_cast<VoidPtr>(addr), reinterpret_cast<VoidPtr>(addr), sz, flags))
+			return nullptr;
+
+		return reinterpret_cast<VoidPtr>(addr);
+	}
+
 	UShort Device::Vendor()
 	{
 		UShort vendor = VendorId();
@@ -30,14 +30,74 @@
 #define kAlign __BIGGEST_ALIGNMENT__
 #endif // !kAlign
 
+/// @brief Sizes of a PD (2 MiB) and a PDPT (1 GiB) mapping, when the PS bit is set.
+#define kPageSizeLarge (0x200000)
+#define kPageSizeHuge  (0x40000000)
+
+/// @brief Above this many pages, a range operation flushes the whole TLB instead of using invlpg.
+#ifndef kPageFlushThreshold
+#define kPageFlushThreshold (32U)
+#endif // !kPageFlushThreshold
+
+/// @brief Bits of a raw paging structure entry.
+#define kPageFlagPresent  (1ULL << 0)
+#define kPageFlagWr		  (1ULL << 1)
+#define kPageFlagUser	  (1ULL << 2)
+#define kPageFlagWt		  (1ULL << 3)
+#define kPageFlagCache	  (1ULL << 4)
+#define kPageFlagAccessed (1ULL << 5)
+#define kPageFlagDirty	  (1ULL << 6)
+#define kPageFlagPS		  (1ULL << 7)
+#define kPageFlagPAT	  (1ULL << 7) // PAT on a 4 KiB entry, PS on the others.
+#define kPageFlagGlobal	  (1ULL << 8)
+#define kPageFlagCOW	  (1ULL << 9)  // available to software, read-only until the first write copies it.
+#define kPageFlagSwapped  (1ULL << 10) // available to software, not present, its address bits hold a swap slot.
+#define kPageFlagSwapBusy (1ULL << 11) // available to software, swapped but its address bits still hold the frame.
+#define kPageFlagPATLarge (1ULL << 12)
+#define kPageFlagNX		  (1ULL << 63)
+
+/// @brief PAT MSR, and the types it gets: WB, WT, UC-, UC, then WC, WT, UC-, UC.
+/// PA0-PA3 keep their reset values, so PWT and PCD mean what they did, PA4 is write combining.
+#define kPATMsr	  (0x277U)
+#define kPATValue (0x0007040100070406ULL)
+
+/// @brief Physical address bits of a raw paging structure entry.
+#define kPageAddressMask (0x000FFFFFFFFFF000ULL)
+
+/// @brief Upper half of the address space, its PML4 entries are the same in every address space.
+#define kKernelHalfBase	 (0xFFFF800000000000ULL)
+#define kKernelHalfIndex (256U)
+
+/// @brief Lower half slots under this one identity map physical memory (the kernel image, the bitmap zone).
+/// Every address space shares them, the slots from there up to the kernel half are its own, see kSchedReserveStart.
+#define kKernelSharedLowIndex (192U)
+
+/// @brief Kernel window mapping physical memory linearly, at phys + kKernelDirectMapBase.
+#define kKernelDirectMapBase (0xFFFF800000000000ULL)
+#define kKernelDirectMapMax	 (0x0000400000000000ULL)
+
+/// @brief Kernel window of virtually contiguous regions, right after the direct map, see RegionMgr.h
+#define kKernelRegionBase (0xFFFFC00000000000ULL)
+#define kKernelRegionMax  (0x0000000400000000ULL)
+
+/// @brief PCID bits of CR3, and the bit which keeps the PCID's translations on a CR3 write.
+#define kCR3PCIDMask (0xFFFULL)
+#define kCR3NoFlush	 (1ULL << 63)
+
+/// @brief CR4 bits, global pages and process-context identifiers.
+#define kCR4PGE	  (1ULL << 7)
+#define kCR4PCIDE (1ULL << 17)
+
 EXTERN_C void hal_flush_tlb();
 EXTERN_C void hal_invl_tlb(OpenNE::VoidPtr addr);
 EXTERN_C void hal_write_cr3(OpenNE::VoidPtr cr3);
 EXTERN_C void hal_write_cr0(OpenNE::VoidPtr bit);
+EXTERN_C void hal_write_cr4(OpenNE::UInt64 cr4);
 
 EXTERN_C OpenNE::VoidPtr hal_read_cr0(); // @brief CPU control register.
 EXTERN_C OpenNE::VoidPtr hal_read_cr2(); // @brief Fault address.
 EXTERN_C OpenNE::VoidPtr hal_read_cr3(); // @brief Page table.
+EXTERN_C OpenNE::UInt64	 hal_read_cr4(); // @brief CPU features control register.
 
 namespace OpenNE::HAL
 {
@@ -88,8 +148,10 @@ namespace OpenNE::HAL
 		OPENNE_PTE* ALIGN(kPageAlign) fEntries[kPageMax];
 	};
 
+	/// @note is_page asks for a raw page, which the caller maps itself (page tables for example).
 	auto mm_alloc_bitmap(Boolean wr, Boolean user, SizeT size, Bool is_page) -> VoidPtr;
 	auto mm_free_bitmap(VoidPtr page_ptr) -> Bool;
+	auto mm_is_bitmap(VoidPtr ptr) -> Bool;
 } // namespace OpenNE::HAL
 
 namespace OpenNE
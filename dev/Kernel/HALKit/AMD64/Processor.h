@@ -41,6 +41,12 @@ EXTERN_C
 /// @brief interrupt for system call.
 #define kKernelInterruptId (0x32)
 
+/// @brief interrupt sent to other cores to invalidate their TLB.
+#define kTLBShootdownInterruptId (0x38)
+
+/// @brief Ranges carried by one shootdown, a full flush is sent past that.
+#define kTLBShootdownMaxRanges (16U)
+
 #define IsActiveLow(FLG)	  (FLG & 2)
 #define IsLevelTriggered(FLG) (FLG & 8)
 
@@ -76,7 +82,11 @@ namespace OpenNE::HAL
 		kMMFlagsWr		= 1 << 1,
 		kMMFlagsUser	= 1 << 2,
 		kMMFlagsNX		= 1 << 3,
-		kMMFlagsCount	= 4,
+		kMMFlagsGlobal	= 1 << 4,
+		kMMFlagsWT		= 1 << 5, // memory types, write-back when none is given.
+		kMMFlagsWC		= 1 << 6,
+		kMMFlagsUC		= 1 << 7,
+		kMMFlagsCount	= 8,
 	};
 
 	struct PACKED Register64 final
@@ -191,6 +201,118 @@ namespace OpenNE::HAL
 	/***********************************************************************************/
 	Void mp_get_cores(VoidPtr vendor_ptr) noexcept;
 
+	/***********************************************************************************/
+	/// @brief Ranges to invalidate on other cores, sent in a single IPI.
+	/***********************************************************************************/
+	struct TLB_SHOOTDOWN_RANGES final
+	{
+		UIntPtr fStart[kTLBShootdownMaxRanges];
+		SizeT	fSize[kTLBShootdownMaxRanges];
+		SizeT	fCount{0};
+		Bool	fFlushAll{No};
+		Bool	fGlobal{No}; // the kernel half is touched, its translations survive a CR3 write.
+
+		/// @brief Queue a range, merging it with the previous one when they touch.
+		Void Add(UIntPtr start, SizeT size)
+		{
+			if (start >= kKernelHalfBase)
+				fGlobal = Yes;
+
+			if (fFlushAll)
+				return;
+
+			if (fCount > 0 && fStart[fCount - 1] + fSize[fCount - 1] == start)
+			{
+				fSize[fCount - 1] += size;
+				return;
+			}
+
+			if (fCount == kTLBShootdownMaxRanges)
+			{
+				fFlushAll = Yes;
+				return;
+			}
+
+			fStart[fCount] = start;
+			fSize[fCount]  = size;
+
+			++fCount;
+		}
+
+		Bool Empty()
+		{
+			return !fFlushAll && fCount == 0;
+		}
+	};
+
+	/***********************************************************************************/
+	/// @brief Invalidate ranges of the address space cr3 on the other cores which ran it.
+	/// @param cr3 the address space.
+	/// @param ranges the ranges to invalidate, coalesced into one IPI per core.
+	/// @return Yes once every targeted core acknowledged, it waits as long as it takes.
+	/***********************************************************************************/
+	Bool mp_tlb_shootdown(VoidPtr cr3, TLB_SHOOTDOWN_RANGES& ranges) noexcept;
+
+	/***********************************************************************************/
+	/// @brief APIC id of the calling core.
+	/***********************************************************************************/
+	UInt32 hal_apic_id() noexcept;
+
+	/***********************************************************************************/
+	/// @brief Enable PCIDs on the calling core, when CPUID reports them.
+	/// @note The caller's address space becomes the kernel's, tagged with PCID 0.
+	/// @return if PCIDs are now enabled.
+	/***********************************************************************************/
+	Bool hal_init_pcid() noexcept;
+
+	/***********************************************************************************/
+	/// @brief Are PCIDs enabled on the calling core?
+	/***********************************************************************************/
+	Bool hal_has_pcid() noexcept;
+
+	/***********************************************************************************/
+	/// @brief Enable global pages on the calling core, when CPUID reports them.
+	/// Kernel half translations then survive CR3 writes.
+	/// @return if global pages are now enabled.
+	/***********************************************************************************/
+	Bool hal_init_global_pages() noexcept;
+
+	/***********************************************************************************/
+	/// @brief Flush every translation of the calling core, global ones included.
+	/***********************************************************************************/
+	Void hal_flush_tlb_global() noexcept;
+
+	/***********************************************************************************/
+	/// @brief Switch the calling core to an address space.
+	/// The space keeps its PCID and translations when it was loaded here before.
+	/// @param cr3 the address space, as written to or read from CR3.
+	/***********************************************************************************/
+	Void hal_switch_address_space(VoidPtr cr3) noexcept;
+
+	/***********************************************************************************/
+	/// @brief Invalidate ranges of an address space which isn't the calling core's.
+	/// @param cr3 the address space.
+	/// @param ranges the ranges to invalidate.
+	/***********************************************************************************/
+	Void hal_invalidate_address_space(VoidPtr cr3, TLB_SHOOTDOWN_RANGES& ranges) noexcept;
+
+	/***********************************************************************************/
+	/// @brief Remember that a core runs the address space cr3, for TLB shootdowns.
+	/// @param cr3 the address space.
+	/// @param apic_id the core's APIC id.
+	/***********************************************************************************/
+	Void mp_mark_address_space(VoidPtr cr3, UInt32 apic_id) noexcept;
+
+	/***********************************************************************************/
+	/// @brief APIC ids of the cores which ran the address space cr3.
+	/***********************************************************************************/
+	UInt64 mp_address_space_cores(VoidPtr cr3) noexcept;
+
+	/***********************************************************************************/
+	/// @brief Drop the address space cr3, before its PML4 is freed.
+	/***********************************************************************************/
+	Void mp_forget_address_space(VoidPtr cr3) noexcept;
+
 	/***********************************************************************************/
 	/// @brief Do a cpuid to check if MSR exists on CPU.
 	/// @retval true it does exists.
@@ -236,6 +358,25 @@ namespace OpenNE::HAL
 	/// @internal
 	UInt64 hal_get_phys_address(VoidPtr virtual_address);
 
+	/// @brief Map physical memory below phys_end into the kernel's direct map.
+	/// @return Status code of page manip.
+	Int32 mm_init_direct_map(UIntPtr phys_end) noexcept;
+
+	/// @brief Program the PAT of the calling core, so that kMMFlagsWC is write combining.
+	/// @return if the CPU has a PAT, kMMFlagsWC is uncached otherwise.
+	Bool mm_init_pat() noexcept;
+
+	/// @brief Give each PML4 slot of the kernel half its table, shared by every address space.
+	/// @return Status code of page manip.
+	Int32 mm_init_kernel_half() noexcept;
+
+	/// @brief Make an address space which shares the kernel's tables.
+	/// @return The PML4, nullptr if out of memory.
+	VoidPtr mm_new_address_space() noexcept;
+
+	/// @brief Free an address space made by mm_new_address_space, the kernel's tables stay.
+	Void mm_delete_address_space(VoidPtr cr3) noexcept;
+
 	/// @brief Processor specific namespace.
 	namespace Detail
 	{
@@ -301,6 +442,66 @@ namespace OpenNE::HAL
 	/// @return Status code of page manip.
 	EXTERN_C Int32 mm_map_page(VoidPtr virtual_address, VoidPtr physical_address, UInt32 flags);
 
+	/// @brief Maps a single page of page_size, splitting or replacing what was there.
+	/// @param page_size kPageSize, kPageSizeLarge or kPageSizeHuge.
+	/// @return Status code of page manip.
+	EXTERN_C Int32 mm_map_page_sized(VoidPtr virtual_address, VoidPtr physical_address, UInt32 flags, SizeT page_size);
+
+	/// @brief Maps a range with a single walk per run of pages and one batched TLB invalidation.
+	/// @return Status code of page manip.
+	EXTERN_C Int32 mm_map_range(VoidPtr virtual_address, VoidPtr physical_address, SizeT size, UInt32 flags);
+
+	/// @brief Unmaps a range, with one batched TLB invalidation.
+	/// @return Status code of page manip.
+	EXTERN_C Int32 mm_unmap_range(VoidPtr virtual_address, SizeT size);
+
+	/// @brief Share the pages of src, in the current address space, with dst copy-on-write.
+	/// @param dst_space the address space of dst, the current one when null.
+	/// @return Status code of page manip.
+	EXTERN_C Int32 mm_cow_range(VoidPtr src, VoidPtr dst_space, VoidPtr dst, SizeT size);
+
+	/// @brief Change the access flags (kMMFlagsWr, kMMFlagsUser, kMMFlagsNX) of a mapped page, and shoot it down.
+	/// The frame, the cache type and the global bit stay as they are.
+	/// @return Status code of page manip.
+	EXTERN_C Int32 mm_protect_page(VoidPtr virtual_address, UInt32 flags);
+
+	/// @brief Resolve a write fault on a copy-on-write page.
+	/// @return if virtual_address was copy-on-write and is now writable.
+	Bool mm_cow_fault(VoidPtr virtual_address);
+
+	/// @brief Drop a mapping's reference to a frame, it is freed along with the last one.
+	/// @return if the frame was freed.
+	Bool mm_put_frame(VoidPtr frame);
+
+	/// @brief Clear the accessed bit of a 4 KiB page.
+	/// @return if the page was accessed since the last call.
+	Bool mm_clear_accessed(VoidPtr virtual_address);
+
+	/// @brief Unmap a 4 KiB page to write it out, its entry holds the frame until mm_swap_commit.
+	/// @return The frame to write out, zero if the page can't be swapped.
+	UInt64 mm_swap_out_page(VoidPtr virtual_address);
+
+	/// @brief End a swap out, the entry keeps slot and the frame is put unless the page was touched meanwhile.
+	/// @param slot the swap slot written, negative if the write failed and the page is mapped again.
+	/// @return if the frame was put.
+	Bool mm_swap_commit(VoidPtr virtual_address, UInt64 frame, Int64 slot);
+
+	/// @brief Is virtual_address swapped out, or being swapped out?
+	Bool mm_is_swapped(VoidPtr virtual_address);
+
+	/// @brief Swap slot holding virtual_address, -1 if it isn't swapped out (yet).
+	Int64 mm_swap_slot(VoidPtr virtual_address);
+
+	/// @brief Map a swapped page again, with the frame it still holds or else with frame.
+	/// @return if the page is mapped again.
+	Bool mm_swap_in_page(VoidPtr virtual_address, VoidPtr frame);
+
+	/// @brief Biggest page size usable at virt/phys with size bytes left to map.
+	SizeT mm_fit_page_size(UIntPtr virtual_address, UIntPtr physical_address, SizeT size);
+
+	/// @brief Size of the page which maps virtual_address, zero if it isn't mapped.
+	SizeT mm_get_page_size(VoidPtr virtual_address);
+
 	EXTERN_C UInt8	rt_in8(UInt16 port);
 	EXTERN_C UInt16 rt_in16(UInt16 port);
 	EXTERN_C UInt32 rt_in32(UInt16 port);
@@ -327,3 +528,27 @@ EXTERN_C ATTRIBUTE(naked) OpenNE::Void hal_load_gdt(OpenNE::HAL::RegisterGDT ptr
 
 inline OpenNE::VoidPtr kKernelBitMpStart = nullptr;
 inline OpenNE::UIntPtr kKernelBitMpSize	 = 0UL;
+
+/// @brief Physical memory reachable through the direct map, zero until it's built.
+inline OpenNE::UIntPtr kKernelDirectMapSize = 0UL;
+
+namespace OpenNE::HAL
+{
+	/// @brief Kernel pointer to a physical address, identity until the direct map is built.
+	inline VoidPtr mm_phys_to_virt(UIntPtr phys) noexcept
+	{
+		return reinterpret_cast<VoidPtr>(phys < kKernelDirectMapSize ? phys + kKernelDirectMapBase : phys);
+	}
+
+	/// @brief Is virt a pointer of the direct map?
+	inline Bool mm_is_direct_mapped(VoidPtr virt) noexcept
+	{
+		return (UIntPtr)virt - kKernelDirectMapBase < kKernelDirectMapSize;
+	}
+
+	/// @brief Physical address of a pointer given by mm_phys_to_virt.
+	inline UIntPtr mm_virt_to_phys(VoidPtr virt) noexcept
+	{
+		return mm_is_direct_mapped(virt) ? (UIntPtr)virt - kKernelDirectMapBase : (UIntPtr)virt;
+	}
+} // namespace OpenNE::HAL
@@ -54,7 +54,7 @@ STATIC Lba kCurrentDiskSectorCount = 0UL;
 STATIC Char kCurrentDiskModel[50]  = {"UNKNOWN SATA DRIVE"};
 
 template <BOOL Write, BOOL CommandOrCTRL, BOOL Identify>
-static Void drvi_std_input_output(UInt64 lba, UInt8* buffer, SizeT sector_sz, SizeT size_buffer) noexcept;
+static Boolean drvi_std_input_output(UInt64 lba, UInt8* buffer, SizeT sector_sz, SizeT size_buffer) noexcept;
 
 static Int32 drvi_find_cmd_slot(HbaPort* port) noexcept;
 
@@ -104,7 +104,10 @@ Boolean drv_std_init(UInt16& pi)
 			kDevice.EnableMmio(kSATABar5);		// Enable the memory index_byte/o for this ahci device.
 			kDevice.BecomeBusMaster(kSATABar5); // Become bus master for this ahci device, so that we can control it.
 
-			HbaMem* mem_ahci = (HbaMem*)kDevice.Bar(kSATABar5);
+			HbaMem* mem_ahci = (HbaMem*)kDevice.MapBar(kSATABar5, sizeof(HbaMem));
+
+			if (!mem_ahci)
+				continue;
 
 			kout << hex_number((UIntPtr)mem_ahci) << endl;
 
@@ -123,8 +126,6 @@ Boolean drv_std_init(UInt16& pi)
 					UInt8 ipm = (mem_ahci->Ports[ahci_index].Ssts >> 8) & 0x0F;
 					UInt8 det = mem_ahci->Ports[ahci_index].Ssts & 0x0F;
 
-					HAL::mm_map_page(mem_ahci, mem_ahci, HAL::kMMFlagsWr);
-
 					if (mem_ahci->Ports[ahci_index].Sig == kSATASignature && det == 3 && ipm == 1 &&
 						(mem_ahci->Ports[ahci_index].Ssts & 0xF))
 					{
@@ -170,14 +171,14 @@ Boolean drv_std_detected(Void)
 	return kDevice.DeviceId() != 0xFFFF && kCurrentDiskSectorCount > 0;
 }
 
-Void drv_std_write(UInt64 lba, Char* buffer, SizeT sector_sz, SizeT size_buffer)
+Boolean drv_std_write(UInt64 lba, Char* buffer, SizeT sector_sz, SizeT size_buffer)
 {
-	drvi_std_input_output<YES, YES, NO>(lba, (UInt8*)buffer, sector_sz, size_buffer);
+	return drvi_std_input_output<YES, YES, NO>(lba, (UInt8*)buffer, sector_sz, size_buffer);
 }
 
-Void drv_std_read(UInt64 lba, Char* buffer, SizeT sector_sz, SizeT size_buffer)
+Boolean drv_std_read(UInt64 lba, Char* buffer, SizeT sector_sz, SizeT size_buffer)
 {
-	drvi_std_input_output<NO, YES, NO>(lba, (UInt8*)buffer, sector_sz, size_buffer);
+	return drvi_std_input_output<NO, YES, NO>(lba, (UInt8*)buffer, sector_sz, size_buffer);
 }
 
 static Int32 drvi_find_cmd_slot(HbaPort* port) noexcept
@@ -196,12 +197,12 @@ static Int32 drvi_find_cmd_slot(HbaPort* port) noexcept
 }
 
 template <BOOL Write, BOOL CommandOrCTRL, BOOL Identify>
-static Void drvi_std_input_output(UInt64 lba, UInt8* buffer, SizeT sector_sz, SizeT size_buffer) noexcept
+static Boolean drvi_std_input_output(UInt64 lba, UInt8* buffer, SizeT sector_sz, SizeT size_buffer) noexcept
 {
 	const SizeT slot = drvi_find_cmd_slot(&kSATA->Ports[kSATAPortIdx]);
 
 	if (slot == -1)
-		return;
+		return NO;
 
 	if (size_buffer > mib_cast(4))
 		ke_panic(RUNTIME_CHECK_FAILED, "AHCI only supports < 4mb DMA transfers per PRD.");
@@ -227,6 +228,16 @@ static Void drvi_std_input_output(UInt64 lba, UInt8* buffer, SizeT sector_sz, Si
 
 	auto phys_dma_buf = HAL::hal_get_phys_address((VoidPtr)buffer);
 
+	// a single PRD covers the transfer, the buffer must be physically contiguous (see mm_new_heap's dma).
+	for (UIntPtr page = ((UIntPtr)buffer & ~(UIntPtr)(kPageSize - 1)) + kPageSize; page < (UIntPtr)buffer + size_buffer; page += kPageSize)
+	{
+		if (HAL::hal_get_phys_address((VoidPtr)page) != phys_dma_buf + (page - (UIntPtr)buffer))
+		{
+			kout << "AHCI: DMA buffer isn't physically contiguous.\r";
+			return NO;
+		}
+	}
+
 	command_table->Prdt[0].Dba	= ((UInt32)(UInt64)phys_dma_buf & 0xFFFFFFFF);
 	command_table->Prdt[0].Dbau = (((UInt64)phys_dma_buf << 32));
 	command_table->Prdt[0].Dbc	= ((size_buffer)-1) | (1 << 31);
@@ -274,6 +285,8 @@ static Void drvi_std_input_output(UInt64 lba, UInt8* buffer, SizeT sector_sz, Si
 		if (kSATA->Is & kHBAErrTaskFile)
 			ke_panic(RUNTIME_CHECK_BAD_BEHAVIOR, "AHCI Read disk failure, faulty component.");
 	}
+
+	return YES;
 }
 
 /***
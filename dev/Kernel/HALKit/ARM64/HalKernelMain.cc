@@ -42,6 +42,8 @@ EXTERN_C void hal_init_platform(
 	kKernelBitMpStart = reinterpret_cast<OpenNE::VoidPtr>(
 		reinterpret_cast<OpenNE::UIntPtr>(kHandoverHeader->f_BitMapStart));
 
+	OpenNE::HAL::mm_init_bitmap(kKernelBitMpStart, kKernelBitMpSize);
+
 	/// @note do initialize the interrupts after it.
 
 	OpenNE::mp_initialize_gic();
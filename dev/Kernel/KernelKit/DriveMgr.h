@@ -69,10 +69,11 @@ namespace OpenNE
 		Lba	  fLbaStart{0}, fLbaEnd{0};
 		SizeT fSectorSz{512};
 
-		Void (*fInput)(DrivePacket packet);
-		Void (*fOutput)(DrivePacket packet);
-		Void (*fVerify)(DrivePacket packet);
-		Void (*fInit)(DrivePacket packet);
+		// the packet is the trait's, fPacketGood tells the caller how the transfer went.
+		Void (*fInput)(DrivePacket& packet);
+		Void (*fOutput)(DrivePacket& packet);
+		Void (*fVerify)(DrivePacket& packet);
+		Void (*fInit)(DrivePacket& packet);
 		const Char* (*fDriveKind)(Void);
 	};
 
@@ -154,7 +155,7 @@ namespace OpenNE
 	/// @brief Unimplemented drive.
 	/// @param pckt the packet to read.
 	/// @return
-	Void io_drv_unimplemented(DriveTrait::DrivePacket* pckt) noexcept;
+	Void io_drv_unimplemented(DriveTrait::DrivePacket& pckt) noexcept;
 
 	/// @brief Gets the drive kind (ATA, SCSI, AHCI...)
 	/// @param void none.
@@ -104,10 +104,10 @@ namespace OpenNE
 		static IFilesystemMgr* GetMounted();
 
 	public:
-		virtual NodePtr Create(_Input const Char* path)			 = 0;
-		virtual NodePtr CreateAlias(_Input const Char* path)	 = 0;
-		virtual NodePtr CreateDirectory(_Input const Char* path) = 0;
-		virtual NodePtr CreateSwapFile(const Char* path)		 = 0;
+		virtual NodePtr Create(_Input const Char* path)					 = 0;
+		virtual NodePtr CreateAlias(_Input const Char* path)			 = 0;
+		virtual NodePtr CreateDirectory(_Input const Char* path)		 = 0;
+		virtual NodePtr CreateSwapFile(const Char* path, const SizeT sz) = 0;
 
 	public:
 		virtual bool Remove(_Input const Char* path) = 0;
@@ -133,6 +133,14 @@ namespace OpenNE
 									 _Input Int32		flags,
 									 _Input SizeT		sz) = 0;
 
+		/// @brief Write size bytes at off inside the data of node, in place.
+		/// @return if the drive took the data.
+		virtual Bool WriteAt(_Input NodePtr node, _Input SizeT off, _Input VoidPtr data, _Input SizeT size) = 0;
+
+		/// @brief Read size bytes at off inside the data of node, into data.
+		/// @return if the drive gave the data.
+		virtual Bool ReadAt(_Input NodePtr node, _Input SizeT off, _Input VoidPtr data, _Input SizeT size) = 0;
+
 	public:
 		virtual bool Seek(_Input NodePtr node, _Input SizeT off) = 0;
 
@@ -159,13 +167,15 @@ namespace OpenNE
 		NodePtr Create(const Char* path) override;
 		NodePtr CreateAlias(const Char* path) override;
 		NodePtr CreateDirectory(const Char* path) override;
-		NodePtr CreateSwapFile(const Char* path) override;
+		NodePtr CreateSwapFile(const Char* path, const SizeT sz) override;
 
 	public:
 		bool	Remove(_Input const Char* path) override;
 		NodePtr Open(_Input const Char* path, _Input const Char* r) override;
 		Void	Write(_Input NodePtr node, _Input VoidPtr data, _Input Int32 flags, _Input SizeT sz) override;
 		VoidPtr Read(_Input NodePtr node, _Input Int32 flags, _Input SizeT sz) override;
+		Bool	WriteAt(_Input NodePtr node, _Input SizeT off, _Input VoidPtr data, _Input SizeT size) override;
+		Bool	ReadAt(_Input NodePtr node, _Input SizeT off, _Input VoidPtr data, _Input SizeT size) override;
 		bool	Seek(_Input NodePtr node, _Input SizeT off) override;
 		SizeT	Tell(_Input NodePtr node) override;
 		bool	Rewind(_Input NodePtr node) override;
@@ -225,7 +235,9 @@ namespace OpenNE
 
 			if (man)
 			{
-				man->Write(offset, fFile, data, len);
+				if (!man->WriteAt(fFile, offset, data, len))
+					return ErrorOr<Int64>(kErrorDisk);
+
 				return ErrorOr<Int64>(0);
 			}
 
@@ -283,15 +295,22 @@ namespace OpenNE
 
 			auto man = FSClass::GetMounted();
 
-			if (man)
-			{
-				man->Seek(fFile, offset);
-				auto ret = man->Read(fFile, kFileReadChunk, sz);
+			if (!man || !sz)
+				return nullptr;
 
-				return ret;
+			// the drive transfers straight into it.
+			VoidPtr ret = mm_new_heap(sz, Yes, No, Yes);
+
+			if (!ret)
+				return nullptr;
+
+			if (!man->ReadAt(fFile, offset, ret, sz))
+			{
+				mm_delete_heap(ret);
+				return nullptr;
 			}
 
-			return nullptr;
+			return ret;
 		}
 
 	public:
@@ -370,7 +389,9 @@ namespace OpenNE
 
 		for (SizeT index = 0; index < kRestrictCount; ++index)
 		{
-			if (rt_string_cmp(restrict_type, kRestrictList[index].fRestrict,
+			// "rwb" mustn't be taken for "r".
+			if (rt_string_len(restrict_type) == rt_string_len(kRestrictList[index].fRestrict) &&
+				rt_string_cmp(restrict_type, kRestrictList[index].fRestrict,
 							  rt_string_len(kRestrictList[index].fRestrict)) == 0)
 			{
 				fFileRestrict = kRestrictList[index].fMappedTo;
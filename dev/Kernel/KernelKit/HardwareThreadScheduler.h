@@ -130,6 +130,14 @@ namespace OpenNE
 		/// @returns SizeT the amount of cores present.
 		SizeT Capacity() noexcept;
 
+		/// @brief Returns the index of the hardware thread we're running on.
+		/// @returns ThreadID the current thread, kMaxAPInsideSched past the cores it has slots for.
+		ThreadID CurrentID() noexcept;
+
+		/// @brief Returns the NUMA node of the hardware thread we're running on.
+		/// @returns UInt32 the node, zero when the firmware gives no topology.
+		UInt32 CurrentNode() noexcept;
+
 	private:
 		Array<HardwareThread, kMaxAPInsideSched> fThreadList;
 		ThreadID								 fCurrentThread{0};
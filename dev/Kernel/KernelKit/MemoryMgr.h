@@ -24,11 +24,13 @@ namespace OpenNE
 
 	/// @brief Declare a new size for heap_ptr.
 	/// @param heap_ptr the pointer.
-	/// @return unsupported always returns nullptr.
+	/// @param new_sz the new size.
+	/// @return the resized pointer (possibly moved), or nullptr if heap_ptr was left untouched.
 	VoidPtr mm_realloc_heap(VoidPtr heap_ptr, SizeT new_sz);
 
 	/// @brief Check if pointer is a valid Kernel pointer.
 	/// @param heap_ptr the pointer
+	/// @note Checks the header checksum and canaries, the body CRC is sampled with __OPENNE_HEAP_BODY_SCAN__.
 	/// @return if it exists it returns true.
 	Boolean mm_is_valid_heap(VoidPtr heap_ptr);
 
@@ -36,11 +38,15 @@ namespace OpenNE
 	/// @param sz Size of pointer
 	/// @param wr Read Write bit.
 	/// @param user User enable bit.
+	/// @param dma the chunk must be physically contiguous, as a device transfers to it directly.
+	/// @note Kernel r/w chunks up to kSlabMaxObjectSize are served by the slab (SlabMgr.h),
+	/// kernel chunks of kRegionMinSz or more by a region (RegionMgr.h) unless dma is set.
 	/// @return The newly allocated pointer, or nullptr.
-	VoidPtr mm_new_heap(const SizeT sz, const Bool wr, const Bool user);
+	VoidPtr mm_new_heap(const SizeT sz, const Bool wr, const Bool user, const Bool dma = No);
 
 	/// @brief Protect the heap with a CRC value.
 	/// @param heap_ptr pointer.
+	/// @note The body CRC is only computed with __OPENNE_HEAP_BODY_SCAN__.
 	/// @return if it valid: point has crc now., otherwise fail.
 	Boolean mm_protect_heap(VoidPtr heap_ptr);
 
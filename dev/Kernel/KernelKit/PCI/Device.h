@@ -62,6 +62,7 @@ namespace OpenNE::PCI
 		UChar	ProgIf();
 		UChar	HeaderType();
 		UIntPtr Bar(UInt32 bar_in);
+		VoidPtr MapBar(UInt32 bar_in, SizeT sz);
 
 	public:
 		void EnableMmio(UInt32 bar_in);
@@ -0,0 +1,49 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#ifndef INC_KERNEL_REGION_H
+#define INC_KERNEL_REGION_H
+
+/// @file RegionMgr.h
+/// @brief Kernel regions, virtually contiguous ranges backed by single pages.
+/// Large kernel allocations don't need a contiguous run of the bitmap this way.
+
+#include <NewKit/Defines.h>
+
+/// @brief Regions are made of granules, the last one of each region stays unmapped as a guard.
+#define kRegionGranuleSz (kib_cast(64))
+
+/// @brief Kernel heaps of this size or more are served by a region (see mm_new_heap).
+#define kRegionMinSz (kib_cast(256))
+
+namespace OpenNE
+{
+	/// @brief Allocate a region, its pages are mapped one by one.
+	/// @param sz the size of the region.
+	/// @param wr Read Write bit.
+	/// @return The region, or nullptr if there's no room left in the window.
+	VoidPtr mm_new_region(const SizeT sz, const Bool wr);
+
+	/// @brief Unmap a region and give its pages back.
+	/// @param ptr the start of the region.
+	/// @return a status code regarding the deallocation.
+	Int32 mm_delete_region(VoidPtr ptr);
+
+	/// @brief Check if a pointer lies inside the region window.
+	/// @param ptr the pointer to look up.
+	Bool mm_region_owns(VoidPtr ptr);
+
+	/// @brief Check if a pointer is the start of a live region.
+	/// @param ptr the pointer to look up.
+	Bool mm_is_region(VoidPtr ptr);
+
+	/// @brief Gets the usable size of a region.
+	/// @param ptr the start of the region.
+	/// @return The size, zero if ptr isn't a region.
+	SizeT mm_region_size(VoidPtr ptr);
+} // namespace OpenNE
+
+#endif // !INC_KERNEL_REGION_H
@@ -0,0 +1,81 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#ifndef INC_KERNEL_SECTION_H
+#define INC_KERNEL_SECTION_H
+
+/// @file SectionMgr.h
+/// @brief Named shared sections, the same frames mapped inside several processes.
+/// Processes exchange bulk data through them without copying it through IPC messages.
+
+#include <NewKit/Defines.h>
+#include <NewKit/ErrorOr.h>
+
+/// @brief Longest section name, the null character included.
+#define kSectionNameLen (64U)
+
+/// @brief Sections which may live at once.
+#define kSectionMaxCount (64U)
+
+/// @brief Biggest section, its frames are taken when it is created.
+#define kSectionMaxSz (gib_cast(1))
+
+namespace OpenNE
+{
+	class UserProcess;
+
+	/// @brief Access of a single mapping of a section.
+	enum
+	{
+		kSectionMapRead	 = 1 << 0,
+		kSectionMapWrite = 1 << 1,
+		kSectionMapExec	 = 1 << 2,
+	};
+
+	/// @brief Named section, its frames go away once no handle nor mapping is left.
+	struct SECTION_OBJECT final
+	{
+		Char	 fName[kSectionNameLen];
+		SizeT	 fSize;
+		UIntPtr* fFrames; // one per page, in kernel memory.
+		UInt32	 fRefs;	  // handles and mappings, the slot is free at zero.
+	};
+
+	/// @brief Create a section of zeroed pages, the caller gets its first handle.
+	/// @param name the name of the section, unique among the live ones.
+	/// @param sz the size of the section.
+	/// @return The section, nullptr if the name is taken or memory is short.
+	SECTION_OBJECT* mm_create_section(const Char* name, const SizeT sz);
+
+	/// @brief Open a handle to a live section.
+	/// @param name the name of the section.
+	/// @return The section, nullptr if there's no such section.
+	SECTION_OBJECT* mm_open_section(const Char* name);
+
+	/// @brief Close a handle, the section stays while it is mapped.
+	/// @param section the section.
+	/// @return a status code regarding the close.
+	Int32 mm_close_section(SECTION_OBJECT* section);
+
+	/// @brief Map a whole section inside a process, with access of its own.
+	/// @param process the process to map it in.
+	/// @param section the section.
+	/// @param access kSectionMapRead, kSectionMapWrite and kSectionMapExec.
+	/// @return The mapping inside the process.
+	ErrorOr<VoidPtr> mm_map_section(UserProcess& process, SECTION_OBJECT* section, const UInt32 access);
+
+	/// @brief Unmap a section from a process, see UserProcess::Release.
+	/// @param process the process it is mapped in.
+	/// @param ptr the mapping given by mm_map_section.
+	/// @return a status code regarding the unmap.
+	Int32 mm_unmap_section(UserProcess& process, VoidPtr ptr);
+
+	/// @brief Drop a reference, the last one frees the frames of the section.
+	/// @param section the section.
+	Void mm_release_section(SECTION_OBJECT* section);
+} // namespace OpenNE
+
+#endif // !INC_KERNEL_SECTION_H
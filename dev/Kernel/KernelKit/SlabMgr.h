@@ -0,0 +1,57 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#ifndef INC_KERNEL_SLAB_H
+#define INC_KERNEL_SLAB_H
+
+/// @file SlabMgr.h
+/// @brief Size-class slab allocator, used by the heap for small kernel objects.
+
+#include <NewKit/Defines.h>
+
+#define kSlabMagic (0x5AB5AB)
+
+/// @brief Size of a page-backed span which is carved into objects.
+#define kSlabSpanSize (kib_cast(64))
+
+/// @brief Smallest and largest object served by the slab.
+/// Objects follow a span header, so none is page aligned: a page goes to the page manager instead.
+#define kSlabMinObjectSize (16U)
+#define kSlabMaxObjectSize (3072U)
+
+/// @brief Number of size classes, see kSlabClassSizes inside SlabMgr.cc
+#define kSlabClassCount (15U)
+
+/// @brief Maximum number of spans tracked by the span registry.
+#define kSlabMaxSpans (4096U)
+
+namespace OpenNE
+{
+	/// @brief Allocate an object from the slab.
+	/// @param sz the size of the object, must not exceed kSlabMaxObjectSize.
+	/// @return The object, or nullptr if no span could be made.
+	VoidPtr mm_slab_alloc(const SizeT sz);
+
+	/// @brief Release an object to its span.
+	/// @param ptr the object.
+	/// @return if the object was owned and allocated.
+	Bool mm_slab_free(VoidPtr ptr);
+
+	/// @brief Check if a pointer lies inside a slab span.
+	/// @param ptr the pointer to look up.
+	Bool mm_slab_owns(VoidPtr ptr);
+
+	/// @brief Check if a pointer is a live slab object.
+	/// @param ptr the pointer to look up.
+	Bool mm_slab_is_allocated(VoidPtr ptr);
+
+	/// @brief Gets the class size of a slab object.
+	/// @param ptr the object.
+	/// @return The usable size of the object, zero if not a slab object.
+	SizeT mm_slab_object_size(VoidPtr ptr);
+} // namespace OpenNE
+
+#endif // !INC_KERNEL_SLAB_H
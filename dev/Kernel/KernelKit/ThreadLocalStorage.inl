@@ -5,7 +5,7 @@
 ------------------------------------------- */
 
 //! @file ThreadLocalStorage.inl
-//! @brief Allocate resources from the process's heap storage.
+//! @brief Allocate resources from the thread's bump arena.
 
 #ifndef INC_PROCESS_SCHEDULER_H
 #include <KernelKit/UserProcessScheduler.h>
@@ -19,7 +19,7 @@ inline T* tls_new_ptr(void) noexcept
 	auto ref_process = UserProcessScheduler::The().CurrentProcess();
 	MUST_PASS(ref_process);
 
-	auto pointer = ref_process.Leak().New(sizeof(T));
+	auto pointer = ref_process.Leak().NewLocal(sizeof(T));
 
 	if (pointer.Error())
 		return nullptr;
@@ -40,9 +40,7 @@ inline OpenNE::Bool tls_delete_ptr(T* obj) noexcept
 	auto ref_process = UserProcessScheduler::The().CurrentProcess();
 	MUST_PASS(ref_process);
 
-	ErrorOr<T*> obj_wrapped{obj};
-
-	return ref_process.Leak().Delete(obj_wrapped, sizeof(T));
+	return ref_process.Leak().DeleteLocal(obj, sizeof(T));
 }
 
 //! @brief Delete process pointer.
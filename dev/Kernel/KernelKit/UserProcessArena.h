@@ -0,0 +1,118 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#ifndef INC_PROCESS_ARENA_H
+#define INC_PROCESS_ARENA_H
+
+/// @file UserProcessArena.h
+/// @brief Per process arena, small allocations are blocks of size-class chunks.
+/// Every allocation, blocks and reserved ranges, is indexed by its address.
+
+#include <NewKit/Defines.h>
+#include <CompilerKit/CompilerKit.h>
+
+/// @brief Blocks are powers of two, from 2^kArenaMinBlockShift to 2^kArenaMaxBlockShift bytes.
+#define kArenaMinBlockShift (4U)
+#define kArenaMaxBlockShift (16U)
+#define kArenaClassCount	(kArenaMaxBlockShift - kArenaMinBlockShift + 1)
+
+/// @brief Smallest chunk, big classes get a chunk of kArenaChunkMinBlocks blocks instead.
+#define kArenaChunkSz		 (kib_cast(64))
+#define kArenaChunkMinBlocks (4U)
+#define kArenaChunkMaxBlocks (kArenaChunkSz >> kArenaMinBlockShift)
+
+/// @brief First size of the address index, it grows so that at most half of it is used.
+#define kArenaIndexMinSz (64U)
+
+/// @brief Chunks of the thread-local bump arena, and the alignment of its objects.
+#define kArenaBumpChunkSz (kib_cast(16))
+#define kArenaBumpAlign	  (16U)
+
+namespace OpenNE
+{
+	enum
+	{
+		kArenaEntryEmpty,
+		kArenaEntryBlock,
+		kArenaEntryReserved,
+		kArenaEntryDeleted,
+	};
+
+	/// @brief Chunk of blocks of a single class, its header stays in kernel memory.
+	struct ARENA_CHUNK final
+	{
+		UIntPtr		 fStart;
+		SizeT		 fSize;
+		UInt32		 fClass;
+		UInt32		 fFreeBlocks;
+		ARENA_CHUNK* fNext;		// every chunk of the arena.
+		ARENA_CHUNK* fNextFree; // chunks of the class which have a free block.
+		UInt64		 fUsedMap[kArenaChunkMaxBlocks / 64];
+	};
+
+	/// @brief Allocation of the process, found by its address.
+	struct ARENA_ENTRY final
+	{
+		UIntPtr		 fAddress;
+		SizeT		 fSize;
+		SizeT		 fPad;
+		ARENA_CHUNK* fChunk; // nullptr for reserved ranges.
+		UInt32		 fKind;
+	};
+
+	/// @brief Thread-local bump arena, objects are carved out of a chunk taken from the process arena.
+	/// Only the last object can be given back, the rest goes along with the chunks.
+	struct ARENA_BUMP final
+	{
+		UIntPtr fCursor{0UL};
+		UIntPtr fEnd{0UL};
+		UIntPtr fLast{0UL}; // last object handed out, zero once given back.
+	};
+
+	/// @name UserProcessArena
+	/// @brief Allocations of a process, with an O(1) ownership lookup and a bulk release.
+	class UserProcessArena final
+	{
+	public:
+		explicit UserProcessArena() = default;
+		~UserProcessArena();
+
+		OPENNE_COPY_DELETE(UserProcessArena);
+
+	public:
+		/// @brief Take a block of sz + pad bytes, to be mapped in the current address space.
+		/// @return The block, nullptr if it's bigger than the largest class or no chunk could be made.
+		VoidPtr Alloc(const SizeT& sz, const SizeT& pad);
+
+		/// @brief Index a range made by UserProcess::Reserve.
+		Bool Track(VoidPtr ptr, const SizeT& sz, const SizeT& pad);
+
+		/// @brief Find the allocation starting at ptr.
+		/// @return The entry, nullptr if ptr isn't one of ours.
+		ARENA_ENTRY* Find(VoidPtr ptr);
+
+		/// @brief Give back a block, or forget a reserved range (the caller releases it).
+		Bool Free(ARENA_ENTRY* entry);
+
+		/// @brief Number of live allocations.
+		SizeT Count() noexcept;
+
+	private:
+		Bool		 Insert(const ARENA_ENTRY& entry);
+		Bool		 Grow();
+		ARENA_CHUNK* NewChunk(const UInt32 klass);
+
+	private:
+		ARENA_ENTRY* fIndex{nullptr};
+		SizeT		 fIndexSize{0UL};
+		SizeT		 fCount{0UL};
+		SizeT		 fDeleted{0UL};
+		ARENA_CHUNK* fChunks{nullptr};
+		ARENA_CHUNK* fFreeChunks[kArenaClassCount]{nullptr};
+	};
+} // namespace OpenNE
+
+#endif // !INC_PROCESS_ARENA_H
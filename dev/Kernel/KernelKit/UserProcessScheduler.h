@@ -10,6 +10,7 @@
 #include <ArchKit/ArchKit.h>
 #include <KernelKit/LockDelegate.h>
 #include <KernelKit/User.h>
+#include <KernelKit/UserProcessArena.h>
 #include <NewKit/MutableArray.h>
 
 #define kSchedMinMicroTime		  (AffinityKind::kStandard)
@@ -19,6 +20,25 @@
 #define kSchedMaxMemoryLimit gib_cast(128)
 #define kSchedMaxStackSz	 mib_cast(8)
 
+/// @brief Never backed, right under each stack, a fault there is a stack overflow.
+#define kSchedStackGuardSz kib_cast(64)
+
+/// @brief Reserved ranges are handed out from there, above physical memory.
+/// Each address space has its own tables for this window, see mm_new_address_space.
+#define kSchedReserveStart (0x0000600000000000ULL)
+#define kSchedReserveEnd   (0x0000800000000000ULL)
+
+#ifdef __OPENNE_AMD64__
+static_assert(((kSchedReserveStart >> 39) & 0x1FF) >= kKernelSharedLowIndex,
+			  "the reserve window can't be in the PML4 slots every address space shares.");
+#endif // __OPENNE_AMD64__
+
+/// @brief Reservations a process has room for at first, the table doubles when full.
+#define kSchedMinReservations (16U)
+
+/// @brief Allocations from this size are reserved, and backed on first touch.
+#define kSchedReserveMinSz kib_cast(64)
+
 #define kProcessInvalidID (-1)
 #define kProcessNameLen	  (128U)
 
@@ -36,6 +56,8 @@ namespace OpenNE
 	class UserProcessScheduler;
 	class UserProcessHelper;
 
+	struct SECTION_OBJECT;
+
 	//! @brief Local Process identifier.
 	typedef Int64 ProcessID;
 
@@ -129,6 +151,7 @@ namespace OpenNE
 
 		ImagePtr fCode;
 		ImagePtr fBlob;
+		SizeT*	 fShareCount{nullptr}; // processes running it, when shared.
 
 		Bool HasCode()
 		{
@@ -167,16 +190,6 @@ namespace OpenNE
 		SizeT			   MemoryLimit{kSchedMaxMemoryLimit};
 		SizeT			   UsedMemory{0UL};
 
-		struct ProcessMemoryHeapList final
-		{
-			VoidPtr MemoryEntry{nullptr};
-			SizeT	MemoryEntrySize{0UL};
-			SizeT	MemoryEntryPad{0UL};
-
-			struct ProcessMemoryHeapList* MemoryPrev{nullptr};
-			struct ProcessMemoryHeapList* MemoryNext{nullptr};
-		};
-
 		struct UserProcessSignal final
 		{
 			UIntPtr			  SignalArg;
@@ -184,9 +197,22 @@ namespace OpenNE
 			UIntPtr			  SignalID;
 		};
 
-		UserProcessSignal	   ProcessSignal;
-		ProcessMemoryHeapList* ProcessMemoryHeap{nullptr};
-		UserProcessTeam*	   ProcessParentTeam;
+		/// @brief Virtual range without backing, its pages are zeroed and mapped on first touch.
+		struct ProcessReservation final
+		{
+			UIntPtr fStart{0UL};
+			SizeT	fSize{0UL};
+			SizeT			fGuard{0UL};			// unbacked bytes right under fStart.
+			VoidPtr			fAddressSpace{nullptr}; // where its pages are mapped.
+			SECTION_OBJECT* fSection{nullptr};		// the frames are the section's, see SectionMgr.h
+		};
+
+		UserProcessSignal	ProcessSignal;
+		UserProcessArena*	ProcessArena{nullptr};	 // what New handed out, made on first use.
+		ARENA_BUMP			LocalArena{};			 // what NewLocal handed out, see ThreadLocalStorage.h
+		ProcessReservation* ProcessReserve{nullptr}; // slots of Reserve, made on first use.
+		SizeT				ProcessReserveCount{0UL};
+		UserProcessTeam*	ProcessParentTeam;
 
 		VoidPtr VMRegister{0UL};
 
@@ -223,9 +249,41 @@ namespace OpenNE
 		template <typename T>
 		Boolean Delete(ErrorOr<T*> ptr, const SizeT& sz);
 
+		///! @brief Thread-local allocate, bumped out of a chunk of the process arena.
+		///! @param sz size of new ptr, at most kArenaBumpChunkSz.
+		ErrorOr<VoidPtr> NewLocal(const SizeT& sz);
+
+		///! @brief Thread-local free, only the last object's room is reused.
+		///! @param ptr the pointer to free.
+		///! @param sz the size of it.
+		Boolean DeleteLocal(VoidPtr ptr, const SizeT& sz);
+
 		///! @brief Wakes up threads.
 		Void Wake(const Bool wakeup = false);
 
+		///! @brief Reserve a zero-filled range, backed page per page on first touch.
+		///! @param sz size of the range.
+		///! @param guard size of the guard under the range, which is never backed.
+		ErrorOr<VoidPtr> Reserve(const SizeT& sz, const SizeT& guard = 0);
+
+		///! @brief Release a range made by Reserve, alongside the pages which backed it.
+		///! @param ptr the start of the range.
+		Bool Release(VoidPtr ptr);
+
+		///! @brief Run the image of parent, with its reserved memory shared copy-on-write.
+		///! @param parent the process to duplicate.
+		Bool Duplicate(UserProcess& parent);
+
+		///! @brief Back the page of a reserved range which faulted.
+		///! @param fault_addr the faulting address.
+		///! @return if the fault was resolved.
+		Bool Fault(VoidPtr fault_addr);
+
+		///! @brief Read a page written out by the reclaimer back.
+		///! @param page the page of a reserved range.
+		///! @return if the page is mapped again.
+		Bool SwapIn(VoidPtr page);
+
 	public:
 		//! @brief Gets the local exit code.
 		const UInt32& GetExitCode() noexcept;
@@ -295,6 +353,7 @@ namespace OpenNE
 
 	public:
 		ProcessID  Spawn(const Char* name, VoidPtr code, VoidPtr image);
+		ProcessID  Spawn(const Char* name, UserProcess& parent);
 		const Bool Remove(ProcessID process_id);
 
 		const Bool IsUser() override;
@@ -305,11 +364,24 @@ namespace OpenNE
 		Ref<UserProcess>& CurrentProcess();
 		const SizeT		  Run() noexcept;
 
+		/// @brief Swap out cold pages of reserved ranges, second chance is given to accessed ones.
+		/// @param pages the pages to free.
+		/// @return The pages freed.
+		SizeT Reclaim(const SizeT pages) noexcept;
+
 	public:
 		STATIC UserProcessScheduler& The();
 
 	private:
 		UserProcessTeam mTeam{};
+
+		/// @brief Where Reclaim stopped, the next call goes on from there.
+		struct
+		{
+			SizeT fProcess{0UL};
+			SizeT fReserve{0UL};
+			SizeT fOffset{0UL};
+		} mClockHand;
 	};
 
 	/*
@@ -323,6 +395,7 @@ namespace OpenNE
 		STATIC Bool CanBeScheduled(const UserProcess& process);
 		STATIC ErrorOr<PID> TheCurrentPID();
 		STATIC SizeT		StartScheduling();
+		STATIC SizeT		Reclaim(SizeT pages);
 	};
 
 	const UInt32& sched_get_exit_code(void) noexcept;
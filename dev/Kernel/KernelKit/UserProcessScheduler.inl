@@ -20,32 +20,26 @@ namespace OpenNE
 			sz == 0)
 			return No;
 
-		ProcessMemoryHeapList* entry = this->ProcessMemoryHeap;
-
-		while (entry != nullptr)
-		{
-			if (entry->MemoryEntry == ptr.Leak().Leak())
-			{
-				this->UsedMemory -= entry->MemoryEntrySize;
-
-#ifdef __OPENNE_AMD64__
-				auto pd = hal_read_cr3();
-				hal_write_cr3(this->VMRegister);
+		if (!this->ProcessArena)
+			return No;
 
-				auto ret = mm_delete_heap(entry->MemoryEntry);
+		// hashed by address, no walk over the process's allocations.
+		ARENA_ENTRY* entry = this->ProcessArena->Find(ptr.Leak().Leak());
 
-				hal_write_cr3(pd);
+		if (!entry)
+			return No;
 
-				return ret;
-#else
-				Bool ret = mm_delete_heap(ptr.Leak().Leak());
-				return ret;
-#endif
-			}
+		// reserved memory is accounted for page per page.
+		if (entry->fKind == kArenaEntryReserved)
+		{
+			VoidPtr range = reinterpret_cast<VoidPtr>(entry->fAddress);
 
-			entry = entry->MemoryNext;
+			this->ProcessArena->Free(entry);
+			return this->Release(range);
 		}
 
-		return No;
+		this->UsedMemory -= entry->fSize;
+
+		return this->ProcessArena->Free(entry);
 	}
 } // namespace OpenNE
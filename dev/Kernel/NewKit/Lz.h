@@ -0,0 +1,35 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <NewKit/Defines.h>
+
+/// @file Lz.h
+/// @brief Byte oriented LZ77 codec, LZ4 block style: a token, literals, then a 16-bit offset and a match.
+
+/// @brief Shortest match worth encoding.
+#define kLzMinMatch (4U)
+
+/// @brief Bits of the compressor's match finder, its table lives on the stack.
+#define kLzHashBits (10U)
+
+/// @brief Longest input, offsets are 16-bit.
+#define kLzMaxInput (0xFFFFU)
+
+namespace OpenNE
+{
+	/// @brief Compress src into dst.
+	/// @return The compressed size, zero if it doesn't fit in dst_len.
+	SizeT ke_lz_compress(const UInt8* src, SizeT src_len, UInt8* dst, SizeT dst_len) noexcept;
+
+	/// @brief Decompress src into dst.
+	/// @return The decompressed size, zero if src is malformed or doesn't fit in dst_len.
+	SizeT ke_lz_decompress(const UInt8* src, SizeT src_len, UInt8* dst, SizeT dst_len) noexcept;
+} // namespace OpenNE
+
+#endif // !LZ_H
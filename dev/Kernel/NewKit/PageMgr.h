@@ -12,10 +12,30 @@
 #include <NewKit/Defines.h>
 #include <NewKit/Ref.h>
 
+/// @brief Per core cache of single pages, drained to kPageCacheLowMark once it reaches kPageCacheHighMark.
+#define kPageCacheHighMark (64U)
+#define kPageCacheLowMark  (32U)
+
+/// @brief Number of pages taken from the bitmap when a core's cache runs dry.
+#define kPageCacheBatch (16U)
+
+/// @brief Zeroed pages kept in reserve, and freed pages waiting for an idle core to zero them.
+#define kPageZeroPoolDepth (256U)
+#define kPageDirtyDepth	   (256U)
+
 namespace OpenNE
 {
 	class PageMgr;
 
+	/// @brief Memory types of a mapping, devices want kPageTypeUC and framebuffers kPageTypeWC.
+	enum
+	{
+		kPageTypeWB,
+		kPageTypeWT,
+		kPageTypeWC,
+		kPageTypeUC,
+	};
+
 	class PTEWrapper final
 	{
 	public:
@@ -42,6 +62,9 @@ namespace OpenNE
 		bool Present();
 		bool Access();
 
+		/// @brief Size of the page mapping this address (4 KiB, or 2 MiB/1 GiB on AMD64).
+		SizeT PageSize();
+
 	private:
 		Boolean fRw;
 		Boolean fUser;
@@ -52,6 +75,7 @@ namespace OpenNE
 		Boolean fWt;
 		Boolean fPresent;
 		Boolean fAccessed;
+		SizeT	fPageSize;
 
 	private:
 		friend class PageMgr;
@@ -68,9 +92,40 @@ namespace OpenNE
 		PageMgr(const PageMgr&)			   = default;
 
 	public:
-		PTEWrapper Request(Boolean Rw, Boolean User, Boolean ExecDisable, SizeT Sz);
+		PTEWrapper Request(Boolean Rw, Boolean User, Boolean ExecDisable, SizeT Sz, Boolean Zeroed = false);
 		bool	   Free(Ref<PTEWrapper>& wrapper);
 
+		/// @brief Request a zeroed page which isn't mapped, it is freed with mm_free_bitmap.
+		VoidPtr RequestZeroed();
+
+	public:
+		/// @brief Zero one freed page for the zeroed reserve, called by idle cores.
+		/// @return If a page was zeroed.
+		bool ZeroIdle();
+
+		/// @brief Zeroed pages ready to be handed out.
+		SizeT ZeroPoolDepth();
+
+		/// @brief Zeroed requests served by the reserve.
+		UInt64 ZeroPoolHits();
+
+		/// @brief Zeroed requests which had to clear their page themselves.
+		UInt64 ZeroPoolMisses();
+
+	public:
+		/// @brief Maps a whole range at once, invalidating the TLB once at the end.
+		bool MapRange(UIntPtr VirtAddr, UIntPtr PhysAddr, SizeT Sz, Boolean Rw, Boolean User, Boolean ExecDisable, UInt32 Type = kPageTypeWB);
+
+		/// @brief Unmaps a whole range at once, invalidating the TLB once at the end.
+		bool UnmapRange(UIntPtr VirtAddr, SizeT Sz);
+
+	public:
+		/// @brief Single page requests served by the core's cache.
+		UInt64 CacheHits(const SizeT core);
+
+		/// @brief Single page requests which had to refill the core's cache.
+		UInt64 CacheMisses(const SizeT core);
+
 	private:
 		void FlushTLB();
 
@@ -38,6 +38,9 @@ namespace OpenNE
 			return fPageMgr;
 		}
 
+	private:
+		Void ApplyFlags(PTEWrapper& wrapper);
+
 	private:
 		Ref<PageMgr> fPageMgr;
 	};
@@ -9,9 +9,27 @@
 
 #include <NewKit/Defines.h>
 #include <CompilerKit/CompilerKit.h>
+#include <KernelKit/FileMgr.h>
 
 #define kSwapBlockMaxSize (mib_cast(16))
 #define kSwapPageFile	  "/boot/pagefile.sys"
+#define kSwapMagic		  (0x50415753U) // 'SWAP'
+
+/// @brief The page file is cut into page-sized slots, the n-th one is at n * kSwapSlotSize.
+#define kSwapSlotSize	 (kib_cast(4))
+#define kSwapSlotCount	 (8192U)
+#define kSwapSlotInvalid (-1)
+
+/// @brief Share of physical memory the compressed pool may take, zero disables it.
+#ifndef kSwapPoolPercent
+#define kSwapPoolPercent (20U)
+#endif // !kSwapPoolPercent
+
+/// @brief Slots of the compressed pool, numbered after the page file's.
+#define kSwapPoolSlotCount (8192U)
+
+/// @brief Pages which don't compress under that size go to the page file.
+#define kSwapPoolMaxBlob (kSwapSlotSize * 3 / 4)
 
 /// @file SwapDisk.h
 /// @brief Virtual memory swap disk.
@@ -20,17 +38,88 @@ namespace OpenNE
 {
 	struct SWAP_DISK_HEADER;
 
+	/// @brief Counters of the compressed pool, hits and spills count since boot, the others what it holds now.
+	struct SWAP_DISK_STATS final
+	{
+		SizeT fPoolPages{0UL};	// pages the pool holds.
+		SizeT fSameFilled{0UL}; // of those, pages held as a single repeated word.
+		SizeT fBytesIn{0UL};	// page bytes the pool holds.
+		SizeT fBytesOut{0UL};	// compressed bytes they take.
+		SizeT fPoolSpills{0UL}; // pages which went to the page file, pool full or incompressible.
+		SizeT fPoolHits{0UL};	// pages read back from the pool.
+		SizeT fDiskHits{0UL};	// pages read back from the page file.
+	};
+
 	/// @brief This class is a disk swap delegate for any data. available as a syscall too.
+	/// The page file stays open as long as the swap disk lives.
+	/// Pages go through a compressed pool in memory first, and spill to the page file once it is full.
 	class SwapDisk final
 	{
 	public:
 		explicit SwapDisk() = default;
-		~SwapDisk()			= default;
+		~SwapDisk();
 
-		OPENNE_COPY_DEFAULT(SwapDisk);
+		OPENNE_COPY_DELETE(SwapDisk);
 
 		BOOL			  Write(const Char* fork_name, const SizeT fork_name_len, SWAP_DISK_HEADER* data, const SizeT data_len);
 		SWAP_DISK_HEADER* Read(const Char* fork_name, const SizeT fork_name_len, const SizeT data_len);
+
+		/// @brief Write key->fBlobSz bytes of blob to a free slot, keyed by the team, process and address of key.
+		/// @return The slot, kSwapSlotInvalid if the page file is full or can't be written.
+		Int64 WriteSlot(const SWAP_DISK_HEADER* key, VoidPtr blob);
+
+		/// @brief Read key->fBlobSz bytes of a slot into blob, the key must be the slot's.
+		BOOL ReadSlot(const Int64 slot, const SWAP_DISK_HEADER* key, VoidPtr blob);
+
+		/// @brief Give a slot back.
+		Void FreeSlot(const Int64 slot);
+
+		/// @brief Counters of the compressed pool.
+		const SWAP_DISK_STATS& Stats() noexcept;
+
+		/// @brief Page bytes per compressed byte of the pool, times 100.
+		SizeT CompressionRatio() noexcept;
+
+		/// @brief Percentage of the pages read back which came from the pool.
+		SizeT HitRate() noexcept;
+
+	public:
+		STATIC SwapDisk& The();
+
+	private:
+		BOOL  Open();
+		Int64 TakeSlot(const SizeT first, const SizeT count, SizeT& cursor);
+		Int64 WritePool(const SWAP_DISK_HEADER* key, VoidPtr blob);
+		BOOL  ReadPool(const Int64 slot, const SWAP_DISK_HEADER* key, VoidPtr blob);
+
+	private:
+		/// @brief What a slot holds.
+		struct SWAP_DISK_SLOT final
+		{
+			UInt64 fTeamID;
+			UInt64 fProcessID;
+			UInt64 fVirtualAddress;
+		};
+
+		/// @brief A page kept by the pool, fSize is zero when every word of it is fFill.
+		struct SWAP_POOL_ENTRY final
+		{
+			VoidPtr fBlob;
+			SizeT	fSize;
+			UInt64	fFill;
+		};
+
+		FileStreamUTF8* fFile{nullptr};
+		Bool			fOpenLock{NO};
+		SizeT			fSlotCursor{0UL};
+		SizeT			fPoolCursor{0UL};
+		SizeT			fPoolBytes{0UL};
+		UInt64			fSlotMap[(kSwapSlotCount + kSwapPoolSlotCount) / 64]{0};
+		SWAP_DISK_SLOT	fSlotKey[kSwapSlotCount + kSwapPoolSlotCount];
+		SWAP_POOL_ENTRY fPoolEntry[kSwapPoolSlotCount];
+		SWAP_DISK_STATS fStats;
+		Bool			fPoolLock{NO};
+		UInt8			fPoolScratch[kSwapPoolMaxBlob];
 	};
 
 	typedef struct SWAP_DISK_HEADER
@@ -11,6 +11,36 @@
 
 namespace OpenNE
 {
+	namespace Detail
+	{
+		/// @brief Node of a proximity domain, added to the topology when it's new.
+		/// @return The node, kNumaMaxNodes when there are too many of them.
+		STATIC UInt32 acpi_numa_node(HAL::NUMA_TOPOLOGY& topology, UInt32 domain)
+		{
+			for (SizeT node = 0; node < topology.fNodeCount; ++node)
+			{
+				if (topology.fDomain[node] == domain)
+					return node;
+			}
+
+			if (topology.fNodeCount == kNumaMaxNodes)
+				return kNumaMaxNodes;
+
+			topology.fDomain[topology.fNodeCount] = domain;
+
+			return topology.fNodeCount++;
+		}
+
+		/// @brief Record the node of a core.
+		STATIC Void acpi_numa_core(HAL::NUMA_TOPOLOGY& topology, UInt32 core_id, UInt32 domain)
+		{
+			UInt32 node = acpi_numa_node(topology, domain);
+
+			if (core_id < kNumaMaxCores && node < kNumaMaxNodes)
+				topology.fCoreNode[core_id] = node;
+		}
+	} // namespace Detail
+
 	/// @brief Finds a descriptor table inside ACPI XSDT.
 	ErrorOr<voidPtr> ACPIFactoryInterface::Find(const Char* signature)
 	{
@@ -93,4 +123,107 @@ namespace OpenNE
 
 		return chr == 0;
 	}
+
+	/***
+	@brief Memory locality from the SRAT, with distances from the SLIT.
+	@param topology filled with the nodes, their memory ranges, cores and distances.
+	@return if the SRAT gave at least one memory range.
+	*/
+	Bool ACPIFactoryInterface::Topology(HAL::NUMA_TOPOLOGY& topology)
+	{
+		topology.fRangeCount = 0UL;
+		topology.fNodeCount	 = 0UL;
+
+		for (SizeT core = 0; core < kNumaMaxCores; ++core)
+			topology.fCoreNode[core] = 0;
+
+		auto srat_ptr = this->Find("SRAT");
+
+		if (!srat_ptr)
+			return No;
+
+		SRAT*	srat  = reinterpret_cast<SRAT*>(srat_ptr.Leak().Leak());
+		UIntPtr entry = reinterpret_cast<UIntPtr>(srat->Entries);
+		UIntPtr end	  = reinterpret_cast<UIntPtr>(srat) + srat->Length;
+
+		while (entry + 2 <= end)
+		{
+			UInt8 type	 = reinterpret_cast<UInt8*>(entry)[0];
+			UInt8 length = reinterpret_cast<UInt8*>(entry)[1];
+
+			if (length < 2 || entry + length > end)
+				break;
+
+			if (type == eSratLocalApic && length >= sizeof(SRAT_LOCAL_APIC))
+			{
+				SRAT_LOCAL_APIC* apic = reinterpret_cast<SRAT_LOCAL_APIC*>(entry);
+
+				if (apic->Flags & kSratEnabled)
+				{
+					UInt32 domain = apic->DomainLow | (apic->DomainHigh[0] << 8) |
+									(apic->DomainHigh[1] << 16) | (apic->DomainHigh[2] << 24);
+
+					Detail::acpi_numa_core(topology, apic->ApicId, domain);
+				}
+			}
+			else if (type == eSratLocalX2Apic && length >= sizeof(SRAT_LOCAL_X2APIC))
+			{
+				SRAT_LOCAL_X2APIC* apic = reinterpret_cast<SRAT_LOCAL_X2APIC*>(entry);
+
+				if (apic->Flags & kSratEnabled)
+					Detail::acpi_numa_core(topology, apic->X2ApicId, apic->Domain);
+			}
+			else if (type == eSratMemory && length >= sizeof(SRAT_MEMORY))
+			{
+				SRAT_MEMORY* memory = reinterpret_cast<SRAT_MEMORY*>(entry);
+				UInt32		 node	= Detail::acpi_numa_node(topology, memory->Domain);
+
+				if ((memory->Flags & kSratEnabled) && memory->Size &&
+					node < kNumaMaxNodes && topology.fRangeCount < kNumaMaxRanges)
+				{
+					topology.fRanges[topology.fRangeCount].fBase = memory->Base;
+					topology.fRanges[topology.fRangeCount].fSize = memory->Size;
+					topology.fRanges[topology.fRangeCount].fNode = node;
+
+					++topology.fRangeCount;
+				}
+			}
+
+			entry += length;
+		}
+
+		kout << "ACPI: NUMA nodes: " << number(topology.fNodeCount) << endl;
+		kout << "ACPI: NUMA memory ranges: " << number(topology.fRangeCount) << endl;
+
+		for (SizeT node = 0; node < kNumaMaxNodes; ++node)
+		{
+			for (SizeT other = 0; other < kNumaMaxNodes; ++other)
+				topology.fDistance[node][other] = node == other ? kNumaLocalDistance : kNumaRemoteDistance;
+		}
+
+		auto slit_ptr = this->Find("SLIT");
+
+		if (!slit_ptr)
+			return topology.fRangeCount > 0;
+
+		SLIT* slit = reinterpret_cast<SLIT*>(slit_ptr.Leak().Leak());
+
+		// the matrix must fit in the table, else keep the defaults.
+		if (sizeof(SLIT) + slit->Localities * slit->Localities > slit->Length)
+			return topology.fRangeCount > 0;
+
+		for (SizeT node = 0; node < topology.fNodeCount; ++node)
+		{
+			for (SizeT other = 0; other < topology.fNodeCount; ++other)
+			{
+				UInt64 from = topology.fDomain[node];
+				UInt64 to	= topology.fDomain[other];
+
+				if (from < slit->Localities && to < slit->Localities)
+					topology.fDistance[node][other] = slit->Entries[from * slit->Localities + to];
+			}
+		}
+
+		return topology.fRangeCount > 0;
+	}
 } // namespace OpenNE
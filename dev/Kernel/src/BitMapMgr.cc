@@ -15,12 +15,29 @@
 #include <NewKit/Defines.h>
 #include <NewKit/KernelPanic.h>
 
-#define kBitMapMagic   (0x10210U)
-#define kBitMapPadSize (mib_cast(16))
-
-#define kBitMapMagIdx  (0U)
-#define kBitMapSizeIdx (1U)
-#define kBitMapUsedIdx (2U)
+/// @file BitMapMgr.cc
+/// @brief Binary buddy page-frame allocator over the handover bitmap range.
+/// The range is split in one zone per NUMA memory range, a single zone without a topology.
+/// Each page of a zone has a PAGE_FRAME descriptor, the array is located at the start of the zone.
+/// Nothing is stored inside allocated pages, so blocks are handed out whole.
+/// Blocks of order N are 2^N pages, aligned to their size relative to the base.
+/// Every core allocates and frees (idle zeroing and retiring too), so each zone has a spinlock.
+/// It is never held while mapping, mapping may allocate page tables from the same zone.
+
+/// @brief Largest block order, 2^20 pages (4 GiB) matches kHandoverBitMapSz.
+#define kBitMapMaxOrder (20U)
+
+#define kBitMapStateFree (0x80U)
+#define kBitMapStateUsed (0x40U)
+#define kBitMapOrderMask (0x3FU)
+#define kBitMapStateNone (0x00U)
+
+/// @brief Marks the pages holding the frame array, never free nor an allocated head.
+#define kBitMapStateReserved (0xFFU)
+
+/// @brief Free pages under which the reclaimer is called, and up to which it frees.
+#define kBitMapLowWatermark	 (256UL)
+#define kBitMapHighWatermark (1024UL)
 
 namespace OpenNE
 {
@@ -28,44 +45,311 @@ namespace OpenNE
 	{
 		namespace Detail
 		{
+			/// @brief Free block links, stored inside the free block itself.
+			struct BITMAP_FREE_BLOCK final
+			{
+				BITMAP_FREE_BLOCK* fNext;
+				BITMAP_FREE_BLOCK* fPrev;
+			};
+
+			/// @brief Buddy zone, covers a contiguous page range.
+			struct BITMAP_ZONE final
+			{
+				UIntPtr			   fBase{0UL};
+				SizeT			   fPageCount{0UL};
+				SizeT			   fFreePages{0UL};
+				PAGE_FRAME*		   fFrames{nullptr};
+				BITMAP_FREE_BLOCK* fFreeList[kBitMapMaxOrder + 1]{nullptr};
+				UInt32			   fNode{0U};
+				Bool			   fReady{No};
+				Bool			   fLock{No};
+			};
+
+			STATIC BITMAP_ZONE kBitMapZone[kNumaMaxRanges];
+			STATIC SizeT	   kBitMapZoneCount = 0UL;
+
+			/// @brief Locality given by mm_set_topology, and for each node the nodes by distance.
+			STATIC NUMA_TOPOLOGY kBitMapTopology;
+			STATIC UInt32		 kBitMapNodeOrder[kNumaMaxNodes][kNumaMaxNodes];
+
+			STATIC mm_reclaim_proc kBitMapReclaim		 = nullptr;
+			STATIC Bool			   kBitMapReclaiming	 = No;
+			STATIC SizeT		   kBitMapReclaimWanted = 0UL; // bytes failed allocations asked for, see mm_reclaim_idle.
+
+			STATIC Void mmi_lock_zone(BITMAP_ZONE& zone)
+			{
+				while (__atomic_test_and_set(&zone.fLock, __ATOMIC_ACQUIRE))
+					;
+			}
+
+			STATIC Void mmi_unlock_zone(BITMAP_ZONE& zone)
+			{
+				__atomic_clear(&zone.fLock, __ATOMIC_RELEASE);
+			}
+
+			/// @brief Zone holding ptr.
+			/// @return The zone, nullptr if ptr isn't in the range.
+			STATIC BITMAP_ZONE* mmi_zone_of(VoidPtr ptr)
+			{
+				UIntPtr addr = reinterpret_cast<UIntPtr>(ptr);
+
+				for (SizeT index = 0; index < kBitMapZoneCount; ++index)
+				{
+					BITMAP_ZONE& zone = kBitMapZone[index];
+
+					if (addr >= zone.fBase && addr - zone.fBase < zone.fPageCount * kPageSize)
+						return &zone;
+				}
+
+				return nullptr;
+			}
+
+			STATIC SizeT mmi_free_pages()
+			{
+				SizeT free = 0UL;
+
+				for (SizeT index = 0; index < kBitMapZoneCount; ++index)
+					free += kBitMapZone[index].fFreePages;
+
+				return free;
+			}
+
+			/// @brief Node of the core we're running on, which allocations come from first.
+			STATIC UInt32 mmi_current_node()
+			{
+#ifdef __OPENNE_AMD64__
+				return mm_node_of(hal_apic_id());
+#else
+				return 0U;
+#endif // ifdef __OPENNE_AMD64__
+			}
+
+			/// @brief Sort the nodes by their SLIT distance, for each node, closest first.
+			STATIC Void mmi_order_nodes()
+			{
+				SizeT count = kBitMapTopology.fNodeCount ? kBitMapTopology.fNodeCount : 1UL;
+
+				for (SizeT node = 0; node < count; ++node)
+				{
+					UInt32* order = kBitMapNodeOrder[node];
+
+					for (SizeT index = 0; index < count; ++index)
+						order[index] = index;
+
+					for (SizeT index = 1; index < count; ++index)
+					{
+						UInt32 other = order[index];
+						SizeT  pos	 = index;
+
+						while (pos > 0 &&
+							   kBitMapTopology.fDistance[node][order[pos - 1]] > kBitMapTopology.fDistance[node][other])
+						{
+							order[pos] = order[pos - 1];
+							--pos;
+						}
+
+						order[pos] = other;
+					}
+				}
+			}
+
+			/// @brief Have the reclaimer bring the free pages back over the high watermark.
+			/// Only one runs at a time.
+			STATIC Void mmi_reclaim(SizeT size)
+			{
+				if (!kBitMapReclaim || __atomic_test_and_set(&kBitMapReclaiming, __ATOMIC_ACQUIRE))
+					return;
+
+				SizeT free	  = mmi_free_pages();
+				SizeT pages	  = (size + kPageSize - 1) / kPageSize;
+				SizeT missing = free < kBitMapHighWatermark ? kBitMapHighWatermark - free : 0UL;
+
+				kBitMapReclaim(missing + pages);
+
+				__atomic_clear(&kBitMapReclaiming, __ATOMIC_RELEASE);
+			}
+
 			/// \brief Proxy Interface to allocate a bitmap.
 			class IBitMapProxy final
 			{
 			public:
-				explicit IBitMapProxy() = default;
-				~IBitMapProxy()			= default;
+				explicit IBitMapProxy(BITMAP_ZONE& zone)
+					: fZone(zone)
+				{
+				}
+
+				~IBitMapProxy() = default;
 
 				OPENNE_COPY_DELETE(IBitMapProxy);
 
-				auto IsBitMap(VoidPtr page_ptr) -> Bool
+				/// @brief Setup the zone from a memory range, the frame array is carved from its start.
+				auto InitZone(VoidPtr base_ptr, SizeT size) -> Bool
 				{
-					if (!page_ptr)
+					UIntPtr base = (reinterpret_cast<UIntPtr>(base_ptr) + kPageSize - 1) & ~(static_cast<UIntPtr>(kPageSize) - 1);
+					UIntPtr end	 = reinterpret_cast<UIntPtr>(base_ptr) + size;
+
+					if (!base_ptr || end <= base)
 						return No;
 
-					UIntPtr* ptr_bit_set = reinterpret_cast<UIntPtr*>(page_ptr);
+					fZone.fBase		 = base;
+					fZone.fPageCount = (end - base) / kPageSize;
+					fZone.fFreePages = 0UL;
+					fZone.fFrames	 = reinterpret_cast<PAGE_FRAME*>(base);
+
+					for (SizeT order = 0; order <= kBitMapMaxOrder; ++order)
+						fZone.fFreeList[order] = nullptr;
 
-					if (!ptr_bit_set[kBitMapMagIdx] ||
-						ptr_bit_set[kBitMapMagIdx] != kBitMapMagic)
+					SizeT frame_pages = (fZone.fPageCount * sizeof(PAGE_FRAME) + kPageSize - 1) / kPageSize;
+
+					if (frame_pages >= fZone.fPageCount)
 						return No;
 
+					// kBitMapStateNone and kPageOwnerNone are both zero.
+					rt_set_memory(fZone.fFrames, 0, fZone.fPageCount * sizeof(PAGE_FRAME) / sizeof(UInt32));
+
+					// the pages holding the frame array are never handed out.
+					for (SizeT index = 0; index < frame_pages; ++index)
+						fZone.fFrames[index].fState = kBitMapStateReserved;
+
+					// carve the rest into the largest naturally aligned blocks.
+					SizeT index = frame_pages;
+
+					while (index < fZone.fPageCount)
+					{
+						SizeT order = kBitMapMaxOrder;
+
+						while (order > 0 &&
+							   ((index & ((1UL << order) - 1)) != 0 ||
+								index + (1UL << order) > fZone.fPageCount))
+							--order;
+
+						this->PushFree(index, order);
+						index += (1UL << order);
+					}
+
+					fZone.fReady = Yes;
+
 					return Yes;
 				}
 
+				/// @brief Check if the pointer lies inside an allocated block.
+				auto IsBitMap(VoidPtr page_ptr) -> Bool
+				{
+					return this->FindHead(page_ptr) != fZone.fPageCount;
+				}
+
+				/// @brief Free a block, merging it with its buddies.
 				auto FreeBitMap(VoidPtr page_ptr) -> Bool
 				{
-					if (this->IsBitMap(page_ptr) == No)
+					if (!fZone.fReady || !page_ptr)
 						return No;
 
-					UIntPtr* ptr_bit_set = reinterpret_cast<UIntPtr*>(page_ptr);
+					UIntPtr addr = reinterpret_cast<UIntPtr>(page_ptr);
 
-					ptr_bit_set[kBitMapMagIdx]	= kBitMapMagic;
-					ptr_bit_set[kBitMapUsedIdx] = No;
+					if (addr < fZone.fBase ||
+						(addr - fZone.fBase) % kPageSize != 0)
+						return No;
+
+					SizeT index = (addr - fZone.fBase) / kPageSize;
+
+					if (index >= fZone.fPageCount ||
+						!(fZone.fFrames[index].fState & kBitMapStateUsed) ||
+						(fZone.fFrames[index].fState & kBitMapStateFree))
+						return No;
+
+					SizeT order = fZone.fFrames[index].fState & kBitMapOrderMask;
+
+					// the owner's fields go along with the block.
+					fZone.fFrames[index] = PAGE_FRAME{};
+
+					while (order < kBitMapMaxOrder)
+					{
+						SizeT buddy = index ^ (1UL << order);
+
+						if (buddy >= fZone.fPageCount ||
+							fZone.fFrames[buddy].fState != (kBitMapStateFree | order))
+							break;
+
+						this->PopFree(buddy, order);
+
+						index = (buddy < index) ? buddy : index;
+						++order;
+					}
+
+					this->PushFree(index, order);
+
+					return Yes;
+				}
+
+				/// @brief Resize an allocated block in place.
+				/// Shrinking gives back the upper halves, growing absorbs free upper buddies.
+				/// @return if the block now holds size bytes, otherwise it is left untouched.
+				auto ResizeBitMap(VoidPtr page_ptr, SizeT size) -> Bool
+				{
+					if (!fZone.fReady || !page_ptr || !size)
+						return No;
+
+					UIntPtr addr = reinterpret_cast<UIntPtr>(page_ptr);
+
+					if (addr < fZone.fBase ||
+						(addr - fZone.fBase) % kPageSize != 0)
+						return No;
+
+					SizeT index = (addr - fZone.fBase) / kPageSize;
+
+					if (index >= fZone.fPageCount ||
+						!(fZone.fFrames[index].fState & kBitMapStateUsed) ||
+						(fZone.fFrames[index].fState & kBitMapStateFree))
+						return No;
+
+					SizeT order		= fZone.fFrames[index].fState & kBitMapOrderMask;
+					SizeT new_order = this->OrderOf(size);
+
+					if (new_order > kBitMapMaxOrder)
+						return No;
+
+					if (new_order <= order)
+					{
+						while (order > new_order)
+						{
+							--order;
+							this->PushFree(index + (1UL << order), order);
+						}
 
-					this->GetBitMapStatus(ptr_bit_set);
+						fZone.fFrames[index].fState = kBitMapStateUsed | new_order;
+						return Yes;
+					}
+
+					// we can only grow if we are the lower buddy at each level, and the upper one is free.
+					for (SizeT cur_order = order; cur_order < new_order; ++cur_order)
+					{
+						SizeT buddy = index + (1UL << cur_order);
+
+						if ((index & ((1UL << (cur_order + 1)) - 1)) != 0 ||
+							buddy >= fZone.fPageCount ||
+							fZone.fFrames[buddy].fState != (kBitMapStateFree | cur_order))
+							return No;
+					}
+
+					for (SizeT cur_order = order; cur_order < new_order; ++cur_order)
+						this->PopFree(index + (1UL << cur_order), cur_order);
+
+					fZone.fFrames[index].fState = kBitMapStateUsed | new_order;
 
 					return Yes;
 				}
 
+				/// @brief Gets the size in bytes of an allocated block.
+				auto SizeOfBitMap(VoidPtr page_ptr) -> SizeT
+				{
+					SizeT head = this->FindHead(page_ptr);
+
+					if (head == fZone.fPageCount)
+						return 0UL;
+
+					return (1UL << (fZone.fFrames[head].fState & kBitMapOrderMask)) * kPageSize;
+				}
+
 				UInt32 MakeMMFlags(Bool wr, Bool user)
 				{
 					UInt32 flags = kMMFlagsPresent;
@@ -79,107 +363,442 @@ namespace OpenNE
 					return flags;
 				}
 
-				/// @brief Iterate over availables pages for a free one.
+				/// @brief Take the smallest free block which fits size, splitting bigger blocks.
 				/// @return The new address which was found.
-				auto FindBitMap(VoidPtr base_ptr, SizeT size, Bool wr, Bool user) -> VoidPtr
+				auto FindBitMap(SizeT size, Bool user) -> VoidPtr
 				{
-					if (!size)
+					if (!size || !fZone.fReady)
 						return nullptr;
 
-					VoidPtr base = reinterpret_cast<VoidPtr>(((UIntPtr)base_ptr) + kPageSize);
+					SizeT order = this->OrderOf(size);
 
-					while (YES)
-					{
-						UIntPtr* ptr_bit_set = reinterpret_cast<UIntPtr*>(base);
+					if (order > kBitMapMaxOrder)
+						return nullptr;
 
-						if (ptr_bit_set[kBitMapMagIdx] == kBitMapMagic &&
-							ptr_bit_set[kBitMapSizeIdx] <= size)
-						{
-							if (ptr_bit_set[kBitMapUsedIdx] == No)
-							{
-								ptr_bit_set[kBitMapSizeIdx] = size;
-								ptr_bit_set[kBitMapUsedIdx] = Yes;
+					SizeT cur_order = order;
+
+					while (cur_order <= kBitMapMaxOrder && !fZone.fFreeList[cur_order])
+						++cur_order;
 
-								this->GetBitMapStatus(ptr_bit_set);
+					if (cur_order > kBitMapMaxOrder)
+						return nullptr;
 
-								UInt32 flags = this->MakeMMFlags(wr, user);
+					SizeT index = this->IndexOf(fZone.fFreeList[cur_order]);
+					this->PopFree(index, cur_order);
 
-								return (VoidPtr)ptr_bit_set;
-							}
+					// give back the upper halves until we reach the requested order.
+					while (cur_order > order)
+					{
+						--cur_order;
+						this->PushFree(index + (1UL << cur_order), cur_order);
+					}
 
-							kout << "Missed potential BitMap as it is already used!\r\n";
-						}
-						else if (ptr_bit_set[kBitMapMagIdx] != kBitMapMagic)
-						{
-							ptr_bit_set[kBitMapMagIdx]	= kBitMapMagic;
-							ptr_bit_set[kBitMapSizeIdx] = size;
-							ptr_bit_set[kBitMapUsedIdx] = Yes;
+					fZone.fFrames[index].fState = kBitMapStateUsed | order;
+					fZone.fFrames[index].fOwner = user ? kPageOwnerUser : kPageOwnerKernel;
+
+					return reinterpret_cast<VoidPtr>(fZone.fBase + index * kPageSize);
+				}
+
+				/// @brief Identity map a whole block, using the biggest pages its alignment allows.
+				/// @param size the size of the block, taken under the zone's lock.
+				auto MapBitMap(VoidPtr page_ptr, SizeT size, Bool wr, Bool user) -> Void
+				{
+					UInt32 flags = this->MakeMMFlags(wr, user);
+
+#ifdef __OPENNE_AMD64__
+					mm_map_range(page_ptr, page_ptr, size, flags);
+#else
+					mm_map_page(page_ptr, page_ptr, flags);
+#endif // ifdef __OPENNE_AMD64__
+				}
 
-							this->GetBitMapStatus(ptr_bit_set);
+				/// @brief Print Bitmap status
+				auto GetBitMapStatus() -> Void
+				{
+					kout << "BitMap Base: " << hex_number(fZone.fBase) << endl;
+					kout << "BitMap Pages: " << number(fZone.fPageCount) << endl;
+					kout << "BitMap Free Pages: " << number(fZone.fFreePages) << endl;
 
-							UInt32 flags = this->MakeMMFlags(wr, user);
-							mm_map_page(ptr_bit_set, ptr_bit_set, flags);
+					for (SizeT order = 0; order <= kBitMapMaxOrder; ++order)
+					{
+						SizeT			   count = 0;
+						BITMAP_FREE_BLOCK* block = fZone.fFreeList[order];
 
-							return (VoidPtr)ptr_bit_set;
+						while (block)
+						{
+							++count;
+							block = block->fNext;
 						}
 
-						base = reinterpret_cast<VoidPtr>(reinterpret_cast<UIntPtr>(base) + ((ptr_bit_set[kBitMapMagIdx] != kBitMapMagic) ? (size) : ptr_bit_set[kBitMapSizeIdx]));
-					}
+						if (!count)
+							continue;
 
-					return nullptr;
+						kout << "BitMap Order: " << number(order) << endl;
+						kout << "BitMap Free Blocks: " << number(count) << endl;
+					}
 				}
 
-				/// @brief Print Bitmap status
-				auto GetBitMapStatus(UIntPtr* ptr_bit_set) -> Void
+			private:
+				/// @brief Gets the head page of the allocated block which holds ptr.
+				/// @return fPageCount if ptr isn't allocated.
+				SizeT FindHead(VoidPtr ptr)
 				{
-					if (!this->IsBitMap(ptr_bit_set))
+					if (!fZone.fReady || !ptr)
+						return fZone.fPageCount;
+
+					UIntPtr addr = reinterpret_cast<UIntPtr>(ptr);
+
+					if (addr < fZone.fBase)
+						return fZone.fPageCount;
+
+					SizeT index = (addr - fZone.fBase) / kPageSize;
+
+					if (index >= fZone.fPageCount)
+						return fZone.fPageCount;
+
+					// a block of order N starts at index rounded down to 2^N.
+					for (SizeT order = 0; order <= kBitMapMaxOrder; ++order)
 					{
-						kout << "Not a BitMap: " << hex_number((UIntPtr)ptr_bit_set) << endl;
-						return;
+						SizeT head = index & ~((1UL << order) - 1);
+
+						if (fZone.fFrames[head].fState == (kBitMapStateUsed | order))
+							return head;
 					}
 
-					kout << "Magic Number: " << hex_number(ptr_bit_set[kBitMapMagIdx]) << endl;
-					kout << "Is Allocated: " << (ptr_bit_set[kBitMapUsedIdx] ? "Yes" : "No") << endl;
-					kout << "Size of BitMap (B): " << number(ptr_bit_set[kBitMapSizeIdx]) << endl;
-					kout << "Size of BitMap (KIB): " << number(KIB(ptr_bit_set[kBitMapSizeIdx])) << endl;
-					kout << "Size of BitMap (MIB): " << number(MIB(ptr_bit_set[kBitMapSizeIdx])) << endl;
-					kout << "Size of BitMap (GIB): " << number(GIB(ptr_bit_set[kBitMapSizeIdx])) << endl;
-					kout << "Size of BitMap (TIB): " << number(TIB(ptr_bit_set[kBitMapSizeIdx])) << endl;
-					kout << "Address Of BitMap Header: " << hex_number((UIntPtr)ptr_bit_set) << endl;
+					return fZone.fPageCount;
+				}
+
+				SizeT OrderOf(SizeT size)
+				{
+					SizeT pages = (size + kPageSize - 1) / kPageSize;
+					SizeT order = 0;
+
+					while ((1UL << order) < pages)
+						++order;
+
+					return order;
+				}
+
+				SizeT IndexOf(BITMAP_FREE_BLOCK* block)
+				{
+					return (reinterpret_cast<UIntPtr>(block) - fZone.fBase) / kPageSize;
 				}
+
+				Void PushFree(SizeT index, SizeT order)
+				{
+					BITMAP_FREE_BLOCK* block = reinterpret_cast<BITMAP_FREE_BLOCK*>(fZone.fBase + index * kPageSize);
+
+					block->fPrev = nullptr;
+					block->fNext = fZone.fFreeList[order];
+
+					if (block->fNext)
+						block->fNext->fPrev = block;
+
+					fZone.fFreeList[order]		= block;
+					fZone.fFrames[index].fState = kBitMapStateFree | order;
+					fZone.fFreePages += (1UL << order);
+				}
+
+				Void PopFree(SizeT index, SizeT order)
+				{
+					BITMAP_FREE_BLOCK* block = reinterpret_cast<BITMAP_FREE_BLOCK*>(fZone.fBase + index * kPageSize);
+
+					if (block->fPrev)
+						block->fPrev->fNext = block->fNext;
+					else
+						fZone.fFreeList[order] = block->fNext;
+
+					if (block->fNext)
+						block->fNext->fPrev = block->fPrev;
+
+					fZone.fFrames[index].fState = kBitMapStateNone;
+					fZone.fFreePages -= (1UL << order);
+				}
+
+			private:
+				BITMAP_ZONE& fZone;
 			};
 		} // namespace Detail
 
+		/// @brief Set the memory locality, before mm_init_bitmap partitions the pages by node.
+		/// @param topology the nodes, their memory ranges and distances, see ACPIFactoryInterface::Topology.
+		auto mm_set_topology(const NUMA_TOPOLOGY& topology) -> Void
+		{
+			Detail::kBitMapTopology = topology;
+
+			if (Detail::kBitMapTopology.fNodeCount > kNumaMaxNodes)
+				Detail::kBitMapTopology.fNodeCount = kNumaMaxNodes;
+
+			if (Detail::kBitMapTopology.fRangeCount > kNumaMaxRanges)
+				Detail::kBitMapTopology.fRangeCount = kNumaMaxRanges;
+		}
+
+		/// @brief Node of a core, by APIC ID (or the architecture's equivalent).
+		/// @return The node, zero without a topology.
+		auto mm_node_of(UInt32 core_id) -> UInt32
+		{
+			if (core_id >= kNumaMaxCores ||
+				Detail::kBitMapTopology.fCoreNode[core_id] >= Detail::kBitMapTopology.fNodeCount)
+				return 0U;
+
+			return Detail::kBitMapTopology.fCoreNode[core_id];
+		}
+
+		/// @brief Free pages of a node, zero if it doesn't exist.
+		auto mm_free_pages_of(UInt32 node) -> SizeT
+		{
+			SizeT free = 0UL;
+
+			for (SizeT index = 0; index < Detail::kBitMapZoneCount; ++index)
+			{
+				if (Detail::kBitMapZone[index].fNode == node)
+					free += Detail::kBitMapZone[index].fFreePages;
+			}
+
+			return free;
+		}
+
+		/// @brief Setup the page allocator over the handover range.
+		/// The range is split along the topology's memory ranges, one zone each.
+		/// @param base the start of the range.
+		/// @param size the size of the range.
+		/// @return if the allocator is ready.
+		auto mm_init_bitmap(VoidPtr base, SizeT size) -> Bool
+		{
+			UIntPtr start = reinterpret_cast<UIntPtr>(base);
+			UIntPtr end	  = start + size;
+
+			Detail::kBitMapZoneCount = 0UL;
+			Detail::mmi_order_nodes();
+
+			for (SizeT index = 0; index < Detail::kBitMapTopology.fRangeCount; ++index)
+			{
+				UIntPtr range_start = Detail::kBitMapTopology.fRanges[index].fBase;
+				UIntPtr range_end	= range_start + Detail::kBitMapTopology.fRanges[index].fSize;
+
+				range_start = range_start > start ? range_start : start;
+				range_end	= range_end < end ? range_end : end;
+
+				if (range_end <= range_start)
+					continue;
+
+				Detail::BITMAP_ZONE& zone = Detail::kBitMapZone[Detail::kBitMapZoneCount];
+				Detail::IBitMapProxy proxy(zone);
+
+				// too small to hold its state array and a page.
+				if (!proxy.InitZone(reinterpret_cast<VoidPtr>(range_start), range_end - range_start))
+					continue;
+
+				zone.fNode = Detail::kBitMapTopology.fRanges[index].fNode;
+				++Detail::kBitMapZoneCount;
+			}
+
+			if (Detail::kBitMapZoneCount > 0)
+				return Yes;
+
+			// no topology, or it doesn't describe our range: everything is node 0.
+			Detail::IBitMapProxy proxy(Detail::kBitMapZone[0]);
+
+			if (!proxy.InitZone(base, size))
+				return No;
+
+			Detail::kBitMapZone[0].fNode = 0U;
+			Detail::kBitMapZoneCount	 = 1UL;
+
+			return Yes;
+		}
+
 		auto mm_is_bitmap(VoidPtr ptr) -> Bool
 		{
-			Detail::IBitMapProxy proxy;
-			return proxy.IsBitMap(ptr);
+			Detail::BITMAP_ZONE* zone = Detail::mmi_zone_of(ptr);
+
+			if (!zone)
+				return No;
+
+			Detail::IBitMapProxy proxy(*zone);
+
+			Detail::mmi_lock_zone(*zone);
+			Bool ret = proxy.IsBitMap(ptr);
+			Detail::mmi_unlock_zone(*zone);
+
+			return ret;
 		}
 
 		/// @brief Allocate a new page to be used by the OS.
+		/// The zones of the current core's node come first, then the others by SLIT distance.
 		/// @param wr read/write bit.
 		/// @param user user bit.
+		/// @param is_page don't map the block, the caller does it (page tables, page caches).
 		/// @return a new bitmap allocated pointer.
 		auto mm_alloc_bitmap(Boolean wr, Boolean user, SizeT size, Bool is_page) -> VoidPtr
 		{
-			VoidPtr ptr_new = nullptr;
+			if (!Detail::kBitMapZoneCount)
+				mm_init_bitmap(kKernelBitMpStart, kKernelBitMpSize);
+
+			const UInt32 cNode = Detail::mmi_current_node();
+
+			VoidPtr				 ptr_new  = nullptr;
+			Detail::BITMAP_ZONE* zone	  = nullptr;
+			SizeT				 size_new = 0UL;
+
+			SizeT nodes = Detail::kBitMapTopology.fNodeCount ? Detail::kBitMapTopology.fNodeCount : 1UL;
+
+			for (SizeT rank = 0; rank < nodes && !ptr_new; ++rank)
+			{
+				UInt32 node = Detail::kBitMapNodeOrder[cNode][rank];
+
+				for (SizeT index = 0; index < Detail::kBitMapZoneCount && !ptr_new; ++index)
+				{
+					if (Detail::kBitMapZone[index].fNode != node)
+						continue;
+
+					zone = &Detail::kBitMapZone[index];
+
+					Detail::IBitMapProxy proxy(*zone);
+
+					Detail::mmi_lock_zone(*zone);
+
+					ptr_new = proxy.FindBitMap(size, user);
+
+					if (ptr_new)
+						size_new = proxy.SizeOfBitMap(ptr_new);
+
+					Detail::mmi_unlock_zone(*zone);
+				}
+			}
 
-			Detail::IBitMapProxy proxy;
-			ptr_new = proxy.FindBitMap(kKernelBitMpStart, size, wr, user);
+			// out of pages: the caller may be in the middle of a mapping or a fault, so it fails,
+			// and the pages are swapped out at the next safe point, see mm_reclaim_idle.
+			if (!ptr_new)
+			{
+				__atomic_fetch_add(&Detail::kBitMapReclaimWanted, size, __ATOMIC_RELAXED);
+				return nullptr;
+			}
 
-			MUST_PASS(ptr_new);
+			// raw pages are mapped by the caller.
+			if (ptr_new && !is_page)
+			{
+				Detail::IBitMapProxy proxy(*zone);
+				proxy.MapBitMap(ptr_new, size_new, wr, user);
+			}
 
 			return (UIntPtr*)ptr_new;
 		}
 
+		/// @brief Resize a bitmap allocation in place.
+		/// @param ptr the pointer returned by mm_alloc_bitmap.
+		/// @param size the new size.
+		/// @param wr read/write bit of the pages it grows over.
+		/// @param user user bit of the pages it grows over.
+		/// @return if it was resized, the allocation is left untouched otherwise.
+		auto mm_resize_bitmap(VoidPtr ptr, SizeT size, Boolean wr, Boolean user) -> Bool
+		{
+			Detail::BITMAP_ZONE* zone = Detail::mmi_zone_of(ptr);
+
+			if (!zone)
+				return No;
+
+			Detail::IBitMapProxy proxy(*zone);
+
+			Detail::mmi_lock_zone(*zone);
+
+			const SizeT cOldSz	= proxy.SizeOfBitMap(ptr);
+			const Bool	cResize = proxy.ResizeBitMap(ptr, size);
+			const SizeT cNewSz	= proxy.SizeOfBitMap(ptr);
+
+			Detail::mmi_unlock_zone(*zone);
+
+			if (!cResize)
+				return No;
+
+			// the absorbed buddies were free, so nothing maps them like the block yet.
+			if (cNewSz > cOldSz)
+			{
+				VoidPtr added = reinterpret_cast<VoidPtr>(reinterpret_cast<UIntPtr>(ptr) + cOldSz);
+
+#ifdef __OPENNE_AMD64__
+				mm_map_range(added, added, cNewSz - cOldSz, proxy.MakeMMFlags(wr, user));
+#else
+				for (SizeT offset = 0; offset < cNewSz - cOldSz; offset += kPageSize)
+				{
+					VoidPtr page = reinterpret_cast<VoidPtr>(reinterpret_cast<UIntPtr>(added) + offset);
+					mm_map_page(page, page, proxy.MakeMMFlags(wr, user));
+				}
+#endif // ifdef __OPENNE_AMD64__
+			}
+
+			return Yes;
+		}
+
+		/// @brief Gets the size of the bitmap allocation which holds ptr.
+		/// @return the size in bytes, zero if it's not allocated.
+		auto mm_size_of_bitmap(VoidPtr ptr) -> SizeT
+		{
+			Detail::BITMAP_ZONE* zone = Detail::mmi_zone_of(ptr);
+
+			if (!zone)
+				return 0UL;
+
+			Detail::IBitMapProxy proxy(*zone);
+
+			Detail::mmi_lock_zone(*zone);
+			SizeT ret = proxy.SizeOfBitMap(ptr);
+			Detail::mmi_unlock_zone(*zone);
+
+			return ret;
+		}
+
+		/// @brief Descriptor of the frame holding ptr, the frame itself isn't touched.
+		/// @return nullptr if ptr isn't managed by the page allocator.
+		auto mm_frame_of(VoidPtr ptr) -> PAGE_FRAME*
+		{
+			Detail::BITMAP_ZONE* zone = Detail::mmi_zone_of(ptr);
+
+			if (!zone)
+				return nullptr;
+
+			return &zone->fFrames[(reinterpret_cast<UIntPtr>(ptr) - zone->fBase) / kPageSize];
+		}
+
+		/// @brief Set the reclaimer, called by mm_reclaim_idle.
+		/// @param proc the reclaimer, nullptr to disable reclaim.
+		auto mm_set_reclaim(mm_reclaim_proc proc) -> Void
+		{
+			__atomic_store_n(&Detail::kBitMapReclaim, proc, __ATOMIC_RELEASE);
+		}
+
+		/// @brief Bring the free pages back over the high watermark once under the low one,
+		/// or once an allocation failed, plus what it asked for.
+		/// To be called from a safe point, with no mapping being built, such as an idle loop.
+		/// @return if the reclaimer ran.
+		auto mm_reclaim_idle() -> Bool
+		{
+			if (!Detail::kBitMapZoneCount)
+				return No;
+
+			SizeT wanted = __atomic_exchange_n(&Detail::kBitMapReclaimWanted, 0UL, __ATOMIC_RELAXED);
+
+			if (!wanted && Detail::mmi_free_pages() >= kBitMapLowWatermark)
+				return No;
+
+			Detail::mmi_reclaim(wanted);
+
+			return Yes;
+		}
+
 		/// @brief Free Bitmap, and mark it as absent.
 		auto mm_free_bitmap(VoidPtr ptr) -> Bool
 		{
-			if (!ptr)
+			Detail::BITMAP_ZONE* zone = Detail::mmi_zone_of(ptr);
+
+			if (!ptr || !zone)
 				return No;
 
-			Detail::IBitMapProxy proxy;
-			Bool				 ret = proxy.FreeBitMap(ptr);
+			Detail::IBitMapProxy proxy(*zone);
+
+			Detail::mmi_lock_zone(*zone);
+			Bool ret = proxy.FreeBitMap(ptr);
+			Detail::mmi_unlock_zone(*zone);
 
 			return ret;
 		}
@@ -27,34 +27,39 @@ namespace OpenNE
 	/// @brief reads from an ATA drive.
 	/// @param pckt Packet structure (fPacketContent must be non null)
 	/// @return
-	Void io_drv_input(DriveTrait::DrivePacket pckt)
+	Void io_drv_input(DriveTrait::DrivePacket& pckt)
 	{
 #ifdef __AHCI__
-		drv_std_read(pckt.fPacketLba, (Char*)pckt.fPacketContent, kAHCISectorSize, pckt.fPacketSize);
+		pckt.fPacketGood = drv_std_read(pckt.fPacketLba, (Char*)pckt.fPacketContent, kAHCISectorSize, pckt.fPacketSize);
 #elif defined(__ATA_PIO__) || defined(__ATA_DMA__)
 		drv_std_read(pckt.fPacketLba, kATAIO, kATAMaster, (Char*)pckt.fPacketContent, ATA_SECTOR_SZ, pckt.fPacketSize);
+		pckt.fPacketGood = YES;
 #endif
 	}
 
 	/// @brief Writes to an ATA drive.
 	/// @param pckt the packet to write.
 	/// @return
-	Void io_drv_output(DriveTrait::DrivePacket pckt)
+	Void io_drv_output(DriveTrait::DrivePacket& pckt)
 	{
 		if (pckt.fPacketReadOnly)
+		{
+			pckt.fPacketGood = NO;
 			return;
+		}
 
 #ifdef __AHCI__
-		drv_std_write(pckt.fPacketLba, (Char*)pckt.fPacketContent, kAHCISectorSize, pckt.fPacketSize);
+		pckt.fPacketGood = drv_std_write(pckt.fPacketLba, (Char*)pckt.fPacketContent, kAHCISectorSize, pckt.fPacketSize);
 #elif defined(__ATA_PIO__) || defined(__ATA_DMA__)
 		drv_std_write(pckt.fPacketLba, kATAIO, kATAMaster, (Char*)pckt.fPacketContent, ATA_SECTOR_SZ, pckt.fPacketSize);
+		pckt.fPacketGood = YES;
 #endif
 	}
 
 	/// @brief Executes a disk check on the ATA drive.
 	/// @param pckt the packet to read.
 	/// @return
-	Void io_drv_init(DriveTrait::DrivePacket pckt)
+	Void io_drv_init(DriveTrait::DrivePacket& pckt)
 	{
 #if defined(__ATA_PIO__) || defined(__ATA_DMA__)
 		kATAMaster = 0;
@@ -120,9 +125,9 @@ namespace OpenNE
 
 	/// @brief Unimplemented drive function.
 	/// @param pckt the packet to read.
-	Void io_drv_unimplemented(DriveTrait::DrivePacket pckt) noexcept
+	Void io_drv_unimplemented(DriveTrait::DrivePacket& pckt) noexcept
 	{
-		OPENNE_UNUSED(pckt);
+		pckt.fPacketGood = NO;
 	}
 
 	/// @brief Makes a new drive.
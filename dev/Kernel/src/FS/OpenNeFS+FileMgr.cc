@@ -18,7 +18,7 @@ namespace OpenNE
 	/// @brief C++ constructor
 	NeFileSystemMgr::NeFileSystemMgr()
 	{
-		NeFileSystemParser* mParser = new NeFileSystemParser();
+		mParser = new NeFileSystemParser();
 		MUST_PASS(mParser);
 
 		kout << "We are done allocating NeFileSystemParser...\r";
@@ -68,12 +68,38 @@ namespace OpenNE
 		return node_cast(mParser->CreateCatalog(path, 0, kNeFSCatalogKindAlias));
 	}
 
-	/// @brief Creates a node with is a page file.
+	/// @brief Creates a node with is a page file, its data fork takes sz bytes from the start.
 	/// @param path The filename path.
+	/// @param sz The size of the page file.
 	/// @return The Node pointer.
-	NodePtr NeFileSystemMgr::CreateSwapFile(const Char* path)
+	NodePtr NeFileSystemMgr::CreateSwapFile(const Char* path, const SizeT sz)
 	{
-		return node_cast(mParser->CreateCatalog(path, 0, kNeFSCatalogKindPage));
+		if (!path || *path == 0 || !sz)
+			return nullptr;
+
+		auto catalog = mParser->CreateCatalog(path, 0, kNeFSCatalogKindPage);
+
+		if (!catalog)
+			return nullptr;
+
+		// pages are written in place, so the whole fork is laid out now.
+		ONEFS_FORK_STRUCT fork{};
+
+		rt_copy_memory((VoidPtr)kNeFSDataFork, fork.ForkName, rt_string_len(kNeFSDataFork));
+		rt_copy_memory((VoidPtr)path, fork.CatalogName, rt_string_len(path));
+
+		fork.Kind	  = kNeFSDataForkKind;
+		fork.DataSize = sz;
+
+		if (!mParser->CreateFork(fork))
+		{
+			delete catalog;
+			mParser->RemoveCatalog(path);
+
+			return nullptr;
+		}
+
+		return node_cast(catalog);
 	}
 
 	/// @brief Gets the root directory.
@@ -193,6 +219,34 @@ namespace OpenNE
 		return nullptr;
 	}
 
+	/// @brief Writes in place inside the data of a page file.
+	/// @param node the page file.
+	/// @param off where inside its data.
+	/// @param data the data.
+	/// @param size its size.
+	/// @return if the drive took the data.
+	Bool NeFileSystemMgr::WriteAt(_Input NodePtr node, _Input SizeT off, _Input VoidPtr data, _Input SizeT size)
+	{
+		if (!node || !data || !size)
+			return NO;
+
+		return mParser->WriteCatalogAt(reinterpret_cast<ONEFS_CATALOG_STRUCT*>(node), off, data, size);
+	}
+
+	/// @brief Reads in place from the data of a page file.
+	/// @param node the page file.
+	/// @param off where inside its data.
+	/// @param data where to read to.
+	/// @param size its size.
+	/// @return if the drive gave the data.
+	Bool NeFileSystemMgr::ReadAt(_Input NodePtr node, _Input SizeT off, _Input VoidPtr data, _Input SizeT size)
+	{
+		if (!node || !data || !size)
+			return NO;
+
+		return mParser->ReadCatalogAt(reinterpret_cast<ONEFS_CATALOG_STRUCT*>(node), off, data, size);
+	}
+
 	/// @brief Seek from Catalog.
 	/// @param node
 	/// @param off
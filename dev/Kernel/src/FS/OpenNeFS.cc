@@ -19,6 +19,7 @@
 #include <KernelKit/UserProcessScheduler.h>
 #include <KernelKit/User.h>
 #include <KernelKit/DriveMgr.h>
+#include <KernelKit/MemoryMgr.h>
 
 using namespace OpenNE;
 
@@ -141,7 +142,11 @@ _Output BOOL NeFileSystemParser::CreateFork(_Input ONEFS_FORK_STRUCT& the_input_
 
 		// drv.fOutput(drv.fPacket);
 
-		fs_ifs_write(&kMountpoint, drv, MountpointInterface::kDriveIndexA);
+		if (!fs_ifs_write(&kMountpoint, drv, MountpointInterface::kDriveIndexA))
+		{
+			kout << "Couldn't write fork.\r";
+			return NO;
+		}
 
 		/// log what we have now.
 		kout << "Wrote fork data at: " << hex_number(the_input_fork.DataOffset)
@@ -178,25 +183,10 @@ _Output ONEFS_FORK_STRUCT* NeFileSystemParser::FindFork(_Input ONEFS_CATALOG_STR
 
 		rt_copy_memory((VoidPtr) "fs/nefs-packet", drive.fPacket.fPacketMime, 16);
 
-		if (auto res =
-				fs_ifs_read(&kMountpoint, drive, this->mDriveIndex);
-			res)
+		// the packet tells if the read went through.
+		if (!fs_ifs_read(&kMountpoint, drive, this->mDriveIndex))
 		{
-			switch (res)
-			{
-			case 1:
-				err_global_get() = kErrorDiskReadOnly;
-				break;
-			case 2:
-				err_global_get() = kErrorDiskIsFull;
-				break;
-			case 3:
-				err_global_get() = kErrorNoSuchDisk;
-				break;
-
-			default:
-				break;
-			}
+			err_global_get() = kErrorDisk;
 			return nullptr;
 		}
 
@@ -618,7 +608,12 @@ bool NeFileSystemParser::WriteCatalog(_Input const Char* catalog_name, Bool is_r
 	if (size_of_data < 1)
 		return No;
 
-	auto buf = new UInt8[size_of_data];
+	// the drive transfers straight from it, it must be physically contiguous.
+	auto buf = reinterpret_cast<UInt8*>(mm_new_heap(size_of_data, Yes, No, Yes));
+
+	if (!buf)
+		return No;
+
 	rt_set_memory(buf, 0, size_of_data);
 
 	rt_copy_memory(data, buf, size_of_data);
@@ -632,7 +627,7 @@ bool NeFileSystemParser::WriteCatalog(_Input const Char* catalog_name, Bool is_r
 
 	if (!catalog)
 	{
-		delete[] buf;
+		mm_delete_heap(buf);
 		buf = nullptr;
 		return NO;
 	}
@@ -685,7 +680,7 @@ bool NeFileSystemParser::WriteCatalog(_Input const Char* catalog_name, Bool is_r
 			kout << "wrote data at offset: " << hex_number(fork_data_input->DataOffset) << endl;
 
 			delete fork_data_input;
-			delete buf;
+			mm_delete_heap(buf);
 
 			return true;
 		}
@@ -697,7 +692,7 @@ bool NeFileSystemParser::WriteCatalog(_Input const Char* catalog_name, Bool is_r
 		startFork = fork_data_input->NextSibling;
 	}
 
-	delete buf;
+	mm_delete_heap(buf);
 	delete fork_data_input;
 
 	return false;
@@ -925,7 +920,8 @@ Boolean NeFileSystemParser::RemoveCatalog(_Input const Char* catalog_name)
 }
 
 /// ***************************************************************** ///
-/// Reading,Seek,Tell are unimplemented on catalogs, refer to forks I/O instead.
+/// Seek,Tell are unimplemented on catalogs, refer to forks I/O instead.
+/// Page catalogs are read and written in place, see WriteCatalogAt.
 /// ***************************************************************** ///
 
 /***********************************************************************************/
@@ -1026,6 +1022,112 @@ SizeT NeFileSystemParser::Tell(_Input _Output ONEFS_CATALOG_STRUCT* catalog)
 	return 0;
 }
 
+/***********************************************************************************/
+/// @brief Transfer from or to the data fork of a page catalog.
+/// The fork of a page catalog is made with its full size, so any range of it is one extent.
+/// @param catalog the page catalog.
+/// @param off where inside the fork.
+/// @param data the buffer.
+/// @param sz the size of the transfer.
+/// @param write writes data when set, reads into it otherwise.
+/// @return if the drive made the transfer.
+/***********************************************************************************/
+
+STATIC Bool fs_nefs_page_io(ONEFS_CATALOG_STRUCT* catalog, SizeT off, VoidPtr data, SizeT sz, Bool write, Int32 drive_index)
+{
+	if (!catalog || !data || !sz)
+	{
+		err_global_get() = kErrorInvalidData;
+		return NO;
+	}
+
+	if (catalog->Kind != kNeFSCatalogKindPage)
+	{
+		err_global_get() = kErrorUnimplemented;
+		return NO;
+	}
+
+	if (catalog->DataFork < kNeFSCatalogStartAddress)
+	{
+		err_global_get() = kErrorFileNotFound;
+		return NO;
+	}
+
+	auto drive = kMountpoint.A();
+
+	rt_copy_memory((VoidPtr) "fs/nefs-packet", drive.fPacket.fPacketMime,
+				   rt_string_len("fs/nefs-packet"));
+
+	ONEFS_FORK_STRUCT fork{};
+
+	drive.fPacket.fPacketContent = &fork;
+	drive.fPacket.fPacketSize	 = sizeof(ONEFS_FORK_STRUCT);
+	drive.fPacket.fPacketLba	 = catalog->DataFork;
+
+	if (!fs_ifs_read(&kMountpoint, drive, drive_index))
+	{
+		err_global_get() = kErrorDisk;
+		return NO;
+	}
+
+	if (!(fork.Flags & kNeFSFlagCreated) ||
+		!StringBuilder::Equals(fork.ForkName, kNeFSDataFork) ||
+		!StringBuilder::Equals(fork.CatalogName, catalog->Name))
+	{
+		err_global_get() = kErrorDiskIsCorrupted;
+		return NO;
+	}
+
+	if (sz > fork.DataSize || off > fork.DataSize - sz)
+	{
+		err_global_get() = kErrorInvalidData;
+		return NO;
+	}
+
+	drive.fPacket.fPacketContent = data;
+	drive.fPacket.fPacketSize	 = sz;
+	drive.fPacket.fPacketLba	 = fork.DataOffset + off;
+
+	Int32 good = write ? fs_ifs_write(&kMountpoint, drive, drive_index)
+					   : fs_ifs_read(&kMountpoint, drive, drive_index);
+
+	if (!good)
+	{
+		err_global_get() = kErrorDisk;
+		return NO;
+	}
+
+	return YES;
+}
+
+/***********************************************************************************/
+/// @brief Write in place inside the data fork of a page catalog.
+/// @param catalog the page catalog.
+/// @param off where inside the fork.
+/// @param data the data.
+/// @param sz its size.
+/// @return if the drive took the data.
+/***********************************************************************************/
+
+Bool NeFileSystemParser::WriteCatalogAt(_Input ONEFS_CATALOG_STRUCT* catalog, _Input SizeT off, _Input VoidPtr data, _Input SizeT sz)
+{
+	return fs_nefs_page_io(catalog, off, data, sz, YES, this->mDriveIndex);
+}
+
+/***********************************************************************************/
+/// @brief Read in place from the data fork of a page catalog.
+/// @param catalog the page catalog.
+/// @param off where inside the fork.
+/// @param data where to read to.
+/// @param sz its size.
+/// @return if the drive gave the data.
+/***********************************************************************************/
+
+Bool NeFileSystemParser::ReadCatalogAt(_Input ONEFS_CATALOG_STRUCT* catalog, _Input SizeT off, _Input VoidPtr data, _Input SizeT sz)
+{
+	return fs_nefs_page_io(catalog, off, data, sz, NO, this->mDriveIndex);
+}
+
 namespace OpenNE::NeFS
 {
 	/***********************************************************************************/
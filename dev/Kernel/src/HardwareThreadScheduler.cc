@@ -26,6 +26,9 @@ namespace OpenNE
 
 	STATIC HardwareThreadScheduler kHardwareThreadScheduler;
 
+	/// @brief APIC ID + 1 of the core owning each slot, zero when it is free.
+	STATIC UInt32 kHardwareThreadSlots[kMaxAPInsideSched] = {0};
+
 	///! A HardwareThread class takes care of it's owned hardware thread.
 	///! It has a stack for it's core.
 
@@ -215,4 +218,49 @@ namespace OpenNE
 	{
 		return fThreadList.Count();
 	}
+
+	/***********************************************************************************/
+	/// @brief Returns the index of the hardware thread we're running on.
+	/// A core takes the first free slot the first time it asks, and keeps it.
+	/// @return the index, kMaxAPInsideSched if every slot belongs to another core.
+	/***********************************************************************************/
+	ThreadID HardwareThreadScheduler::CurrentID() noexcept
+	{
+#ifdef __OPENNE_AMD64__
+		const UInt32 cKey = HAL::hal_apic_id() + 1;
+
+		for (ThreadID index = 0; index < kMaxAPInsideSched; ++index)
+		{
+			if (__atomic_load_n(&kHardwareThreadSlots[index], __ATOMIC_ACQUIRE) == cKey)
+				return index;
+		}
+
+		for (ThreadID index = 0; index < kMaxAPInsideSched; ++index)
+		{
+			UInt32 owner = 0U;
+
+			// another core may win the slot under us.
+			if (__atomic_compare_exchange_n(&kHardwareThreadSlots[index], &owner, cKey, No,
+											__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				return index;
+		}
+
+		return kMaxAPInsideSched;
+#else
+		return 0;
+#endif // ifdef __OPENNE_AMD64__
+	}
+
+	/***********************************************************************************/
+	/// @brief Returns the NUMA node of the current hardware thread.
+	/// @return the node, the page allocator prefers its memory.
+	/***********************************************************************************/
+	UInt32 HardwareThreadScheduler::CurrentNode() noexcept
+	{
+#ifdef __OPENNE_AMD64__
+		return HAL::mm_node_of(HAL::hal_apic_id());
+#else
+		return 0U;
+#endif // ifdef __OPENNE_AMD64__
+	}
 } // namespace OpenNE
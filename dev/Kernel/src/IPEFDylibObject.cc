@@ -41,19 +41,25 @@ using namespace OpenNE;
 
 EXTERN_C IDylibRef rtl_init_dylib(UserProcess& thread)
 {
-	IDylibRef dll_obj = tls_new_class<IPEFDylibObject>();
+	// thread isn't running yet, so allocate from its arena and not from the current one.
+	auto dll_ptr = thread.NewLocal(sizeof(IPEFDylibObject));
 
-	if (!dll_obj)
+	if (!dll_ptr)
 	{
 		thread.Crash();
 		return nullptr;
 	}
 
+	IDylibRef dll_obj = reinterpret_cast<IDylibRef>(dll_ptr.Leak().Leak());
+	*dll_obj		  = IPEFDylibObject();
+
 	dll_obj->Mount(new IPEFDylibObject::DLL_TRAITS());
 
 	if (!dll_obj->Get())
 	{
-		tls_delete_class(dll_obj);
+		dll_obj->~IPEFDylibObject();
+		thread.DeleteLocal(dll_obj, sizeof(IPEFDylibObject));
+
 		thread.Crash();
 
 		return nullptr;
@@ -64,7 +70,9 @@ EXTERN_C IDylibRef rtl_init_dylib(UserProcess& thread)
 
 	if (!dll_obj->Get()->ImageObject)
 	{
-		tls_delete_class(dll_obj);
+		dll_obj->~IPEFDylibObject();
+		thread.DeleteLocal(dll_obj, sizeof(IPEFDylibObject));
+
 		thread.Crash();
 
 		return nullptr;
@@ -95,7 +103,10 @@ EXTERN_C Void rtl_fini_dylib(UserProcess& thread, IDylibRef dll_obj, Bool* succe
 	}
 
 	delete dll_obj->Get();
-	delete dll_obj;
+
+	// its room goes along with the thread's arena.
+	dll_obj->~IPEFDylibObject();
+	thread.DeleteLocal(dll_obj, sizeof(IPEFDylibObject));
 
 	dll_obj = nullptr;
 
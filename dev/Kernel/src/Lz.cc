@@ -0,0 +1,194 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#include <NewKit/Lz.h>
+
+// @file Lz.cc
+// @brief LZ77 codec, used to compress swapped pages.
+
+namespace OpenNE
+{
+	namespace Detail
+	{
+		STATIC UInt32 lz_read32(const UInt8* ptr)
+		{
+			return (UInt32)ptr[0] | ((UInt32)ptr[1] << 8) | ((UInt32)ptr[2] << 16) | ((UInt32)ptr[3] << 24);
+		}
+
+		STATIC UInt32 lz_hash(UInt32 seq)
+		{
+			return (seq * 2654435761U) >> (32 - kLzHashBits);
+		}
+
+		/// @brief Write the extra bytes of a length which didn't fit its nibble.
+		STATIC Bool lz_put_length(UInt8* dst, SizeT dst_len, SizeT& out, SizeT len)
+		{
+			while (len >= 255)
+			{
+				if (out == dst_len)
+					return No;
+
+				dst[out++] = 255;
+				len -= 255;
+			}
+
+			if (out == dst_len)
+				return No;
+
+			dst[out++] = (UInt8)len;
+
+			return Yes;
+		}
+
+		/// @brief Read the extra bytes of a length whose nibble is 15.
+		STATIC Bool lz_get_length(const UInt8* src, SizeT src_len, SizeT& in, SizeT& len)
+		{
+			UInt8 byte = 255;
+
+			while (byte == 255)
+			{
+				if (in == src_len)
+					return No;
+
+				byte = src[in++];
+				len += byte;
+			}
+
+			return Yes;
+		}
+
+		/// @brief Emit a sequence, match_len is zero for the last one which only has literals.
+		STATIC Bool lz_put_sequence(UInt8* dst, SizeT dst_len, SizeT& out, const UInt8* literals, SizeT literal_len, SizeT offset, SizeT match_len)
+		{
+			if (out == dst_len)
+				return No;
+
+			SizeT token	   = out++;
+			SizeT match_ex = match_len ? match_len - kLzMinMatch : 0;
+
+			dst[token] = (UInt8)(((literal_len < 15 ? literal_len : 15) << 4) | (match_ex < 15 ? match_ex : 15));
+
+			if (literal_len >= 15 && !lz_put_length(dst, dst_len, out, literal_len - 15))
+				return No;
+
+			if (dst_len - out < literal_len)
+				return No;
+
+			for (SizeT index = 0; index < literal_len; ++index)
+				dst[out++] = literals[index];
+
+			if (!match_len)
+				return Yes;
+
+			if (dst_len - out < 2)
+				return No;
+
+			dst[out++] = (UInt8)(offset & 0xFF);
+			dst[out++] = (UInt8)(offset >> 8);
+
+			if (match_ex >= 15 && !lz_put_length(dst, dst_len, out, match_ex - 15))
+				return No;
+
+			return Yes;
+		}
+	} // namespace Detail
+
+	SizeT ke_lz_compress(const UInt8* src, SizeT src_len, UInt8* dst, SizeT dst_len) noexcept
+	{
+		if (!src || !dst || !dst_len || src_len > kLzMaxInput)
+			return 0;
+
+		UInt16 table[1 << kLzHashBits] = {0};
+
+		SizeT out	 = 0;
+		SizeT anchor = 0;
+		SizeT pos	 = 0;
+
+		while (pos + kLzMinMatch <= src_len)
+		{
+			UInt32 seq	 = Detail::lz_read32(src + pos);
+			UInt32 hash	 = Detail::lz_hash(seq);
+			SizeT  match = table[hash];
+
+			table[hash] = (UInt16)pos;
+
+			if (match >= pos || Detail::lz_read32(src + match) != seq)
+			{
+				++pos;
+				continue;
+			}
+
+			SizeT len = kLzMinMatch;
+
+			while (pos + len < src_len && src[match + len] == src[pos + len])
+				++len;
+
+			if (!Detail::lz_put_sequence(dst, dst_len, out, src + anchor, pos - anchor, pos - match, len))
+				return 0;
+
+			pos += len;
+			anchor = pos;
+		}
+
+		if (!Detail::lz_put_sequence(dst, dst_len, out, src + anchor, src_len - anchor, 0, 0))
+			return 0;
+
+		return out;
+	}
+
+	SizeT ke_lz_decompress(const UInt8* src, SizeT src_len, UInt8* dst, SizeT dst_len) noexcept
+	{
+		if (!src || !dst)
+			return 0;
+
+		SizeT in  = 0;
+		SizeT out = 0;
+
+		while (in < src_len)
+		{
+			UInt8 token		  = src[in++];
+			SizeT literal_len = token >> 4;
+
+			if (literal_len == 15 && !Detail::lz_get_length(src, src_len, in, literal_len))
+				return 0;
+
+			if (src_len - in < literal_len || dst_len - out < literal_len)
+				return 0;
+
+			for (SizeT index = 0; index < literal_len; ++index)
+				dst[out++] = src[in++];
+
+			// the last sequence has no match.
+			if (in == src_len)
+				break;
+
+			if (src_len - in < 2)
+				return 0;
+
+			SizeT offset = (SizeT)src[in] | ((SizeT)src[in + 1] << 8);
+			in += 2;
+
+			if (!offset || offset > out)
+				return 0;
+
+			SizeT match_len = token & 0xF;
+
+			if (match_len == 15 && !Detail::lz_get_length(src, src_len, in, match_len))
+				return 0;
+
+			match_len += kLzMinMatch;
+
+			if (dst_len - out < match_len)
+				return 0;
+
+			// byte per byte, a match may overlap what it produces.
+			for (SizeT index = 0; index < match_len; ++index, ++out)
+				dst[out] = dst[out - offset];
+		}
+
+		return out;
+	}
+} // namespace OpenNE
@@ -7,6 +7,8 @@
 #include <KernelKit/DebugOutput.h>
 #include <KernelKit/LPC.h>
 #include <KernelKit/MemoryMgr.h>
+#include <KernelKit/RegionMgr.h>
+#include <KernelKit/SlabMgr.h>
 #include <NewKit/Crc32.h>
 #include <NewKit/PageMgr.h>
 #include <NewKit/Utils.h>
@@ -25,6 +27,20 @@
 
 #define kKernelHeapMagic (0xD4D7D5)
 
+/// @brief Canary seed, mixed with the header address so a copied header doesn't validate.
+#define kKernelHeapCanary (0xC0DEFACE5EA1ED00ULL)
+
+/// @brief With __OPENNE_HEAP_BODY_SCAN__, one validation in kKernelHeapScanRate also checks the body CRC.
+#ifndef kKernelHeapScanRate
+#define kKernelHeapScanRate (64U)
+#endif
+
+/// @brief Descriptor flags of the heaps kept out of line, see mm_new_heap.
+#define kKernelHeapFrameWr		  (1U << 0)
+#define kKernelHeapFrameUser	  (1U << 1)
+#define kKernelHeapFramePage	  (1U << 2)
+#define kKernelHeapFrameProtected (1U << 3)
+
 #ifdef __GNUC__
 #define kKernelHeapAlignSz (__BIGGEST_ALIGNMENT__)
 #else
@@ -58,7 +74,10 @@ namespace OpenNE
 			/// @brief Is this a page pointer?
 			Boolean fPagePtr : 1;
 
-			/// @brief 32-bit CRC checksum.
+			/// @brief Was the heap protected with mm_protect_heap?
+			Boolean fProtected : 1;
+
+			/// @brief 32-bit CRC checksum of the body (__OPENNE_HEAP_BODY_SCAN__ only).
 			UInt32 fCRC32;
 
 			/// @brief 64-bit Allocation flags.
@@ -70,8 +89,20 @@ namespace OpenNE
 			/// @brief 64-bit target offset pointer.
 			UIntPtr fHeapPtr;
 
+			/// @brief 32-bit checksum of the header fields.
+			UInt32 fHeaderSum;
+
 			/// @brief Padding bytes for header.
 			UInt8 fPadding[kKernelHeapAlignSz];
+
+			/// @brief Head canary, right before the heap's bytes.
+			UInt64 fHeadCanary;
+		};
+
+		/// @brief Tail canary, right after the heap's bytes.
+		struct PACKED HEAP_TAIL_CANARY final
+		{
+			UInt64 fCanary;
 		};
 
 		/// @brief Check for heap address validity.
@@ -95,56 +126,278 @@ namespace OpenNE
 		}
 
 		typedef HEAP_INFORMATION_BLOCK* HEAP_INFORMATION_BLOCK_PTR;
+
+		STATIC UInt64 mm_heap_mix(UInt64 sum, UInt64 word)
+		{
+			sum ^= word;
+			sum *= 0x100000001B3ULL;
+
+			return (sum << 13) | (sum >> 51);
+		}
+
+		/// @brief Checksum of the header fields, in constant time.
+		STATIC UInt32 mm_heap_header_sum(HEAP_INFORMATION_BLOCK_PTR heap_info_ptr)
+		{
+			UInt64 bits = heap_info_ptr->fPresent | (heap_info_ptr->fWriteRead << 1) | (heap_info_ptr->fUser << 2) |
+						  (heap_info_ptr->fPagePtr << 3) | (heap_info_ptr->fProtected << 4);
+
+			UInt64 sum = kKernelHeapCanary ^ reinterpret_cast<UIntPtr>(heap_info_ptr);
+
+			sum = mm_heap_mix(sum, heap_info_ptr->fMagic);
+			sum = mm_heap_mix(sum, bits);
+			sum = mm_heap_mix(sum, heap_info_ptr->fCRC32);
+			sum = mm_heap_mix(sum, heap_info_ptr->fFlags);
+			sum = mm_heap_mix(sum, heap_info_ptr->fHeapSize);
+			sum = mm_heap_mix(sum, heap_info_ptr->fHeapPtr);
+
+			return static_cast<UInt32>(sum ^ (sum >> 32));
+		}
+
+		STATIC UInt64 mm_heap_canary(HEAP_INFORMATION_BLOCK_PTR heap_info_ptr)
+		{
+			return kKernelHeapCanary ^ reinterpret_cast<UIntPtr>(heap_info_ptr);
+		}
+
+		STATIC HEAP_TAIL_CANARY* mm_heap_tail(HEAP_INFORMATION_BLOCK_PTR heap_info_ptr)
+		{
+			return reinterpret_cast<HEAP_TAIL_CANARY*>(heap_info_ptr->fHeapPtr + heap_info_ptr->fHeapSize -
+													   sizeof(HEAP_INFORMATION_BLOCK));
+		}
+
+		/// @brief Writes the canaries and the header checksum, to be called after any header change.
+		STATIC Void mm_seal_heap(HEAP_INFORMATION_BLOCK_PTR heap_info_ptr)
+		{
+			heap_info_ptr->fHeadCanary			  = mm_heap_canary(heap_info_ptr);
+			mm_heap_tail(heap_info_ptr)->fCanary = mm_heap_canary(heap_info_ptr);
+			heap_info_ptr->fHeaderSum			  = mm_heap_header_sum(heap_info_ptr);
+		}
+
+		/// @brief Checks the header checksum and both canaries.
+		/// @return if the heap wasn't corrupted or overrun.
+		STATIC Bool mm_check_heap(HEAP_INFORMATION_BLOCK_PTR heap_info_ptr)
+		{
+			if (heap_info_ptr->fMagic != kKernelHeapMagic ||
+				heap_info_ptr->fHeaderSum != mm_heap_header_sum(heap_info_ptr))
+				return No;
+
+			return heap_info_ptr->fHeadCanary == mm_heap_canary(heap_info_ptr) &&
+				   mm_heap_tail(heap_info_ptr)->fCanary == mm_heap_canary(heap_info_ptr);
+		}
+
+#ifdef __OPENNE_HEAP_BODY_SCAN__
+		STATIC UInt32 mm_heap_body_crc(HEAP_INFORMATION_BLOCK_PTR heap_info_ptr)
+		{
+			return ke_calculate_crc32(reinterpret_cast<Char*>(heap_info_ptr->fHeapPtr),
+									  heap_info_ptr->fHeapSize - sizeof(HEAP_INFORMATION_BLOCK));
+		}
+
+		/// @brief Tells if this validation should also scan the body.
+		STATIC Bool mm_heap_should_scan()
+		{
+			STATIC UInt32 scan_counter = 0U;
+			return (++scan_counter % kKernelHeapScanRate) == 0;
+		}
+#endif // __OPENNE_HEAP_BODY_SCAN__
+
+		/// @brief Descriptor of a heap kept out of line, whose pointer is the block itself.
+		/// @return nullptr if heap_ptr isn't such a heap.
+		STATIC HAL::PAGE_FRAME* mm_heap_frame(VoidPtr heap_ptr)
+		{
+			if (!heap_ptr || (reinterpret_cast<UIntPtr>(heap_ptr) & (kPageSize - 1)))
+				return nullptr;
+
+			HAL::PAGE_FRAME* frame = HAL::mm_frame_of(heap_ptr);
+
+			if (!frame || frame->fOwner != HAL::kPageOwnerHeap)
+				return nullptr;
+
+			return frame;
+		}
 	} // namespace Detail
 
 	/// @brief Declare a new size for ptr_heap.
 	/// @param ptr_heap the pointer.
-	/// @return Newly allocated heap header.
+	/// @param new_sz the new size of the pointer.
+	/// @note Resizes in place when the slab class or the adjacent pages allow it, moves otherwise.
+	/// @return The resized pointer, nullptr on failure (ptr_heap is left untouched).
 	_Output VoidPtr mm_realloc_heap(VoidPtr ptr_heap, SizeT new_sz)
 	{
-		if (Detail::mm_check_heap_address(ptr_heap) == No)
+		if (!mm_region_owns(ptr_heap) && Detail::mm_check_heap_address(ptr_heap) == No)
 			return nullptr;
 
 		if (!ptr_heap || new_sz < 1)
 			return nullptr;
 
-		kout << "This function is not implemented by minOSKrnl, please use the BSD's realloc instead.\r";
-		ke_panic(RUNTIME_CHECK_PROCESS);
+		SizeT	old_sz		   = 0UL;
+		Boolean wr			   = Yes;
+		Boolean user		   = No;
+		UInt64	flags		   = 0UL;
+		Boolean protected_heap = No;
+
+		if (mm_slab_owns(ptr_heap))
+		{
+			if (!mm_slab_is_allocated(ptr_heap))
+				return nullptr;
+
+			old_sz = mm_slab_object_size(ptr_heap);
+
+			// still fits the object's class.
+			if (new_sz <= old_sz)
+				return ptr_heap;
+		}
+		else if (mm_region_owns(ptr_heap))
+		{
+			old_sz = mm_region_size(ptr_heap);
+
+			if (old_sz == 0)
+				return nullptr;
+
+			// still fits the region's granules.
+			if (new_sz <= old_sz)
+				return ptr_heap;
+		}
+		else if (HAL::PAGE_FRAME* frame = Detail::mm_heap_frame(ptr_heap); frame)
+		{
+			old_sz		   = HAL::mm_size_of_bitmap(ptr_heap);
+			wr			   = frame->fFlags & kKernelHeapFrameWr;
+			user		   = frame->fFlags & kKernelHeapFrameUser;
+			flags		   = frame->fPrivate;
+			protected_heap = frame->fFlags & kKernelHeapFrameProtected;
+
+			// the descriptor stays on the first frame, which doesn't move.
+			if (new_sz <= old_sz || HAL::mm_resize_bitmap(ptr_heap, new_sz, wr, user))
+				return ptr_heap;
+		}
+		else
+		{
+			Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
+				reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
+					(UIntPtr)ptr_heap - sizeof(Detail::HEAP_INFORMATION_BLOCK));
+
+			if (!heap_info_ptr->fPresent ||
+				!Detail::mm_check_heap(heap_info_ptr))
+				return nullptr;
+
+			old_sz		   = heap_info_ptr->fHeapSize - sizeof(Detail::HEAP_INFORMATION_BLOCK);
+			wr			   = heap_info_ptr->fWriteRead;
+			user		   = heap_info_ptr->fUser;
+			flags		   = heap_info_ptr->fFlags;
+			protected_heap = heap_info_ptr->fProtected;
+
+			// the region starts one header before the HIB, see mm_new_heap.
+			VoidPtr region = reinterpret_cast<VoidPtr>((UIntPtr)heap_info_ptr - sizeof(Detail::HEAP_INFORMATION_BLOCK));
+
+			if (HAL::mm_resize_bitmap(region, new_sz + sizeof(Detail::HEAP_INFORMATION_BLOCK) * 2 + sizeof(Detail::HEAP_TAIL_CANARY), wr, user))
+			{
+				heap_info_ptr->fHeapSize = new_sz + sizeof(Detail::HEAP_INFORMATION_BLOCK);
+
+				if (protected_heap)
+					mm_protect_heap(ptr_heap);
+				else
+					Detail::mm_seal_heap(heap_info_ptr);
+
+				return ptr_heap;
+			}
+		}
+
+		VoidPtr new_heap = mm_new_heap(new_sz, wr, user);
+
+		if (!new_heap)
+			return nullptr;
+
+		// rt_copy_memory terminates the destination, which would overrun it by one byte.
+		Char* src_bytes = reinterpret_cast<Char*>(ptr_heap);
+		Char* dst_bytes = reinterpret_cast<Char*>(new_heap);
+
+		const SizeT copy_sz = old_sz < new_sz ? old_sz : new_sz;
 
-		return nullptr;
+		for (SizeT index = 0UL; index < copy_sz; ++index)
+			dst_bytes[index] = src_bytes[index];
+
+		if (!mm_slab_owns(new_heap) && !mm_region_owns(new_heap))
+		{
+			mm_make_flags(new_heap, flags);
+
+			if (protected_heap)
+				mm_protect_heap(new_heap);
+		}
+
+		mm_delete_heap(ptr_heap);
+
+		return new_heap;
 	}
 
 	/// @brief Allocate chunk of memory.
 	/// @param sz Size of pointer
 	/// @param wr Read Write bit.
 	/// @param user User enable bit.
+	/// @param dma the chunk must be physically contiguous.
 	/// @return The newly allocated pointer.
-	_Output VoidPtr mm_new_heap(const SizeT sz, const bool wr, const bool user)
+	_Output VoidPtr mm_new_heap(const SizeT sz, const bool wr, const bool user, const Bool dma)
 	{
 		auto sz_fix = sz;
 
 		if (sz_fix == 0)
 			return nullptr;
 
+		// Small kernel objects are carved out of a slab span, instead of taking a region each.
+		if (wr && !user && sz_fix <= kSlabMaxObjectSize)
+		{
+			if (auto slab_ptr = mm_slab_alloc(sz_fix); slab_ptr)
+				return slab_ptr;
+		}
+
+		// Large kernel chunks are mapped page by page, instead of taking a contiguous run of the bitmap.
+		// A device sees physical memory, so DMA buffers still take the contiguous run.
+		if (!user && !dma && sz_fix >= kRegionMinSz)
+		{
+			if (auto region_ptr = mm_new_region(sz_fix, wr); region_ptr)
+				return region_ptr;
+		}
+
+		// Page multiples take whole pages with no header, it goes to the first frame's descriptor.
+		// The buddy rounds the page count up to a power of two, so only those fit exactly.
+		if (sz_fix % kPageSize == 0)
+		{
+			PageMgr heap_mgr;
+			auto	wrapper = heap_mgr.Request(wr, user, No, sz_fix);
+
+			HAL::PAGE_FRAME* frame = HAL::mm_frame_of(reinterpret_cast<VoidPtr>(wrapper.VirtualAddress()));
+
+			if (!frame)
+				return nullptr;
+
+			frame->fOwner	= HAL::kPageOwnerHeap;
+			frame->fFlags	= (wr ? kKernelHeapFrameWr : 0U) | (user ? kKernelHeapFrameUser : 0U);
+			frame->fPrivate = 0UL;
+
+			return reinterpret_cast<VoidPtr>(wrapper.VirtualAddress());
+		}
+
 		sz_fix += sizeof(Detail::HEAP_INFORMATION_BLOCK);
 
+		// the HIB sits one header into the region, account for that gap and the tail canary too.
 		PageMgr heap_mgr;
-		auto	wrapper = heap_mgr.Request(wr, user, No, sz_fix);
+		auto	wrapper = heap_mgr.Request(wr, user, No, sz_fix + sizeof(Detail::HEAP_INFORMATION_BLOCK) + sizeof(Detail::HEAP_TAIL_CANARY));
 
 		Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 			reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 				wrapper.VirtualAddress() + sizeof(Detail::HEAP_INFORMATION_BLOCK));
 
-		heap_info_ptr->fHeapSize  = sz_fix;
-		heap_info_ptr->fMagic	  = kKernelHeapMagic;
-		heap_info_ptr->fCRC32	  = 0; // dont fill it for now.
-		heap_info_ptr->fHeapPtr	  = reinterpret_cast<UIntPtr>(heap_info_ptr) + sizeof(Detail::HEAP_INFORMATION_BLOCK);
-		heap_info_ptr->fPagePtr	  = No;
-		heap_info_ptr->fWriteRead = wr;
-		heap_info_ptr->fUser	  = user;
-		heap_info_ptr->fPresent	  = Yes;
+		heap_info_ptr->fHeapSize   = sz_fix;
+		heap_info_ptr->fMagic	   = kKernelHeapMagic;
+		heap_info_ptr->fCRC32	   = 0; // dont fill it for now.
+		heap_info_ptr->fFlags	   = 0;
+		heap_info_ptr->fHeapPtr	   = reinterpret_cast<UIntPtr>(heap_info_ptr) + sizeof(Detail::HEAP_INFORMATION_BLOCK);
+		heap_info_ptr->fPagePtr	   = No;
+		heap_info_ptr->fProtected  = No;
+		heap_info_ptr->fWriteRead  = wr;
+		heap_info_ptr->fUser	   = user;
+		heap_info_ptr->fPresent	   = Yes;
 
-		rt_set_memory(heap_info_ptr->fPadding, 0, kKernelHeapAlignSz);
+		rt_set_memory(heap_info_ptr->fPadding, 0, kKernelHeapAlignSz / sizeof(UInt32));
+
+		Detail::mm_seal_heap(heap_info_ptr);
 
 		auto result = reinterpret_cast<VoidPtr>(heap_info_ptr->fHeapPtr);
 
@@ -158,18 +411,27 @@ namespace OpenNE
 	/// @return kErrorSuccess if successful, otherwise an error code.
 	_Output Int32 mm_make_page(VoidPtr heap_ptr)
 	{
-		if (Detail::mm_check_heap_address(heap_ptr) == No)
+		if (Detail::mm_check_heap_address(heap_ptr) == No ||
+			mm_slab_owns(heap_ptr) || mm_region_owns(heap_ptr))
 			return kErrorHeapNotPresent;
 
 		Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 			reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 				(UIntPtr)heap_ptr - sizeof(Detail::HEAP_INFORMATION_BLOCK));
 
-		if (!heap_info_ptr)
+		if (HAL::PAGE_FRAME* frame = Detail::mm_heap_frame(heap_ptr); frame)
+		{
+			frame->fFlags |= kKernelHeapFramePage;
+			return kErrorSuccess;
+		}
+
+		if (!heap_info_ptr || !Detail::mm_check_heap(heap_info_ptr))
 			return kErrorHeapNotPresent;
 
 		heap_info_ptr->fPagePtr = true;
 
+		Detail::mm_seal_heap(heap_info_ptr);
+
 		kout << "Created page address: " << hex_number(reinterpret_cast<UIntPtr>(heap_info_ptr)) << endl;
 
 		return kErrorSuccess;
@@ -180,18 +442,27 @@ namespace OpenNE
 	/// @param flags the flags to set.
 	_Output Int32 mm_make_flags(VoidPtr heap_ptr, UInt64 flags)
 	{
-		if (Detail::mm_check_heap_address(heap_ptr) == No)
+		if (Detail::mm_check_heap_address(heap_ptr) == No ||
+			mm_slab_owns(heap_ptr) || mm_region_owns(heap_ptr))
 			return kErrorHeapNotPresent;
 
 		Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 			reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 				(UIntPtr)heap_ptr - sizeof(Detail::HEAP_INFORMATION_BLOCK));
 
-		if (!heap_info_ptr)
+		if (HAL::PAGE_FRAME* frame = Detail::mm_heap_frame(heap_ptr); frame)
+		{
+			frame->fPrivate = flags;
+			return kErrorSuccess;
+		}
+
+		if (!heap_info_ptr || !Detail::mm_check_heap(heap_info_ptr))
 			return kErrorHeapNotPresent;
 
 		heap_info_ptr->fFlags = flags;
 
+		Detail::mm_seal_heap(heap_info_ptr);
+
 		return kErrorSuccess;
 	}
 
@@ -199,6 +470,12 @@ namespace OpenNE
 	/// @param heap_ptr the pointer to get.
 	_Output UInt64 mm_get_flags(VoidPtr heap_ptr)
 	{
+		if (mm_slab_owns(heap_ptr) || mm_region_owns(heap_ptr))
+			return kErrorHeapNotPresent;
+
+		if (HAL::PAGE_FRAME* frame = Detail::mm_heap_frame(heap_ptr); frame)
+			return frame->fPrivate;
+
 		Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 			reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 				(UIntPtr)heap_ptr - sizeof(Detail::HEAP_INFORMATION_BLOCK));
@@ -214,9 +491,31 @@ namespace OpenNE
 	/// @return
 	_Output Int32 mm_delete_heap(VoidPtr heap_ptr)
 	{
+		if (mm_region_owns(heap_ptr))
+			return mm_delete_region(heap_ptr);
+
 		if (Detail::mm_check_heap_address(heap_ptr) == No)
 			return kErrorHeapNotPresent;
 
+		if (mm_slab_owns(heap_ptr))
+			return mm_slab_free(heap_ptr) ? kErrorSuccess : kErrorHeapNotPresent;
+
+		if (HAL::PAGE_FRAME* frame = Detail::mm_heap_frame(heap_ptr); frame)
+		{
+			// the pages may be cached, give them back to their plain owner first.
+			frame->fOwner	= (frame->fFlags & kKernelHeapFrameUser) ? HAL::kPageOwnerUser : HAL::kPageOwnerKernel;
+			frame->fFlags	= 0U;
+			frame->fPrivate = 0UL;
+
+			PTEWrapper		page_wrapper(No, No, No, reinterpret_cast<UIntPtr>(heap_ptr));
+			Ref<PTEWrapper> pte_ref{page_wrapper};
+
+			PageMgr heap_mgr;
+			heap_mgr.Free(pte_ref);
+
+			return kErrorSuccess;
+		}
+
 		Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 			reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 				(UIntPtr)(heap_ptr) - sizeof(Detail::HEAP_INFORMATION_BLOCK));
@@ -228,13 +527,23 @@ namespace OpenNE
 				return kErrorHeapNotPresent;
 			}
 
-			heap_info_ptr->fHeapSize  = 0UL;
-			heap_info_ptr->fPresent	  = No;
-			heap_info_ptr->fHeapPtr	  = 0;
-			heap_info_ptr->fCRC32	  = 0;
-			heap_info_ptr->fWriteRead = No;
-			heap_info_ptr->fUser	  = No;
-			heap_info_ptr->fMagic	  = 0;
+			// don't hand a corrupted region back to the pager, leak it instead.
+			if (!Detail::mm_check_heap(heap_info_ptr))
+			{
+				kout << "MemoryMgr: heap corruption detected at: " << hex_number(reinterpret_cast<UIntPtr>(heap_info_ptr)) << endl;
+				return kErrorInvalidData;
+			}
+
+			heap_info_ptr->fHeapSize   = 0UL;
+			heap_info_ptr->fPresent	   = No;
+			heap_info_ptr->fHeapPtr	   = 0;
+			heap_info_ptr->fCRC32	   = 0;
+			heap_info_ptr->fHeaderSum  = 0;
+			heap_info_ptr->fHeadCanary = 0;
+			heap_info_ptr->fProtected  = No;
+			heap_info_ptr->fWriteRead  = No;
+			heap_info_ptr->fUser	   = No;
+			heap_info_ptr->fMagic	   = 0;
 
 			PTEWrapper		pageWrapper(No, No, No, reinterpret_cast<UIntPtr>(heap_info_ptr) - sizeof(Detail::HEAP_INFORMATION_BLOCK));
 			Ref<PTEWrapper> pteAddress{pageWrapper};
@@ -255,20 +564,30 @@ namespace OpenNE
 	/// @return if it exists.
 	_Output Boolean mm_is_valid_heap(VoidPtr heap_ptr)
 	{
+		if (mm_slab_owns(heap_ptr))
+			return mm_slab_is_allocated(heap_ptr);
+
+		if (mm_region_owns(heap_ptr))
+			return mm_is_region(heap_ptr);
+
+		if (Detail::mm_heap_frame(heap_ptr))
+			return Yes;
+
 		if (heap_ptr && HAL::mm_is_bitmap(heap_ptr))
 		{
 			Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 				reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 					(UIntPtr)(heap_ptr) - sizeof(Detail::HEAP_INFORMATION_BLOCK));
 
-			if (heap_info_ptr && heap_info_ptr->fPresent && heap_info_ptr->fMagic == kKernelHeapMagic)
+			if (heap_info_ptr && heap_info_ptr->fPresent && Detail::mm_check_heap(heap_info_ptr))
 			{
-				if (heap_info_ptr->fCRC32 !=
-					ke_calculate_crc32((Char*)heap_info_ptr->fHeapPtr,
-									   heap_info_ptr->fHeapSize))
+#ifdef __OPENNE_HEAP_BODY_SCAN__
+				if (heap_info_ptr->fProtected && Detail::mm_heap_should_scan() &&
+					heap_info_ptr->fCRC32 != Detail::mm_heap_body_crc(heap_info_ptr))
 				{
 					return No;
 				}
+#endif // __OPENNE_HEAP_BODY_SCAN__
 
 				return Yes;
 			}
@@ -282,16 +601,28 @@ namespace OpenNE
 	/// @return if it valid: point has crc now., otherwise fail.
 	_Output Boolean mm_protect_heap(VoidPtr heap_ptr)
 	{
-		if (heap_ptr)
+		// the body of a heap kept out of line isn't checksummed.
+		if (HAL::PAGE_FRAME* frame = Detail::mm_heap_frame(heap_ptr); frame)
+		{
+			frame->fFlags |= kKernelHeapFrameProtected;
+			return Yes;
+		}
+
+		if (heap_ptr && !mm_slab_owns(heap_ptr) && !mm_region_owns(heap_ptr))
 		{
 			Detail::HEAP_INFORMATION_BLOCK_PTR heap_info_ptr =
 				reinterpret_cast<Detail::HEAP_INFORMATION_BLOCK_PTR>(
 					(UIntPtr)heap_ptr - sizeof(Detail::HEAP_INFORMATION_BLOCK));
 
-			if (heap_info_ptr && heap_info_ptr->fPresent && kKernelHeapMagic == heap_info_ptr->fMagic)
+			if (heap_info_ptr && heap_info_ptr->fPresent && Detail::mm_check_heap(heap_info_ptr))
 			{
-				heap_info_ptr->fCRC32 =
-					ke_calculate_crc32((Char*)heap_info_ptr->fHeapPtr, heap_info_ptr->fHeapSize);
+				heap_info_ptr->fProtected = Yes;
+
+#ifdef __OPENNE_HEAP_BODY_SCAN__
+				heap_info_ptr->fCRC32 = Detail::mm_heap_body_crc(heap_info_ptr);
+#endif // __OPENNE_HEAP_BODY_SCAN__
+
+				Detail::mm_seal_heap(heap_info_ptr);
 
 				return Yes;
 			}
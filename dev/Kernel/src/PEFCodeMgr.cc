@@ -258,8 +258,13 @@ namespace OpenNE
 			if (id != kProcessInvalidID)
 			{
 				UserProcessScheduler::The().CurrentTeam().AsArray()[id].Kind		= process_kind;
-				UserProcessScheduler::The().CurrentTeam().AsArray()[id].StackSize	= *(UIntPtr*)exec.FindSymbol(kPefStackSizeSymbol, kPefData);
 				UserProcessScheduler::The().CurrentTeam().AsArray()[id].MemoryLimit = *(UIntPtr*)exec.FindSymbol(kPefHeapSizeSymbol, kPefData);
+
+				SizeT stack_sz = *(UIntPtr*)exec.FindSymbol(kPefStackSizeSymbol, kPefData);
+
+				// the stack was reserved by Spawn, its top can only move down inside it.
+				if (stack_sz > 0 && stack_sz < UserProcessScheduler::The().CurrentTeam().AsArray()[id].StackSize)
+					UserProcessScheduler::The().CurrentTeam().AsArray()[id].StackSize = stack_sz;
 			}
 
 			return id;
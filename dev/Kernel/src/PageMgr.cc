@@ -5,6 +5,7 @@
 ------------------------------------------- */
 
 #include <KernelKit/DebugOutput.h>
+#include <KernelKit/HardwareThreadScheduler.h>
 #include <NewKit/PageMgr.h>
 
 #ifdef __OPENNE_AMD64__
@@ -15,6 +16,156 @@
 
 namespace OpenNE
 {
+	namespace Detail
+	{
+		/// @brief Free single pages owned by one hardware thread.
+		/// The pages stay allocated in the bitmap while they sit here.
+		struct PAGE_CACHE final
+		{
+			UIntPtr fPages[kPageCacheHighMark];
+			SizeT	fCount;
+			UInt64	fHits;
+			UInt64	fMisses;
+		};
+
+		STATIC PAGE_CACHE kPageCache[kMaxAPInsideSched];
+
+		/// @brief Cache of the core we're running on, only that core touches it.
+		/// @return nullptr if the core has no slot, its pages then go to the bitmap directly.
+		STATIC PAGE_CACHE* mm_page_cache()
+		{
+			ThreadID core = HardwareThreadScheduler::The().CurrentID();
+
+			if (core >= kMaxAPInsideSched)
+				return nullptr;
+
+			return &kPageCache[core];
+		}
+
+		/// @brief Take a batch of pages from the bitmap, the mapping is done again when a page is handed out.
+		STATIC Void mm_refill_page_cache(PAGE_CACHE& cache)
+		{
+			while (cache.fCount < kPageCacheBatch)
+			{
+				VoidPtr page = HAL::mm_alloc_bitmap(Yes, No, kPageSize, Yes);
+
+				if (!page)
+					break;
+
+				cache.fPages[cache.fCount++] = reinterpret_cast<UIntPtr>(page);
+			}
+		}
+
+		/// @brief Zeroed pages, and the freed pages idle cores zero to refill them.
+		/// The pages stay allocated in the bitmap while they sit here.
+		struct PAGE_ZERO_POOL final
+		{
+			UIntPtr fZeroed[kPageZeroPoolDepth];
+			SizeT	fZeroedCount;
+			UIntPtr fDirty[kPageDirtyDepth];
+			SizeT	fDirtyCount;
+			Bool	fLock;
+			UInt64	fHits;
+			UInt64	fMisses;
+		};
+
+		STATIC PAGE_ZERO_POOL kPageZeroPool;
+
+		STATIC Void mm_lock_zero_pool()
+		{
+			while (__atomic_test_and_set(&kPageZeroPool.fLock, __ATOMIC_ACQUIRE))
+				;
+		}
+
+		STATIC Void mm_unlock_zero_pool()
+		{
+			__atomic_clear(&kPageZeroPool.fLock, __ATOMIC_RELEASE);
+		}
+
+		/// @brief Clear size bytes of a block, through a kernel pointer whatever it is mapped as.
+		STATIC Void mm_zero_page(UIntPtr page, SizeT size)
+		{
+#ifdef __OPENNE_AMD64__
+			UInt64* words = reinterpret_cast<UInt64*>(HAL::mm_phys_to_virt(page));
+#else
+			UInt64* words = reinterpret_cast<UInt64*>(page);
+#endif // ifdef __OPENNE_AMD64__
+
+			for (SizeT index = 0; index < (size + sizeof(UInt64) - 1) / sizeof(UInt64); ++index)
+				words[index] = 0UL;
+		}
+
+		/// @brief Hand a freed page over to be zeroed, or back to the bitmap if the reserve has enough.
+		STATIC Void mm_retire_page(UIntPtr page)
+		{
+			mm_lock_zero_pool();
+
+			if (kPageZeroPool.fDirtyCount < kPageDirtyDepth &&
+				kPageZeroPool.fZeroedCount + kPageZeroPool.fDirtyCount < kPageZeroPoolDepth)
+			{
+				kPageZeroPool.fDirty[kPageZeroPool.fDirtyCount++] = page;
+				mm_unlock_zero_pool();
+
+				return;
+			}
+
+			mm_unlock_zero_pool();
+
+			HAL::mm_free_bitmap(reinterpret_cast<VoidPtr>(page));
+		}
+
+		/// @brief Take a page from the zeroed reserve.
+		/// @return The page, zero if the reserve is empty.
+		STATIC UIntPtr mm_take_zeroed()
+		{
+			UIntPtr page = 0UL;
+
+			mm_lock_zero_pool();
+
+			if (kPageZeroPool.fZeroedCount > 0)
+			{
+				page = kPageZeroPool.fZeroed[--kPageZeroPool.fZeroedCount];
+				++kPageZeroPool.fHits;
+			}
+			else
+			{
+				++kPageZeroPool.fMisses;
+			}
+
+			mm_unlock_zero_pool();
+
+			return page;
+		}
+
+		/// @brief Give pages back, oldest first, until the low mark is reached.
+		/// They go to the zeroing first, so that a core with nothing to do prepares them.
+		STATIC Void mm_drain_page_cache(PAGE_CACHE& cache)
+		{
+			SizeT drained = cache.fCount - kPageCacheLowMark;
+
+			for (SizeT index = 0; index < drained; ++index)
+				mm_retire_page(cache.fPages[index]);
+
+			for (SizeT index = 0; index < kPageCacheLowMark; ++index)
+				cache.fPages[index] = cache.fPages[index + drained];
+
+			cache.fCount = kPageCacheLowMark;
+		}
+
+		/// @brief Size of the page which maps ptr, as made by the pager.
+		STATIC SizeT mm_page_size_of(VoidPtr ptr)
+		{
+#ifdef __OPENNE_AMD64__
+			SizeT page_size = HAL::mm_get_page_size(ptr);
+
+			if (page_size)
+				return page_size;
+#endif // ifdef __OPENNE_AMD64__
+
+			return kPageSize;
+		}
+	} // namespace Detail
+
 	PTEWrapper::PTEWrapper(Boolean Rw, Boolean User, Boolean ExecDisable, UIntPtr VirtAddr)
 		: fRw(Rw),
 		  fUser(User),
@@ -24,18 +175,25 @@ namespace OpenNE
 		  fShareable(false),
 		  fWt(false),
 		  fPresent(true),
-		  fAccessed(false)
+		  fAccessed(false),
+		  fPageSize(kPageSize)
 	{
 	}
 
 	PTEWrapper::~PTEWrapper() = default;
 
-	/// @brief Flush virtual address.
-	/// @param VirtAddr
+	/// @brief Flush the TLB, on this core and on the cores sharing the address space.
 	Void PageMgr::FlushTLB()
 	{
 #ifndef __OPENNE_MINIMAL_OS__
 		hal_flush_tlb();
+
+#ifdef __OPENNE_AMD64__
+		HAL::TLB_SHOOTDOWN_RANGES ranges;
+		ranges.fFlushAll = Yes;
+
+		HAL::mp_tlb_shootdown(hal_read_cr3(), ranges);
+#endif // ifdef __OPENNE_AMD64__
 #endif // !__OPENNE_MINIMAL_OS__
 	}
 
@@ -56,13 +214,97 @@ namespace OpenNE
 	/// @param Rw r/w?
 	/// @param User user mode?
 	/// @param ExecDisable disable execution on page?
+	/// @param Zeroed clear the memory, single pages come from the zeroed reserve when it has some.
 	/// @return
-	PTEWrapper PageMgr::Request(Boolean Rw, Boolean User, Boolean ExecDisable, SizeT Sz)
+	PTEWrapper PageMgr::Request(Boolean Rw, Boolean User, Boolean ExecDisable, SizeT Sz, Boolean Zeroed)
 	{
+		if (Sz > 0 && Sz <= kPageSize)
+		{
+			UIntPtr page = Zeroed ? Detail::mm_take_zeroed() : 0UL;
+
+			Detail::PAGE_CACHE* cache = page ? nullptr : Detail::mm_page_cache();
+
+			if (cache)
+			{
+				if (cache->fCount > 0)
+				{
+					++cache->fHits;
+				}
+				else
+				{
+					++cache->fMisses;
+					Detail::mm_refill_page_cache(*cache);
+				}
+
+				if (cache->fCount > 0)
+				{
+					page = cache->fPages[--cache->fCount];
+
+					// nobody zeroed it ahead of time, do it here.
+					if (Zeroed)
+						Detail::mm_zero_page(page, kPageSize);
+				}
+			}
+
+			if (page)
+			{
+				VoidPtr ptr = reinterpret_cast<VoidPtr>(page);
+
+				// the page may come from another owner, so map it again with our own flags.
+				UInt32 flags = HAL::kMMFlagsPresent;
+
+				if (Rw)
+					flags |= HAL::kMMFlagsWr;
+
+				if (User)
+					flags |= HAL::kMMFlagsUser;
+
+#ifdef __OPENNE_AMD64__
+				HAL::mm_map_page(ptr, ptr, flags);
+#else
+				HAL::mm_map_page(ptr, flags);
+#endif // ifdef __OPENNE_AMD64__
+
+				// same for its descriptor, whoever filled the cache.
+				if (HAL::PAGE_FRAME* frame = HAL::mm_frame_of(ptr); frame)
+					frame->fOwner = User ? HAL::kPageOwnerUser : HAL::kPageOwnerKernel;
+
+				PTEWrapper wrapper{Rw, User, ExecDisable, reinterpret_cast<UIntPtr>(ptr)};
+				wrapper.fPageSize = Detail::mm_page_size_of(ptr);
+
+				return wrapper;
+			}
+		}
+
 		// Store PTE wrapper right after PTE.
 		VoidPtr ptr = OpenNE::HAL::mm_alloc_bitmap(Rw, User, Sz, false);
 
-		return PTEWrapper{Rw, User, ExecDisable, reinterpret_cast<UIntPtr>(ptr)};
+		if (ptr && Zeroed)
+			Detail::mm_zero_page(reinterpret_cast<UIntPtr>(ptr), Sz);
+
+		PTEWrapper wrapper{Rw, User, ExecDisable, reinterpret_cast<UIntPtr>(ptr)};
+
+		if (ptr)
+			wrapper.fPageSize = Detail::mm_page_size_of(ptr);
+
+		return wrapper;
+	}
+
+	/// @brief Request a zeroed page which isn't mapped, it is freed with mm_free_bitmap.
+	/// @return The page, from the zeroed reserve when it has some.
+	VoidPtr PageMgr::RequestZeroed()
+	{
+		UIntPtr page = Detail::mm_take_zeroed();
+
+		if (page)
+			return reinterpret_cast<VoidPtr>(page);
+
+		VoidPtr frame = HAL::mm_alloc_bitmap(Yes, Yes, kPageSize, Yes);
+
+		if (frame)
+			Detail::mm_zero_page(reinterpret_cast<UIntPtr>(frame), kPageSize);
+
+		return frame;
 	}
 
 	/// @brief Disable BitMap.
@@ -70,12 +312,153 @@ namespace OpenNE
 	/// @return If the page bitmap was cleared or not.
 	Bool PageMgr::Free(Ref<PTEWrapper>& wrapper)
 	{
-		if (!OpenNE::HAL::mm_free_bitmap((VoidPtr)wrapper.Leak().VirtualAddress()))
+		VoidPtr ptr = (VoidPtr)wrapper.Leak().VirtualAddress();
+
+		// single pages go back to the core's cache, SizeOfBitMap also rejects unallocated pages.
+		Detail::PAGE_CACHE* cache = nullptr;
+
+		if (ptr && HAL::mm_size_of_bitmap(ptr) == kPageSize && (cache = Detail::mm_page_cache()))
+		{
+			for (SizeT index = 0; index < cache->fCount; ++index)
+			{
+				if (cache->fPages[index] == reinterpret_cast<UIntPtr>(ptr))
+					return false;
+			}
+
+			if (cache->fCount == kPageCacheHighMark)
+				Detail::mm_drain_page_cache(*cache);
+
+			cache->fPages[cache->fCount++] = reinterpret_cast<UIntPtr>(ptr);
+
+			return true;
+		}
+
+		if (!OpenNE::HAL::mm_free_bitmap(ptr))
 			return false;
 
 		return true;
 	}
 
+	/// @brief Maps a whole range at once, invalidating the TLB once at the end.
+	/// @param VirtAddr start of the range.
+	/// @param PhysAddr start of the physical range.
+	/// @param Sz size of the range.
+	/// @param Type memory type of the range, kPageTypeWB by default.
+	/// @return If the range was mapped.
+	Bool PageMgr::MapRange(UIntPtr VirtAddr, UIntPtr PhysAddr, SizeT Sz, Boolean Rw, Boolean User, Boolean ExecDisable, UInt32 Type)
+	{
+#ifdef __OPENNE_AMD64__
+		UInt32 flags = HAL::kMMFlagsPresent;
+
+		if (Rw)
+			flags |= HAL::kMMFlagsWr;
+
+		if (User)
+			flags |= HAL::kMMFlagsUser;
+
+		if (ExecDisable)
+			flags |= HAL::kMMFlagsNX;
+
+		if (Type == kPageTypeWT)
+			flags |= HAL::kMMFlagsWT;
+		else if (Type == kPageTypeWC)
+			flags |= HAL::kMMFlagsWC;
+		else if (Type == kPageTypeUC)
+			flags |= HAL::kMMFlagsUC;
+
+		return HAL::mm_map_range(reinterpret_cast<VoidPtr>(VirtAddr), reinterpret_cast<VoidPtr>(PhysAddr), Sz, flags) == 0;
+#else
+		return false;
+#endif // ifdef __OPENNE_AMD64__
+	}
+
+	/// @brief Unmaps a whole range at once, invalidating the TLB once at the end.
+	/// @param VirtAddr start of the range.
+	/// @param Sz size of the range.
+	/// @return If the range was unmapped.
+	Bool PageMgr::UnmapRange(UIntPtr VirtAddr, SizeT Sz)
+	{
+#ifdef __OPENNE_AMD64__
+		return HAL::mm_unmap_range(reinterpret_cast<VoidPtr>(VirtAddr), Sz) == 0;
+#else
+		return false;
+#endif // ifdef __OPENNE_AMD64__
+	}
+
+	/// @brief Single page requests served by the core's cache.
+	/// @param core the hardware thread index.
+	UInt64 PageMgr::CacheHits(const SizeT core)
+	{
+		if (core >= kMaxAPInsideSched)
+			return 0UL;
+
+		return Detail::kPageCache[core].fHits;
+	}
+
+	/// @brief Single page requests which had to refill the core's cache.
+	/// @param core the hardware thread index.
+	UInt64 PageMgr::CacheMisses(const SizeT core)
+	{
+		if (core >= kMaxAPInsideSched)
+			return 0UL;
+
+		return Detail::kPageCache[core].fMisses;
+	}
+
+	/// @brief Zero one freed page for the zeroed reserve, called by idle cores.
+	/// @return If a page was zeroed.
+	Bool PageMgr::ZeroIdle()
+	{
+		Detail::mm_lock_zero_pool();
+
+		if (Detail::kPageZeroPool.fDirtyCount == 0)
+		{
+			Detail::mm_unlock_zero_pool();
+			return false;
+		}
+
+		UIntPtr page = Detail::kPageZeroPool.fDirty[--Detail::kPageZeroPool.fDirtyCount];
+
+		Detail::mm_unlock_zero_pool();
+
+		// the lock isn't held while clearing, other cores keep taking and giving pages.
+		Detail::mm_zero_page(page, kPageSize);
+
+		Detail::mm_lock_zero_pool();
+
+		if (Detail::kPageZeroPool.fZeroedCount < kPageZeroPoolDepth)
+		{
+			Detail::kPageZeroPool.fZeroed[Detail::kPageZeroPool.fZeroedCount++] = page;
+			Detail::mm_unlock_zero_pool();
+
+			return true;
+		}
+
+		Detail::mm_unlock_zero_pool();
+
+		HAL::mm_free_bitmap(reinterpret_cast<VoidPtr>(page));
+
+		return true;
+	}
+
+	/// @brief Zeroed pages ready to be handed out.
+	SizeT PageMgr::ZeroPoolDepth()
+	{
+		return __atomic_load_n(&Detail::kPageZeroPool.fZeroedCount, __ATOMIC_RELAXED);
+	}
+
+	/// @brief Zeroed requests served by the reserve.
+	UInt64 PageMgr::ZeroPoolHits()
+	{
+		return __atomic_load_n(&Detail::kPageZeroPool.fHits, __ATOMIC_RELAXED);
+	}
+
+	/// @brief Zeroed requests which had to clear their page themselves.
+	UInt64 PageMgr::ZeroPoolMisses()
+	{
+		return __atomic_load_n(&Detail::kPageZeroPool.fMisses, __ATOMIC_RELAXED);
+	}
+
 	/// @brief Virtual PTE address.
 	/// @return The virtual address of the page.
 	const UIntPtr PTEWrapper::VirtualAddress()
@@ -98,6 +481,13 @@ namespace OpenNE
 		return fAccessed;
 	}
 
+	/// @brief Size of the page mapping this address.
+	/// @return kPageSize, or a bigger size when a huge page maps it.
+	SizeT PTEWrapper::PageSize()
+	{
+		return fPageSize;
+	}
+
 	Void PTEWrapper::NoExecute(const bool enable)
 	{
 		fExecDisable = enable;
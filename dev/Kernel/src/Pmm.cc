@@ -28,6 +28,28 @@ namespace OpenNE
 
 	Pmm::~Pmm() = default;
 
+	/***********************************************************************************/
+	/// @brief Write the wrapper's access bits to its page, the pager invalidates it on every core.
+	/***********************************************************************************/
+	Void Pmm::ApplyFlags(PTEWrapper& wrapper)
+	{
+#if defined(__OPENNE_AMD64__)
+		UInt32 flags = 0U;
+
+		if (wrapper.fRw)
+			flags |= HAL::kMMFlagsWr;
+
+		if (wrapper.fUser)
+			flags |= HAL::kMMFlagsUser;
+
+		if (wrapper.fExecDisable)
+			flags |= HAL::kMMFlagsNX;
+
+		// only the access bits change, the entry keeps its frame, cache type and global bit.
+		HAL::mm_protect_page(reinterpret_cast<VoidPtr>(wrapper.VirtualAddress()), flags);
+#endif // defined(__OPENNE_AMD64__)
+	}
+
 	/***********************************************************************************/
 	/// @param If this returns Null pointer, enter emergency mode.
 	/// @param user is this a user page?
@@ -71,7 +93,9 @@ namespace OpenNE
 		if (!PageRef)
 			return false;
 
-		PageRef.Leak().fRw = Enable;
+		PageRef.Leak().fUser = Enable;
+
+		this->ApplyFlags(PageRef.Leak());
 
 		return true;
 	}
@@ -83,6 +107,8 @@ namespace OpenNE
 
 		PageRef.Leak().fRw = Enable;
 
+		this->ApplyFlags(PageRef.Leak());
+
 		return true;
 	}
 
@@ -0,0 +1,313 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#include <KernelKit/DebugOutput.h>
+#include <KernelKit/LPC.h>
+#include <KernelKit/RegionMgr.h>
+#include <ArchKit/ArchKit.h>
+
+//! @file RegionMgr.cc
+//! @brief Kernel regions.
+//! A bitmap of granules covers the region window, a region takes a run of free
+//! granules plus a guard granule, which is never mapped so that overruns fault.
+//! | REGION | GUARD | REGION | GUARD | FREE ... |
+
+namespace OpenNE
+{
+#ifdef __OPENNE_AMD64__
+
+/// @brief Number of granules inside the region window.
+#define kRegionGranuleCount (kKernelRegionMax / kRegionGranuleSz)
+
+	namespace Detail
+	{
+		/// @brief Granules taken by a region or its guard, and the first granule of each region.
+		STATIC UInt64 kRegionUsedMap[kRegionGranuleCount / 64]	= {0};
+		STATIC UInt64 kRegionStartMap[kRegionGranuleCount / 64] = {0};
+
+		/// @brief Where the next search begins, right after the last region made.
+		STATIC SizeT kRegionCursor = 0UL;
+		STATIC Bool	 kRegionLock   = No;
+
+		STATIC Void mm_lock_region()
+		{
+			while (__atomic_test_and_set(&kRegionLock, __ATOMIC_ACQUIRE))
+				;
+		}
+
+		STATIC Void mm_unlock_region()
+		{
+			__atomic_clear(&kRegionLock, __ATOMIC_RELEASE);
+		}
+
+		STATIC Bool mm_region_test(UInt64* map, SizeT index)
+		{
+			return map[index / 64] & (1ULL << (index % 64));
+		}
+
+		STATIC Void mm_region_set(UInt64* map, SizeT index)
+		{
+			map[index / 64] |= (1ULL << (index % 64));
+		}
+
+		STATIC Void mm_region_clear(UInt64* map, SizeT index)
+		{
+			map[index / 64] &= ~(1ULL << (index % 64));
+		}
+
+		/// @brief Next fit search of count free granules, full words are skipped.
+		/// @return The first granule, kRegionGranuleCount if there's no such run.
+		STATIC SizeT mm_region_find(const SizeT count)
+		{
+			SizeT run	= 0UL;
+			SizeT first = 0UL;
+
+			for (SizeT pass = 0UL; pass < kRegionGranuleCount; ++pass)
+			{
+				SizeT index = (kRegionCursor + pass) % kRegionGranuleCount;
+
+				// runs don't wrap around the end of the window.
+				if (index == 0)
+					run = 0UL;
+
+				if (index % 64 == 0 && kRegionUsedMap[index / 64] == ~0ULL)
+				{
+					run = 0UL;
+
+					// the whole word is taken, skip to the next one.
+					pass += 63;
+
+					continue;
+				}
+
+				if (mm_region_test(kRegionUsedMap, index))
+				{
+					run = 0UL;
+					continue;
+				}
+
+				if (run++ == 0)
+					first = index;
+
+				if (run == count)
+					return first;
+			}
+
+			return kRegionGranuleCount;
+		}
+
+		/// @brief Granules of the region starting at first, its guard included.
+		STATIC SizeT mm_region_length(const SizeT first)
+		{
+			SizeT index = first + 1;
+
+			while (index < kRegionGranuleCount &&
+				   mm_region_test(kRegionUsedMap, index) &&
+				   !mm_region_test(kRegionStartMap, index))
+				++index;
+
+			return index - first;
+		}
+
+		STATIC SizeT mm_region_index(VoidPtr ptr)
+		{
+			return ((UIntPtr)ptr - kKernelRegionBase) / kRegionGranuleSz;
+		}
+	} // namespace Detail
+
+	/// @brief Allocate a region, its pages are mapped one by one.
+	/// @param sz the size of the region.
+	/// @param wr Read Write bit.
+	/// @return The region, or nullptr if there's no room left in the window.
+	VoidPtr mm_new_region(const SizeT sz, const Bool wr)
+	{
+		if (sz == 0 || sz > kKernelRegionMax - kRegionGranuleSz)
+			return nullptr;
+
+		const SizeT count = (sz + kRegionGranuleSz - 1) / kRegionGranuleSz + 1;
+
+		Detail::mm_lock_region();
+
+		SizeT first = Detail::mm_region_find(count);
+
+		if (first == kRegionGranuleCount)
+		{
+			Detail::mm_unlock_region();
+
+			kout << "RegionMgr: out of region space." << endl;
+
+			return nullptr;
+		}
+
+		for (SizeT index = first; index < first + count; ++index)
+			Detail::mm_region_set(Detail::kRegionUsedMap, index);
+
+		Detail::mm_region_set(Detail::kRegionStartMap, first);
+		Detail::kRegionCursor = (first + count) % kRegionGranuleCount;
+
+		Detail::mm_unlock_region();
+
+		UIntPtr start = kKernelRegionBase + first * kRegionGranuleSz;
+		UInt32	flags = HAL::kMMFlagsPresent | HAL::kMMFlagsGlobal;
+
+		if (wr)
+			flags |= HAL::kMMFlagsWr;
+
+#ifdef __OPENNE_SUPPORT_NX__
+		flags |= HAL::kMMFlagsNX;
+#endif // __OPENNE_SUPPORT_NX__
+
+		// the range is ours now, map it outside of the lock.
+		for (UIntPtr page = start; page < start + sz; page += kPageSize)
+		{
+			VoidPtr frame = HAL::mm_alloc_bitmap(Yes, No, kPageSize, Yes);
+
+			if (!frame || HAL::mm_map_page(reinterpret_cast<VoidPtr>(page), frame, flags) != 0)
+			{
+				if (frame)
+					HAL::mm_free_bitmap(frame);
+
+				mm_delete_region(reinterpret_cast<VoidPtr>(start));
+
+				return nullptr;
+			}
+		}
+
+		kout << "Created region address: " << hex_number(start) << endl;
+
+		return reinterpret_cast<VoidPtr>(start);
+	}
+
+	/// @brief Unmap a region and give its pages back.
+	/// @param ptr the start of the region.
+	/// @return a status code regarding the deallocation.
+	Int32 mm_delete_region(VoidPtr ptr)
+	{
+		if (!mm_region_owns(ptr) || ((UIntPtr)ptr % kRegionGranuleSz) != 0)
+			return kErrorHeapNotPresent;
+
+		const SizeT first = Detail::mm_region_index(ptr);
+
+		Detail::mm_lock_region();
+
+		if (!Detail::mm_region_test(Detail::kRegionStartMap, first))
+		{
+			Detail::mm_unlock_region();
+			return kErrorHeapNotPresent;
+		}
+
+		// the start bit stays until the granules are free, so that the length of the previous region holds.
+		const SizeT count = Detail::mm_region_length(first);
+
+		Detail::mm_unlock_region();
+
+		constexpr SizeT cBatch = kPageFlushThreshold;
+
+		VoidPtr frames[cBatch];
+		SizeT	frame_cnt = 0;
+
+		UIntPtr start = (UIntPtr)ptr;
+		UIntPtr end	  = start + (count - 1) * kRegionGranuleSz;
+		UIntPtr batch = start;
+
+		for (UIntPtr addr = start; addr < end; addr += kPageSize)
+		{
+			UInt64 phys = HAL::hal_get_phys_address(reinterpret_cast<VoidPtr>(addr));
+
+			if (phys)
+				frames[frame_cnt++] = reinterpret_cast<VoidPtr>(phys);
+
+			// frames are freed once no core can reach them anymore.
+			if (frame_cnt == cBatch || addr + kPageSize == end)
+			{
+				HAL::mm_unmap_range(reinterpret_cast<VoidPtr>(batch), addr + kPageSize - batch);
+
+				while (frame_cnt)
+					HAL::mm_free_bitmap(frames[--frame_cnt]);
+
+				batch = addr + kPageSize;
+			}
+		}
+
+		Detail::mm_lock_region();
+
+		for (SizeT index = first; index < first + count; ++index)
+			Detail::mm_region_clear(Detail::kRegionUsedMap, index);
+
+		Detail::mm_region_clear(Detail::kRegionStartMap, first);
+
+		Detail::mm_unlock_region();
+
+		return kErrorSuccess;
+	}
+
+	/// @brief Check if a pointer lies inside the region window.
+	/// @param ptr the pointer to look up.
+	Bool mm_region_owns(VoidPtr ptr)
+	{
+		return (UIntPtr)ptr - kKernelRegionBase < kKernelRegionMax;
+	}
+
+	/// @brief Check if a pointer is the start of a live region.
+	/// @param ptr the pointer to look up.
+	Bool mm_is_region(VoidPtr ptr)
+	{
+		if (!mm_region_owns(ptr) || ((UIntPtr)ptr % kRegionGranuleSz) != 0)
+			return No;
+
+		return Detail::mm_region_test(Detail::kRegionStartMap, Detail::mm_region_index(ptr));
+	}
+
+	/// @brief Gets the usable size of a region.
+	/// @param ptr the start of the region.
+	/// @return The size, zero if ptr isn't a region.
+	SizeT mm_region_size(VoidPtr ptr)
+	{
+		if (!mm_is_region(ptr))
+			return 0UL;
+
+		Detail::mm_lock_region();
+
+		SizeT count = Detail::mm_region_length(Detail::mm_region_index(ptr));
+
+		Detail::mm_unlock_region();
+
+		return (count - 1) * kRegionGranuleSz;
+	}
+#else
+	VoidPtr mm_new_region(const SizeT sz, const Bool wr)
+	{
+		OPENNE_UNUSED(sz);
+		OPENNE_UNUSED(wr);
+
+		return nullptr;
+	}
+
+	Int32 mm_delete_region(VoidPtr ptr)
+	{
+		OPENNE_UNUSED(ptr);
+		return kErrorHeapNotPresent;
+	}
+
+	Bool mm_region_owns(VoidPtr ptr)
+	{
+		OPENNE_UNUSED(ptr);
+		return No;
+	}
+
+	Bool mm_is_region(VoidPtr ptr)
+	{
+		OPENNE_UNUSED(ptr);
+		return No;
+	}
+
+	SizeT mm_region_size(VoidPtr ptr)
+	{
+		OPENNE_UNUSED(ptr);
+		return 0UL;
+	}
+#endif // ifdef __OPENNE_AMD64__
+} // namespace OpenNE
@@ -0,0 +1,291 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#include <KernelKit/DebugOutput.h>
+#include <KernelKit/LPC.h>
+#include <KernelKit/MemoryMgr.h>
+#include <KernelKit/SectionMgr.h>
+#include <KernelKit/UserProcessScheduler.h>
+#include <NewKit/PageMgr.h>
+
+//! @file SectionMgr.cc
+//! @brief Named shared sections.
+//! A section owns its frames, each mapping is a reservation of the process
+//! pointing at them, and the frames go back once the last reference is dropped.
+
+namespace OpenNE
+{
+	namespace Detail
+	{
+		STATIC SECTION_OBJECT kSections[kSectionMaxCount] = {0};
+		STATIC Bool			  kSectionLock				  = No;
+
+		STATIC Void mm_lock_section()
+		{
+			while (__atomic_test_and_set(&kSectionLock, __ATOMIC_ACQUIRE))
+				;
+		}
+
+		STATIC Void mm_unlock_section()
+		{
+			__atomic_clear(&kSectionLock, __ATOMIC_RELEASE);
+		}
+
+		/// @brief Find a live section by its name, the lock is held.
+		STATIC SECTION_OBJECT* mm_find_section(const Char* name)
+		{
+			for (SizeT index = 0; index < kSectionMaxCount; ++index)
+			{
+				if (kSections[index].fRefs &&
+					rt_string_cmp(kSections[index].fName, name, kSectionNameLen) == 0)
+					return &kSections[index];
+			}
+
+			return nullptr;
+		}
+
+		/// @brief Give the frames of a section back, once nobody can reach them.
+		STATIC Void mm_free_section_frames(UIntPtr* frames, const SizeT pages)
+		{
+			for (SizeT index = 0; index < pages; ++index)
+			{
+				if (frames[index])
+					HAL::mm_free_bitmap(reinterpret_cast<VoidPtr>(frames[index]));
+			}
+
+			mm_delete_heap(frames);
+		}
+	} // namespace Detail
+
+	/// @brief Create a section of zeroed pages, the caller gets its first handle.
+	/// @param name the name of the section, unique among the live ones.
+	/// @param sz the size of the section.
+	/// @return The section, nullptr if the name is taken or memory is short.
+	SECTION_OBJECT* mm_create_section(const Char* name, const SizeT sz)
+	{
+		if (!name || *name == 0 || rt_string_len(name, kSectionNameLen) >= kSectionNameLen ||
+			sz == 0 || sz > kSectionMaxSz)
+			return nullptr;
+
+		const SizeT cPages = (sz + kPageSize - 1) / kPageSize;
+
+		UIntPtr* frames = reinterpret_cast<UIntPtr*>(mm_new_heap(cPages * sizeof(UIntPtr), Yes, No));
+
+		if (!frames)
+			return nullptr;
+
+		PageMgr page_mgr;
+
+		// the frames are taken up front, so that mapping a section never fails halfway for lack of memory.
+		for (SizeT index = 0; index < cPages; ++index)
+		{
+			frames[index] = reinterpret_cast<UIntPtr>(page_mgr.RequestZeroed());
+
+			if (!frames[index])
+			{
+				Detail::mm_free_section_frames(frames, index);
+				return nullptr;
+			}
+		}
+
+		Detail::mm_lock_section();
+
+		SECTION_OBJECT* section = nullptr;
+
+		if (!Detail::mm_find_section(name))
+		{
+			for (SizeT index = 0; index < kSectionMaxCount; ++index)
+			{
+				if (Detail::kSections[index].fRefs)
+					continue;
+
+				section = &Detail::kSections[index];
+
+				rt_set_memory(section->fName, 0, kSectionNameLen / sizeof(UInt32));
+				rt_copy_memory(const_cast<Char*>(name), section->fName, rt_string_len(name, kSectionNameLen));
+
+				section->fSize	 = cPages * kPageSize;
+				section->fFrames = frames;
+				section->fRefs	 = 1U;
+
+				break;
+			}
+		}
+
+		Detail::mm_unlock_section();
+
+		if (!section)
+		{
+			Detail::mm_free_section_frames(frames, cPages);
+
+			kout << "SectionMgr: section name taken, or no slot left." << endl;
+
+			return nullptr;
+		}
+
+		return section;
+	}
+
+	/// @brief Open a handle to a live section.
+	/// @param name the name of the section.
+	/// @return The section, nullptr if there's no such section.
+	SECTION_OBJECT* mm_open_section(const Char* name)
+	{
+		if (!name)
+			return nullptr;
+
+		Detail::mm_lock_section();
+
+		SECTION_OBJECT* section = Detail::mm_find_section(name);
+
+		if (section)
+			++section->fRefs;
+
+		Detail::mm_unlock_section();
+
+		return section;
+	}
+
+	/// @brief Close a handle, the section stays while it is mapped.
+	/// @param section the section.
+	/// @return a status code regarding the close.
+	Int32 mm_close_section(SECTION_OBJECT* section)
+	{
+		if (!section || !section->fRefs)
+			return kErrorInvalidData;
+
+		mm_release_section(section);
+
+		return kErrorSuccess;
+	}
+
+	/// @brief Map a whole section inside a process, with access of its own.
+	/// @param process the process to map it in.
+	/// @param section the section.
+	/// @param access kSectionMapRead, kSectionMapWrite and kSectionMapExec.
+	/// @return The mapping inside the process.
+	ErrorOr<VoidPtr> mm_map_section(UserProcess& process, SECTION_OBJECT* section, const UInt32 access)
+	{
+		if (!section || !access)
+			return ErrorOr<VoidPtr>(kErrorInvalidData);
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		Detail::mm_lock_section();
+
+		// the mapping holds a reference of its own, dropped by Release.
+		Bool live = section->fRefs != 0;
+
+		if (live)
+			++section->fRefs;
+
+		Detail::mm_unlock_section();
+
+		if (!live)
+			return ErrorOr<VoidPtr>(kErrorInvalidData);
+
+		auto pd = hal_read_cr3();
+		HAL::hal_switch_address_space(process.VMRegister);
+
+		auto reserve = process.Reserve(section->fSize);
+
+		if (!reserve)
+		{
+			HAL::hal_switch_address_space(pd);
+			mm_release_section(section);
+
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+		}
+
+		UIntPtr start = reinterpret_cast<UIntPtr>(reserve.Leak().Leak());
+
+		for (SizeT index = 0; index < process.ProcessReserveCount; ++index)
+		{
+			if (process.ProcessReserve[index].fSize && process.ProcessReserve[index].fStart == start)
+				process.ProcessReserve[index].fSection = section;
+		}
+
+		UInt32 flags = HAL::kMMFlagsPresent | HAL::kMMFlagsUser;
+
+		if (access & kSectionMapWrite)
+			flags |= HAL::kMMFlagsWr;
+
+#ifdef __OPENNE_SUPPORT_NX__
+		if (!(access & kSectionMapExec))
+			flags |= HAL::kMMFlagsNX;
+#endif // __OPENNE_SUPPORT_NX__
+
+		for (SizeT index = 0; index < section->fSize / kPageSize; ++index)
+		{
+			if (HAL::mm_map_page(reinterpret_cast<VoidPtr>(start + index * kPageSize),
+								 reinterpret_cast<VoidPtr>(section->fFrames[index]), flags) == 0)
+				continue;
+
+			// the reservation now drops the section's reference too.
+			process.Release(reinterpret_cast<VoidPtr>(start));
+			HAL::hal_switch_address_space(pd);
+
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+		}
+
+		HAL::hal_switch_address_space(pd);
+
+		return ErrorOr<VoidPtr>(reinterpret_cast<VoidPtr>(start));
+#else
+		OPENNE_UNUSED(process);
+
+		// the frames aren't contiguous, only paging can show them as one range.
+		return ErrorOr<VoidPtr>(kErrorInternal);
+#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+	}
+
+	/// @brief Unmap a section from a process, see UserProcess::Release.
+	/// @param process the process it is mapped in.
+	/// @param ptr the mapping given by mm_map_section.
+	/// @return a status code regarding the unmap.
+	Int32 mm_unmap_section(UserProcess& process, VoidPtr ptr)
+	{
+		for (SizeT index = 0; index < process.ProcessReserveCount; ++index)
+		{
+			UserProcess::ProcessReservation& reserve = process.ProcessReserve[index];
+
+			if (!reserve.fSize || reserve.fStart != (UIntPtr)ptr || !reserve.fSection)
+				continue;
+
+			return process.Release(ptr) ? kErrorSuccess : kErrorHeapNotPresent;
+		}
+
+		return kErrorHeapNotPresent;
+	}
+
+	/// @brief Drop a reference, the last one frees the frames of the section.
+	/// @param section the section.
+	Void mm_release_section(SECTION_OBJECT* section)
+	{
+		if (!section)
+			return;
+
+		UIntPtr* frames = nullptr;
+		SizeT	 pages	= 0UL;
+
+		Detail::mm_lock_section();
+
+		// the last reference frees the slot, and with it the name.
+		if (section->fRefs && --section->fRefs == 0)
+		{
+			frames = section->fFrames;
+			pages  = section->fSize / kPageSize;
+
+			section->fFrames = nullptr;
+			section->fSize	 = 0UL;
+		}
+
+		Detail::mm_unlock_section();
+
+		// no mapping is left, so no core can reach the frames anymore.
+		if (frames)
+			Detail::mm_free_section_frames(frames, pages);
+	}
+} // namespace OpenNE
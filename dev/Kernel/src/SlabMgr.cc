@@ -0,0 +1,448 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#include <KernelKit/DebugOutput.h>
+#include <KernelKit/SlabMgr.h>
+#include <NewKit/PageMgr.h>
+#include <NewKit/Utils.h>
+#include <ArchKit/ArchKit.h>
+
+//! @file SlabMgr.cc
+//! @brief Size-class slab allocator.
+//! Small kernel objects are carved out of page-backed spans instead of
+//! requesting a whole bitmap region (plus a heap header) per object.
+//! | SLAB_SPAN | OBJ | OBJ | OBJ | ... |
+//! Each class has its own lock, the span registry too, taken in that order.
+
+/// @brief Object alignment inside a span.
+#define kSlabObjectAlign (16U)
+
+namespace OpenNE
+{
+	namespace Detail
+	{
+		/// @brief Power-of-two and odd classes, from 16 bytes to 3 KiB.
+		STATIC CONST SizeT kSlabClassSizes[kSlabClassCount] = {
+			16, 32, 48, 64, 96, 128, 192, 256,
+			384, 512, 768, 1024, 1536, 2048, 3072};
+
+		/// @brief Slab span header, located at the start of each span.
+		struct SLAB_SPAN final
+		{
+			UInt32	   fMagic;
+			UInt32	   fClass;
+			SizeT	   fObjectSize;
+			SizeT	   fObjectCount;
+			SizeT	   fUsedCount;
+			SizeT	   fBumpIndex;
+			UIntPtr	   fRegion;
+			UIntPtr	   fObjectBase;
+			VoidPtr	   fFreeList;
+			SLAB_SPAN* fNext;
+			SLAB_SPAN* fPrev;
+			UInt8	   fUsedMap[kSlabSpanSize / kSlabMinObjectSize / 8];
+		};
+
+		/// @brief Slab class, holds the spans which still have room.
+		struct SLAB_CLASS final
+		{
+			SLAB_SPAN* fPartial{nullptr};
+			SizeT	   fSpanCount{0UL};
+			Bool	   fLock{No}; // the list, and the spans of the class.
+		};
+
+		STATIC SLAB_CLASS kSlabClasses[kSlabClassCount];
+
+		/// @brief Span registry, sorted by region address for lookups.
+		STATIC SLAB_SPAN* kSlabSpans[kSlabMaxSpans] = {nullptr};
+		STATIC SizeT	  kSlabSpanCount			= 0UL;
+		STATIC Bool		  kSlabSpanLock				= No;
+
+		STATIC Void mm_slab_lock(Bool& lock)
+		{
+			while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE))
+				;
+		}
+
+		STATIC Void mm_slab_unlock(Bool& lock)
+		{
+			__atomic_clear(&lock, __ATOMIC_RELEASE);
+		}
+
+		/// @brief Find the class index of a size.
+		/// @return kSlabClassCount if it doesn't fit.
+		STATIC UInt32 mm_slab_class_of(const SizeT sz)
+		{
+			for (UInt32 class_index = 0U; class_index < kSlabClassCount; ++class_index)
+			{
+				if (sz <= kSlabClassSizes[class_index])
+					return class_index;
+			}
+
+			return kSlabClassCount;
+		}
+
+		/// @brief Binary search of the span registry.
+		/// @return index of the last span whose region starts at or before addr, or -1.
+		STATIC SSizeT mm_slab_search(const UIntPtr addr)
+		{
+			SSizeT low	= 0;
+			SSizeT high = static_cast<SSizeT>(kSlabSpanCount) - 1;
+			SSizeT res	= -1;
+
+			while (low <= high)
+			{
+				SSizeT mid = low + (high - low) / 2;
+
+				if (kSlabSpans[mid]->fRegion <= addr)
+				{
+					res = mid;
+					low = mid + 1;
+				}
+				else
+				{
+					high = mid - 1;
+				}
+			}
+
+			return res;
+		}
+
+		/// @brief Look up the span which holds ptr, with the registry locked.
+		STATIC SLAB_SPAN* mm_slab_find_span(VoidPtr ptr)
+		{
+			if (!ptr || kSlabSpanCount == 0)
+				return nullptr;
+
+			const UIntPtr addr = reinterpret_cast<UIntPtr>(ptr);
+			SSizeT		  idx  = mm_slab_search(addr);
+
+			if (idx < 0)
+				return nullptr;
+
+			SLAB_SPAN* span = kSlabSpans[idx];
+
+			if (addr >= span->fRegion + kSlabSpanSize ||
+				span->fMagic != kSlabMagic)
+				return nullptr;
+
+			return span;
+		}
+
+		STATIC Bool mm_slab_register(SLAB_SPAN* span)
+		{
+			mm_slab_lock(kSlabSpanLock);
+
+			if (kSlabSpanCount >= kSlabMaxSpans)
+			{
+				mm_slab_unlock(kSlabSpanLock);
+				return No;
+			}
+
+			SizeT insert_at = static_cast<SizeT>(mm_slab_search(span->fRegion) + 1);
+
+			for (SizeT idx = kSlabSpanCount; idx > insert_at; --idx)
+				kSlabSpans[idx] = kSlabSpans[idx - 1];
+
+			kSlabSpans[insert_at] = span;
+			++kSlabSpanCount;
+
+			mm_slab_unlock(kSlabSpanLock);
+
+			return Yes;
+		}
+
+		STATIC Void mm_slab_unregister(SLAB_SPAN* span)
+		{
+			mm_slab_lock(kSlabSpanLock);
+
+			SSizeT idx = mm_slab_search(span->fRegion);
+
+			if (idx >= 0 && kSlabSpans[idx] == span)
+			{
+				for (SizeT cur = idx; cur < kSlabSpanCount - 1; ++cur)
+					kSlabSpans[cur] = kSlabSpans[cur + 1];
+
+				--kSlabSpanCount;
+			}
+
+			mm_slab_unlock(kSlabSpanLock);
+		}
+
+		STATIC Void mm_slab_link(SLAB_CLASS& klass, SLAB_SPAN* span)
+		{
+			span->fPrev = nullptr;
+			span->fNext = klass.fPartial;
+
+			if (klass.fPartial)
+				klass.fPartial->fPrev = span;
+
+			klass.fPartial = span;
+		}
+
+		STATIC Void mm_slab_unlink(SLAB_CLASS& klass, SLAB_SPAN* span)
+		{
+			if (span->fPrev)
+				span->fPrev->fNext = span->fNext;
+			else
+				klass.fPartial = span->fNext;
+
+			if (span->fNext)
+				span->fNext->fPrev = span->fPrev;
+
+			span->fNext = nullptr;
+			span->fPrev = nullptr;
+		}
+
+		/// @brief Request a new span from the page manager and register it, with the class locked.
+		STATIC SLAB_SPAN* mm_slab_new_span(const UInt32 class_index)
+		{
+			PageMgr page_mgr;
+			auto	wrapper = page_mgr.Request(Yes, No, No, kSlabSpanSize);
+
+			if (!wrapper.VirtualAddress())
+				return nullptr;
+
+			const UIntPtr region = wrapper.VirtualAddress();
+			SLAB_SPAN*	  span	 = reinterpret_cast<SLAB_SPAN*>(region);
+
+			rt_set_memory(span->fUsedMap, 0, sizeof(span->fUsedMap) / sizeof(UInt32));
+
+			span->fMagic	  = kSlabMagic;
+			span->fClass	  = class_index;
+			span->fObjectSize = kSlabClassSizes[class_index];
+			span->fRegion	  = region;
+			span->fObjectBase = (reinterpret_cast<UIntPtr>(span) + sizeof(SLAB_SPAN) + kSlabObjectAlign - 1) &
+								~static_cast<UIntPtr>(kSlabObjectAlign - 1);
+			span->fObjectCount = (region + kSlabSpanSize - span->fObjectBase) / span->fObjectSize;
+			span->fUsedCount   = 0UL;
+			span->fBumpIndex   = 0UL;
+			span->fFreeList	   = nullptr;
+			span->fNext		   = nullptr;
+			span->fPrev		   = nullptr;
+
+			if (!mm_slab_register(span))
+			{
+				span->fMagic = 0;
+
+				PTEWrapper		page_wrapper(No, No, No, region);
+				Ref<PTEWrapper> pte_ref{page_wrapper};
+
+				page_mgr.Free(pte_ref);
+
+				return nullptr;
+			}
+
+			++kSlabClasses[class_index].fSpanCount;
+
+			return span;
+		}
+
+		/// @brief Give an empty span back to the page manager, with its class locked.
+		STATIC Void mm_slab_release_span(SLAB_SPAN* span)
+		{
+			SLAB_CLASS& klass = kSlabClasses[span->fClass];
+
+			mm_slab_unlink(klass, span);
+			mm_slab_unregister(span);
+
+			--klass.fSpanCount;
+
+			span->fMagic = 0;
+
+			PTEWrapper		page_wrapper(No, No, No, span->fRegion);
+			Ref<PTEWrapper> pte_ref{page_wrapper};
+
+			PageMgr page_mgr;
+			page_mgr.Free(pte_ref);
+		}
+
+		/// @brief Compute the object index of ptr inside span.
+		/// @return fObjectCount if ptr isn't the start of an object.
+		STATIC SizeT mm_slab_index_of(SLAB_SPAN* span, VoidPtr ptr)
+		{
+			const UIntPtr addr = reinterpret_cast<UIntPtr>(ptr);
+
+			if (addr < span->fObjectBase)
+				return span->fObjectCount;
+
+			const UIntPtr offset = addr - span->fObjectBase;
+
+			if (offset % span->fObjectSize != 0)
+				return span->fObjectCount;
+
+			const SizeT index = offset / span->fObjectSize;
+
+			if (index >= span->fObjectCount)
+				return span->fObjectCount;
+
+			return index;
+		}
+
+		STATIC Bool mm_slab_test_bit(SLAB_SPAN* span, SizeT index)
+		{
+			return (span->fUsedMap[index / 8] >> (index % 8)) & 1;
+		}
+	} // namespace Detail
+
+	/// @brief Allocate an object from the slab.
+	/// @param sz the size of the object, must not exceed kSlabMaxObjectSize.
+	/// @return The object, or nullptr if no span could be made.
+	VoidPtr mm_slab_alloc(const SizeT sz)
+	{
+		const UInt32 class_index = Detail::mm_slab_class_of(sz);
+
+		if (class_index >= kSlabClassCount)
+			return nullptr;
+
+		Detail::SLAB_CLASS& klass = Detail::kSlabClasses[class_index];
+
+		Detail::mm_slab_lock(klass.fLock);
+
+		Detail::SLAB_SPAN* span = klass.fPartial;
+
+		if (!span)
+		{
+			span = Detail::mm_slab_new_span(class_index);
+
+			if (!span)
+			{
+				Detail::mm_slab_unlock(klass.fLock);
+				return nullptr;
+			}
+
+			Detail::mm_slab_link(klass, span);
+		}
+
+		VoidPtr object = nullptr;
+
+		if (span->fFreeList)
+		{
+			object			= span->fFreeList;
+			span->fFreeList = *reinterpret_cast<VoidPtr*>(object);
+		}
+		else
+		{
+			object = reinterpret_cast<VoidPtr>(span->fObjectBase + span->fBumpIndex * span->fObjectSize);
+			++span->fBumpIndex;
+		}
+
+		const SizeT index = Detail::mm_slab_index_of(span, object);
+		span->fUsedMap[index / 8] |= (1 << (index % 8));
+
+		++span->fUsedCount;
+
+		if (span->fUsedCount == span->fObjectCount)
+			Detail::mm_slab_unlink(klass, span);
+
+		Detail::mm_slab_unlock(klass.fLock);
+
+		return object;
+	}
+
+	/// @brief Release an object to its span.
+	/// @param ptr the object.
+	/// @return if the object was owned and allocated.
+	Bool mm_slab_free(VoidPtr ptr)
+	{
+		Detail::mm_slab_lock(Detail::kSlabSpanLock);
+
+		Detail::SLAB_SPAN* span		   = Detail::mm_slab_find_span(ptr);
+		UInt32			   klass_index = span ? span->fClass : kSlabClassCount;
+
+		Detail::mm_slab_unlock(Detail::kSlabSpanLock);
+
+		if (klass_index >= kSlabClassCount)
+			return No;
+
+		// our object keeps the span alive, unless it was already freed: the span is looked up again.
+		Detail::SLAB_CLASS& klass = Detail::kSlabClasses[klass_index];
+
+		Detail::mm_slab_lock(klass.fLock);
+		Detail::mm_slab_lock(Detail::kSlabSpanLock);
+
+		Bool same = Detail::mm_slab_find_span(ptr) == span;
+
+		Detail::mm_slab_unlock(Detail::kSlabSpanLock);
+
+		const SizeT index = same ? Detail::mm_slab_index_of(span, ptr) : 0UL;
+
+		if (!same || index >= span->fObjectCount ||
+			!Detail::mm_slab_test_bit(span, index))
+		{
+			Detail::mm_slab_unlock(klass.fLock);
+
+			kout << "Slab: Invalid or double free: " << hex_number(reinterpret_cast<UIntPtr>(ptr)) << endl;
+			return No;
+		}
+
+		span->fUsedMap[index / 8] &= ~(1 << (index % 8));
+
+		*reinterpret_cast<VoidPtr*>(ptr) = span->fFreeList;
+		span->fFreeList					 = ptr;
+
+		if (span->fUsedCount == span->fObjectCount)
+			Detail::mm_slab_link(klass, span);
+
+		--span->fUsedCount;
+
+		// keep one span around per class, so that alloc/free pairs don't thrash the page manager.
+		if (span->fUsedCount == 0 &&
+			klass.fSpanCount > 1)
+			Detail::mm_slab_release_span(span);
+
+		Detail::mm_slab_unlock(klass.fLock);
+
+		return Yes;
+	}
+
+	/// @brief Check if a pointer lies inside a slab span.
+	/// @param ptr the pointer to look up.
+	Bool mm_slab_owns(VoidPtr ptr)
+	{
+		Detail::mm_slab_lock(Detail::kSlabSpanLock);
+		Bool ret = Detail::mm_slab_find_span(ptr) != nullptr;
+		Detail::mm_slab_unlock(Detail::kSlabSpanLock);
+
+		return ret;
+	}
+
+	/// @brief Check if a pointer is a live slab object.
+	/// @param ptr the pointer to look up.
+	Bool mm_slab_is_allocated(VoidPtr ptr)
+	{
+		// the registry lock keeps the span from going away meanwhile.
+		Detail::mm_slab_lock(Detail::kSlabSpanLock);
+
+		Detail::SLAB_SPAN* span = Detail::mm_slab_find_span(ptr);
+		Bool			   ret	= No;
+
+		if (span)
+		{
+			const SizeT index = Detail::mm_slab_index_of(span, ptr);
+			ret				  = index < span->fObjectCount && Detail::mm_slab_test_bit(span, index);
+		}
+
+		Detail::mm_slab_unlock(Detail::kSlabSpanLock);
+
+		return ret;
+	}
+
+	/// @brief Gets the class size of a slab object.
+	/// @param ptr the object.
+	/// @return The usable size of the object, zero if not a slab object.
+	SizeT mm_slab_object_size(VoidPtr ptr)
+	{
+		Detail::mm_slab_lock(Detail::kSlabSpanLock);
+
+		Detail::SLAB_SPAN* span = Detail::mm_slab_find_span(ptr);
+		SizeT			   ret	= span ? span->fObjectSize : 0UL;
+
+		Detail::mm_slab_unlock(Detail::kSlabSpanLock);
+
+		return ret;
+	}
+} // namespace OpenNE
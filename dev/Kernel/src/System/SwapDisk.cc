@@ -4,11 +4,62 @@
 
 ------------------------------------------- */
 
+#include <ArchKit/ArchKit.h>
 #include <SystemKit/SwapDisk.h>
 #include <KernelKit/FileMgr.h>
+#include <KernelKit/SlabMgr.h>
+#include <NewKit/Lz.h>
 
 namespace OpenNE
 {
+	SwapDisk::~SwapDisk()
+	{
+		if (fFile)
+			delete fFile;
+
+		fFile = nullptr;
+	}
+
+	/// @brief The swap disk of the system, its page file is opened on first use.
+	SwapDisk& SwapDisk::The()
+	{
+		STATIC SwapDisk the;
+		return the;
+	}
+
+	/// @brief Open the page file once, it is made if it doesn't exist yet.
+	BOOL SwapDisk::Open()
+	{
+		if (__atomic_load_n(&fFile, __ATOMIC_ACQUIRE))
+			return fFile->Leak() != nullptr;
+
+		auto man = IFilesystemMgr::GetMounted();
+
+		if (!man)
+			return NO;
+
+		while (__atomic_test_and_set(&fOpenLock, __ATOMIC_ACQUIRE))
+			;
+
+		if (!fFile)
+		{
+			NodePtr node = man->Open(kSwapPageFile, kRestrictRWB);
+
+			if (!node)
+				node = man->CreateSwapFile(kSwapPageFile, kSwapSlotCount * kSwapSlotSize);
+
+			if (node)
+			{
+				mm_delete_heap(node);
+				__atomic_store_n(&fFile, new FileStreamUTF8(kSwapPageFile, kRestrictRWB), __ATOMIC_RELEASE);
+			}
+		}
+
+		__atomic_clear(&fOpenLock, __ATOMIC_RELEASE);
+
+		return fFile && fFile->Leak() != nullptr;
+	}
+
 	BOOL SwapDisk::Write(const Char* fork_name, const SizeT fork_name_len, SWAP_DISK_HEADER_REF data, const SizeT data_len)
 	{
 		if (!fork_name || !fork_name_len)
@@ -20,9 +71,10 @@ namespace OpenNE
 		if (!data)
 			return NO;
 
-		FileStream file(kSwapPageFile, "wb");
+		if (!this->Open())
+			return NO;
 
-		auto ret = file.Write(fork_name, data, sizeof(SWAP_DISK_HEADER) + data_len);
+		auto ret = fFile->Write(fork_name, data, sizeof(SWAP_DISK_HEADER) + data_len);
 
 		if (ret.Error())
 			return NO;
@@ -38,10 +90,273 @@ namespace OpenNE
 		if (data_len > kSwapBlockMaxSize)
 			return nullptr;
 
-		FileStream file(kSwapPageFile, "rb");
+		if (!this->Open())
+			return nullptr;
 
-		VoidPtr blob = file.Read(fork_name, sizeof(SWAP_DISK_HEADER) + data_len);
+		VoidPtr blob = fFile->Read(fork_name, sizeof(SWAP_DISK_HEADER) + data_len);
 
 		return (SWAP_DISK_HEADER_REF)blob;
 	}
+
+	/// @brief Take a free slot among count slots from first, searching from where the last one was found.
+	/// @return The slot, kSwapSlotInvalid if they are all taken.
+	Int64 SwapDisk::TakeSlot(const SizeT first, const SizeT count, SizeT& cursor)
+	{
+		const SizeT cWords = count / 64;
+		SizeT		start  = __atomic_load_n(&cursor, __ATOMIC_RELAXED);
+
+		for (SizeT index = 0; index < cWords; ++index)
+		{
+			SizeT  word = first / 64 + (start + index) % cWords;
+			UInt64 map	= __atomic_load_n(&fSlotMap[word], __ATOMIC_ACQUIRE);
+
+			while (~map)
+			{
+				UInt64 bit = __builtin_ctzll(~map);
+
+				if (__atomic_compare_exchange_n(&fSlotMap[word], &map, map | (1ULL << bit), NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				{
+					__atomic_store_n(&cursor, word - first / 64, __ATOMIC_RELAXED);
+					return word * 64 + bit;
+				}
+			}
+		}
+
+		return kSwapSlotInvalid;
+	}
+
+	Int64 SwapDisk::WriteSlot(const SWAP_DISK_HEADER* key, VoidPtr blob)
+	{
+		if (!key || !blob || key->fBlobSz == 0 || key->fBlobSz > kSwapSlotSize)
+			return kSwapSlotInvalid;
+
+		// the page file only gets what the pool can't keep.
+		Int64 slot = this->WritePool(key, blob);
+
+		if (slot != kSwapSlotInvalid)
+			return slot;
+
+		__atomic_add_fetch(&fStats.fPoolSpills, 1, __ATOMIC_RELAXED);
+
+		if (!this->Open())
+			return kSwapSlotInvalid;
+
+		slot = this->TakeSlot(0, kSwapSlotCount, fSlotCursor);
+
+		if (slot == kSwapSlotInvalid)
+			return kSwapSlotInvalid;
+
+		fSlotKey[slot].fTeamID		   = key->fTeamID;
+		fSlotKey[slot].fProcessID	   = key->fProcessID;
+		fSlotKey[slot].fVirtualAddress = key->fVirtualAddress;
+
+		// written in place inside the page file, the slot is only handed out once the drive took it.
+		auto ret = fFile->Write(slot * kSwapSlotSize, blob, key->fBlobSz);
+
+		if (ret.Error())
+		{
+			this->FreeSlot(slot);
+			return kSwapSlotInvalid;
+		}
+
+		return slot;
+	}
+
+	BOOL SwapDisk::ReadSlot(const Int64 slot, const SWAP_DISK_HEADER* key, VoidPtr blob)
+	{
+		if (!key || !blob || slot < 0 || slot >= kSwapSlotCount + kSwapPoolSlotCount ||
+			key->fBlobSz == 0 || key->fBlobSz > kSwapSlotSize)
+			return NO;
+
+		if (!(__atomic_load_n(&fSlotMap[slot / 64], __ATOMIC_ACQUIRE) & (1ULL << (slot % 64))))
+			return NO;
+
+		if (fSlotKey[slot].fTeamID != key->fTeamID ||
+			fSlotKey[slot].fProcessID != key->fProcessID ||
+			fSlotKey[slot].fVirtualAddress != key->fVirtualAddress)
+			return NO;
+
+		if (slot >= kSwapSlotCount)
+			return this->ReadPool(slot, key, blob);
+
+		if (!this->Open())
+			return NO;
+
+		// read in place from the page file.
+		Char* data = reinterpret_cast<Char*>(fFile->Read(slot * kSwapSlotSize, key->fBlobSz));
+
+		if (!data)
+			return NO;
+
+		for (SizeT index = 0; index < key->fBlobSz; ++index)
+			reinterpret_cast<Char*>(blob)[index] = data[index];
+
+		mm_delete_heap(data);
+
+		__atomic_add_fetch(&fStats.fDiskHits, 1, __ATOMIC_RELAXED);
+
+		return YES;
+	}
+
+	Void SwapDisk::FreeSlot(const Int64 slot)
+	{
+		if (slot < 0 || slot >= kSwapSlotCount + kSwapPoolSlotCount)
+			return;
+
+		if (slot >= kSwapSlotCount)
+		{
+			SWAP_POOL_ENTRY& entry = fPoolEntry[slot - kSwapSlotCount];
+
+			if (entry.fBlob)
+			{
+				__atomic_sub_fetch(&fPoolBytes, mm_slab_object_size(entry.fBlob), __ATOMIC_RELAXED);
+				mm_slab_free(entry.fBlob);
+			}
+			else
+			{
+				__atomic_sub_fetch(&fStats.fSameFilled, 1, __ATOMIC_RELAXED);
+			}
+
+			__atomic_sub_fetch(&fStats.fPoolPages, 1, __ATOMIC_RELAXED);
+			__atomic_sub_fetch(&fStats.fBytesIn, kSwapSlotSize, __ATOMIC_RELAXED);
+			__atomic_sub_fetch(&fStats.fBytesOut, entry.fSize, __ATOMIC_RELAXED);
+
+			entry.fBlob = nullptr;
+			entry.fSize = 0UL;
+		}
+
+		__atomic_fetch_and(&fSlotMap[slot / 64], ~(1ULL << (slot % 64)), __ATOMIC_RELEASE);
+	}
+
+	/// @brief Keep a page in the pool, compressed, or as a word when all of its words are the same.
+	/// @return The slot, kSwapSlotInvalid if the pool is full or the page doesn't compress well enough.
+	Int64 SwapDisk::WritePool(const SWAP_DISK_HEADER* key, VoidPtr blob)
+	{
+		if (kSwapPoolPercent == 0 || key->fBlobSz != kSwapSlotSize)
+			return kSwapSlotInvalid;
+
+		const UInt64* words = reinterpret_cast<const UInt64*>(blob);
+		Bool		  same	= YES;
+
+		// zeroed stacks and sparse heaps mostly, they take no room at all.
+		for (SizeT index = 1; index < kSwapSlotSize / sizeof(UInt64); ++index)
+		{
+			if (words[index] != words[0])
+			{
+				same = NO;
+				break;
+			}
+		}
+
+		VoidPtr data = nullptr;
+		SizeT	size = 0UL;
+
+		if (!same)
+		{
+			const SizeT cLimit = (kKernelBitMpSize / 100) * kSwapPoolPercent;
+
+			while (__atomic_test_and_set(&fPoolLock, __ATOMIC_ACQUIRE))
+				;
+
+			size = ke_lz_compress(reinterpret_cast<const UInt8*>(blob), kSwapSlotSize, fPoolScratch, kSwapPoolMaxBlob);
+
+			if (size && __atomic_load_n(&fPoolBytes, __ATOMIC_RELAXED) + size <= cLimit)
+				data = mm_slab_alloc(size);
+
+			if (data)
+			{
+				for (SizeT index = 0; index < size; ++index)
+					reinterpret_cast<UInt8*>(data)[index] = fPoolScratch[index];
+			}
+
+			__atomic_clear(&fPoolLock, __ATOMIC_RELEASE);
+
+			if (!data)
+				return kSwapSlotInvalid;
+		}
+
+		Int64 slot = this->TakeSlot(kSwapSlotCount, kSwapPoolSlotCount, fPoolCursor);
+
+		if (slot == kSwapSlotInvalid)
+		{
+			if (data)
+				mm_slab_free(data);
+
+			return kSwapSlotInvalid;
+		}
+
+		SWAP_POOL_ENTRY& entry = fPoolEntry[slot - kSwapSlotCount];
+
+		entry.fBlob = data;
+		entry.fSize = size;
+		entry.fFill = words[0];
+
+		fSlotKey[slot].fTeamID		   = key->fTeamID;
+		fSlotKey[slot].fProcessID	   = key->fProcessID;
+		fSlotKey[slot].fVirtualAddress = key->fVirtualAddress;
+
+		if (data)
+			__atomic_add_fetch(&fPoolBytes, mm_slab_object_size(data), __ATOMIC_RELAXED);
+		else
+			__atomic_add_fetch(&fStats.fSameFilled, 1, __ATOMIC_RELAXED);
+
+		__atomic_add_fetch(&fStats.fPoolPages, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&fStats.fBytesIn, kSwapSlotSize, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&fStats.fBytesOut, size, __ATOMIC_RELAXED);
+
+		return slot;
+	}
+
+	BOOL SwapDisk::ReadPool(const Int64 slot, const SWAP_DISK_HEADER* key, VoidPtr blob)
+	{
+		SWAP_POOL_ENTRY& entry = fPoolEntry[slot - kSwapSlotCount];
+
+		if (key->fBlobSz != kSwapSlotSize)
+			return NO;
+
+		if (!entry.fBlob)
+		{
+			UInt64* words = reinterpret_cast<UInt64*>(blob);
+
+			for (SizeT index = 0; index < kSwapSlotSize / sizeof(UInt64); ++index)
+				words[index] = entry.fFill;
+		}
+		else if (ke_lz_decompress(reinterpret_cast<const UInt8*>(entry.fBlob), entry.fSize,
+								  reinterpret_cast<UInt8*>(blob), kSwapSlotSize) != kSwapSlotSize)
+		{
+			return NO;
+		}
+
+		__atomic_add_fetch(&fStats.fPoolHits, 1, __ATOMIC_RELAXED);
+
+		return YES;
+	}
+
+	const SWAP_DISK_STATS& SwapDisk::Stats() noexcept
+	{
+		return fStats;
+	}
+
+	SizeT SwapDisk::CompressionRatio() noexcept
+	{
+		SizeT bytes_in	= __atomic_load_n(&fStats.fBytesIn, __ATOMIC_RELAXED);
+		SizeT bytes_out = __atomic_load_n(&fStats.fBytesOut, __ATOMIC_RELAXED);
+
+		// same-filled pages take nothing, count at least a byte for the ratio to mean something.
+		if (bytes_out == 0)
+			return bytes_in ? bytes_in * 100 : 0UL;
+
+		return bytes_in * 100 / bytes_out;
+	}
+
+	SizeT SwapDisk::HitRate() noexcept
+	{
+		SizeT pool_hits = __atomic_load_n(&fStats.fPoolHits, __ATOMIC_RELAXED);
+		SizeT disk_hits = __atomic_load_n(&fStats.fDiskHits, __ATOMIC_RELAXED);
+
+		if (pool_hits + disk_hits == 0)
+			return 0UL;
+
+		return pool_hits * 100 / (pool_hits + disk_hits);
+	}
 } // namespace OpenNE
@@ -0,0 +1,273 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+#include <KernelKit/UserProcessArena.h>
+#include <KernelKit/MemoryMgr.h>
+
+//! @file UserProcessArena.cc
+//! @brief Per process arena.
+//! The chunks are user heaps, their headers and the index are kernel memory,
+//! so that the process can't corrupt what the kernel walks.
+
+namespace OpenNE
+{
+	namespace Detail
+	{
+		/// @brief Slot of an address inside an index of size entries, size is a power of two.
+		STATIC SizeT arena_hash(UIntPtr addr, SizeT size)
+		{
+			return (((addr >> kArenaMinBlockShift) * 0x9E3779B97F4A7C15ULL) >> 32) & (size - 1);
+		}
+	} // namespace Detail
+
+	/// @brief Releases the chunks in one go, no matter how many blocks are still in use.
+	UserProcessArena::~UserProcessArena()
+	{
+		while (fChunks)
+		{
+			ARENA_CHUNK* next = fChunks->fNext;
+
+			mm_delete_heap(reinterpret_cast<VoidPtr>(fChunks->fStart));
+			delete fChunks;
+
+			fChunks = next;
+		}
+
+		if (fIndex)
+			mm_delete_heap(fIndex);
+
+		fIndex	   = nullptr;
+		fIndexSize = 0UL;
+		fCount	   = 0UL;
+		fDeleted   = 0UL;
+	}
+
+	VoidPtr UserProcessArena::Alloc(const SizeT& sz, const SizeT& pad)
+	{
+		SizeT total = sz + pad;
+
+		if (total == 0 || total > (1UL << kArenaMaxBlockShift))
+			return nullptr;
+
+		UInt32 klass = 0;
+
+		while ((1UL << (klass + kArenaMinBlockShift)) < total)
+			++klass;
+
+		// make room in the index first, nothing to undo after that.
+		if (!this->Grow())
+			return nullptr;
+
+		ARENA_CHUNK* chunk = fFreeChunks[klass];
+
+		if (!chunk)
+			chunk = this->NewChunk(klass);
+
+		if (!chunk)
+			return nullptr;
+
+		for (SizeT word = 0; word < kArenaChunkMaxBlocks / 64; ++word)
+		{
+			if (!~chunk->fUsedMap[word])
+				continue;
+
+			SizeT bit = __builtin_ctzll(~chunk->fUsedMap[word]);
+
+			chunk->fUsedMap[word] |= (1ULL << bit);
+
+			if (--chunk->fFreeBlocks == 0)
+				fFreeChunks[klass] = chunk->fNextFree;
+
+			ARENA_ENTRY entry{};
+
+			entry.fAddress = chunk->fStart + ((word * 64 + bit) << (klass + kArenaMinBlockShift));
+			entry.fSize	   = sz;
+			entry.fPad	   = pad;
+			entry.fChunk   = chunk;
+			entry.fKind	   = kArenaEntryBlock;
+
+			this->Insert(entry);
+
+			return reinterpret_cast<VoidPtr>(entry.fAddress);
+		}
+
+		return nullptr;
+	}
+
+	Bool UserProcessArena::Track(VoidPtr ptr, const SizeT& sz, const SizeT& pad)
+	{
+		if (!ptr || !this->Grow())
+			return No;
+
+		ARENA_ENTRY entry{};
+
+		entry.fAddress = reinterpret_cast<UIntPtr>(ptr);
+		entry.fSize	   = sz;
+		entry.fPad	   = pad;
+		entry.fChunk   = nullptr;
+		entry.fKind	   = kArenaEntryReserved;
+
+		return this->Insert(entry);
+	}
+
+	ARENA_ENTRY* UserProcessArena::Find(VoidPtr ptr)
+	{
+		if (!ptr || !fIndex)
+			return nullptr;
+
+		UIntPtr addr = reinterpret_cast<UIntPtr>(ptr);
+		SizeT	slot = Detail::arena_hash(addr, fIndexSize);
+
+		while (fIndex[slot].fKind != kArenaEntryEmpty)
+		{
+			if (fIndex[slot].fKind != kArenaEntryDeleted && fIndex[slot].fAddress == addr)
+				return &fIndex[slot];
+
+			slot = (slot + 1) & (fIndexSize - 1);
+		}
+
+		return nullptr;
+	}
+
+	Bool UserProcessArena::Free(ARENA_ENTRY* entry)
+	{
+		if (!entry ||
+			(entry->fKind != kArenaEntryBlock && entry->fKind != kArenaEntryReserved))
+			return No;
+
+		if (entry->fKind == kArenaEntryBlock)
+		{
+			ARENA_CHUNK* chunk = entry->fChunk;
+			SizeT		 block = (entry->fAddress - chunk->fStart) >> (chunk->fClass + kArenaMinBlockShift);
+
+			chunk->fUsedMap[block / 64] &= ~(1ULL << (block % 64));
+
+			// it was full, so it isn't in the free list yet.
+			if (chunk->fFreeBlocks++ == 0)
+			{
+				chunk->fNextFree		   = fFreeChunks[chunk->fClass];
+				fFreeChunks[chunk->fClass] = chunk;
+			}
+		}
+
+		entry->fKind = kArenaEntryDeleted;
+
+		--fCount;
+		++fDeleted;
+
+		return Yes;
+	}
+
+	SizeT UserProcessArena::Count() noexcept
+	{
+		return fCount;
+	}
+
+	/// @brief Put an entry in the index, Grow made sure there's room for it.
+	Bool UserProcessArena::Insert(const ARENA_ENTRY& entry)
+	{
+		if (!fIndex)
+			return No;
+
+		SizeT slot = Detail::arena_hash(entry.fAddress, fIndexSize);
+
+		while (fIndex[slot].fKind == kArenaEntryBlock || fIndex[slot].fKind == kArenaEntryReserved)
+			slot = (slot + 1) & (fIndexSize - 1);
+
+		if (fIndex[slot].fKind == kArenaEntryDeleted)
+			--fDeleted;
+
+		fIndex[slot] = entry;
+		++fCount;
+
+		return Yes;
+	}
+
+	/// @brief Rebuild the index once it is 3/4 full, counting deleted entries, so that one more fits.
+	/// Only the live entries are kept, and at most half of the new index is used.
+	Bool UserProcessArena::Grow()
+	{
+		if (fIndex && (fCount + fDeleted + 1) * 4 <= fIndexSize * 3)
+			return Yes;
+
+		SizeT size = kArenaIndexMinSz;
+
+		while ((fCount + 1) * 2 > size)
+			size *= 2;
+
+		ARENA_ENTRY* index = reinterpret_cast<ARENA_ENTRY*>(mm_new_heap(sizeof(ARENA_ENTRY) * size, Yes, No));
+
+		if (!index)
+			return No;
+
+		for (SizeT slot = 0; slot < size; ++slot)
+			index[slot].fKind = kArenaEntryEmpty;
+
+		ARENA_ENTRY* old_index = fIndex;
+		SizeT		 old_size  = fIndexSize;
+
+		fIndex	   = index;
+		fIndexSize = size;
+		fCount	   = 0UL;
+		fDeleted   = 0UL;
+
+		for (SizeT slot = 0; slot < old_size; ++slot)
+		{
+			if (old_index[slot].fKind == kArenaEntryBlock || old_index[slot].fKind == kArenaEntryReserved)
+				this->Insert(old_index[slot]);
+		}
+
+		if (old_index)
+			mm_delete_heap(old_index);
+
+		return Yes;
+	}
+
+	/// @brief Make a chunk for a class, in the address space we're running on.
+	ARENA_CHUNK* UserProcessArena::NewChunk(const UInt32 klass)
+	{
+		SizeT block_sz = 1UL << (klass + kArenaMinBlockShift);
+		SizeT size	   = block_sz * kArenaChunkMinBlocks > kArenaChunkSz ? block_sz * kArenaChunkMinBlocks : kArenaChunkSz;
+		SizeT blocks   = size / block_sz;
+
+		ARENA_CHUNK* chunk = new ARENA_CHUNK();
+
+		if (!chunk)
+			return nullptr;
+
+		VoidPtr start = mm_new_heap(size, Yes, Yes);
+
+		if (!start)
+		{
+			delete chunk;
+			return nullptr;
+		}
+
+		chunk->fStart	   = reinterpret_cast<UIntPtr>(start);
+		chunk->fSize	   = size;
+		chunk->fClass	   = klass;
+		chunk->fFreeBlocks = blocks;
+
+		// the bits past the last block are never handed out.
+		for (SizeT word = 0; word < kArenaChunkMaxBlocks / 64; ++word)
+		{
+			if (word * 64 >= blocks)
+				chunk->fUsedMap[word] = ~0ULL;
+			else if (blocks - word * 64 < 64)
+				chunk->fUsedMap[word] = ~0ULL << (blocks - word * 64);
+			else
+				chunk->fUsedMap[word] = 0ULL;
+		}
+
+		chunk->fNext	 = fChunks;
+		chunk->fNextFree = fFreeChunks[klass];
+
+		fChunks			   = chunk;
+		fFreeChunks[klass] = chunk;
+
+		return chunk;
+	}
+} // namespace OpenNE
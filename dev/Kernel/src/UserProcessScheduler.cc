@@ -17,8 +17,11 @@
 #include <KernelKit/IPEFDylibObject.h>
 #include <ArchKit/ArchKit.h>
 #include <KernelKit/MemoryMgr.h>
+#include <NewKit/PageMgr.h>
 #include <NewKit/KString.h>
 #include <KernelKit/LPC.h>
+#include <KernelKit/SectionMgr.h>
+#include <SystemKit/SwapDisk.h>
 
 ///! BUGS: 0
 
@@ -107,53 +110,733 @@ namespace OpenNE
 
 	ErrorOr<VoidPtr> UserProcess::New(const SizeT& sz, const SizeT& pad_amount)
 	{
+		if (sz + pad_amount == 0)
+			return ErrorOr<VoidPtr>(kErrorInvalidData);
+
+		if (!this->ProcessArena)
+			this->ProcessArena = new UserProcessArena();
+
+		if (!this->ProcessArena)
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+		VoidPtr ptr		 = nullptr;
+		Bool	reserved = sz + pad_amount >= kSchedReserveMinSz;
+
+		// big allocations are backed on first touch.
+		if (reserved)
+		{
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+			// the range is in this process's tables, whoever asks for it.
+			auto pd = hal_read_cr3();
+			HAL::hal_switch_address_space(this->VMRegister);
+
+			auto reserve = this->Reserve(sz + pad_amount);
+
+			HAL::hal_switch_address_space(pd);
+#else
+			auto reserve = this->Reserve(sz + pad_amount);
+#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+
+			if (!reserve)
+				return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+			ptr = reserve.Leak().Leak();
+
+			if (!this->ProcessArena->Track(ptr, sz, pad_amount))
+			{
+				this->Release(ptr);
+				return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+			}
+
+			// reserved memory is accounted for as it gets backed.
+			return ErrorOr<VoidPtr>(ptr);
+		}
+
 #ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
 		auto vm_register = hal_read_cr3();
-		hal_write_cr3(this->VMRegister);
+		HAL::hal_switch_address_space(this->VMRegister);
 
-		auto ptr = mm_new_heap(sz + pad_amount, Yes, Yes);
+		ptr = this->ProcessArena->Alloc(sz, pad_amount);
 
-		hal_write_cr3(vm_register);
+		HAL::hal_switch_address_space(vm_register);
 #else
-		auto ptr = mm_new_heap(sz + pad_amount, Yes, Yes);
+		ptr = this->ProcessArena->Alloc(sz, pad_amount);
 #endif
 
-		if (!this->ProcessMemoryHeap)
+		if (!ptr)
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+		this->UsedMemory += sz;
+
+		return ErrorOr<VoidPtr>(ptr);
+	}
+
+	/***********************************************************************************/
+	/** @brief Thread-local allocation, New is only called once per chunk. */
+	/***********************************************************************************/
+
+	ErrorOr<VoidPtr> UserProcess::NewLocal(const SizeT& sz)
+	{
+		if (sz == 0 || sz > kArenaBumpChunkSz)
+			return ErrorOr<VoidPtr>(kErrorInvalidData);
+
+		SizeT size = (sz + kArenaBumpAlign - 1) & ~(kArenaBumpAlign - 1);
+
+		// what's left of the chunk is dropped, the process arena still releases it.
+		if (this->LocalArena.fEnd - this->LocalArena.fCursor < size)
 		{
-			this->ProcessMemoryHeap = new UserProcess::ProcessMemoryHeapList();
+			auto chunk = this->New(kArenaBumpChunkSz);
+
+			if (!chunk)
+				return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
 
-			this->ProcessMemoryHeap->MemoryEntryPad	 = pad_amount;
-			this->ProcessMemoryHeap->MemoryEntrySize = sz;
+			this->LocalArena.fCursor = reinterpret_cast<UIntPtr>(chunk.Leak().Leak());
+			this->LocalArena.fEnd	 = this->LocalArena.fCursor + kArenaBumpChunkSz;
+		}
+
+		this->LocalArena.fLast = this->LocalArena.fCursor;
+		this->LocalArena.fCursor += size;
+
+		return ErrorOr<VoidPtr>(reinterpret_cast<VoidPtr>(this->LocalArena.fLast));
+	}
 
-			this->ProcessMemoryHeap->MemoryEntry = ptr;
+	/***********************************************************************************/
+	/** @brief Thread-local free, the other objects go when the process exits. */
+	/***********************************************************************************/
+
+	Boolean UserProcess::DeleteLocal(VoidPtr ptr, const SizeT& sz)
+	{
+		if (!ptr || sz == 0)
+			return No;
 
-			this->ProcessMemoryHeap->MemoryPrev = nullptr;
-			this->ProcessMemoryHeap->MemoryNext = nullptr;
+		if (reinterpret_cast<UIntPtr>(ptr) == this->LocalArena.fLast)
+		{
+			this->LocalArena.fCursor = this->LocalArena.fLast;
+			this->LocalArena.fLast	 = 0UL;
 		}
-		else
+
+		return Yes;
+	}
+
+	/***********************************************************************************/
+	/// @brief Reclaim doesn't run twice at once, nor while a reservation table moves.
+	/***********************************************************************************/
+
+	STATIC Bool kSwapLock = No;
+
+	/***********************************************************************************/
+	/// @brief Put a new reservation table in process, Reclaim never sees it half done.
+	/// @return The previous table, for the caller to delete.
+	/***********************************************************************************/
+
+	STATIC UserProcess::ProcessReservation* sched_swap_reservations(UserProcess& process, UserProcess::ProcessReservation* table,
+																	 const SizeT count)
+	{
+		while (__atomic_test_and_set(&kSwapLock, __ATOMIC_ACQUIRE))
+			;
+
+		UserProcess::ProcessReservation* old = process.ProcessReserve;
+
+		for (SizeT index = 0; table && index < process.ProcessReserveCount; ++index)
+			table[index] = old[index];
+
+		process.ProcessReserve		= table;
+		process.ProcessReserveCount = count;
+
+		__atomic_clear(&kSwapLock, __ATOMIC_RELEASE);
+
+		return old;
+	}
+
+	/***********************************************************************************/
+	/// @brief Find a free slot in the reservation table of process, the table doubles when full.
+	/// @return The slot, nullptr if the table couldn't grow.
+	/***********************************************************************************/
+
+	STATIC UserProcess::ProcessReservation* sched_new_reservation(UserProcess& process)
+	{
+		for (SizeT index = 0; index < process.ProcessReserveCount; ++index)
 		{
-			ProcessMemoryHeapList* entry	  = this->ProcessMemoryHeap;
-			ProcessMemoryHeapList* prev_entry = nullptr;
+			if (!process.ProcessReserve[index].fSize)
+				return &process.ProcessReserve[index];
+		}
+
+		SizeT count = process.ProcessReserveCount ? process.ProcessReserveCount * 2 : kSchedMinReservations;
+		SizeT first = process.ProcessReserveCount;
+
+		UserProcess::ProcessReservation* table = new UserProcess::ProcessReservation[count];
+
+		if (!table)
+			return nullptr;
+
+		UserProcess::ProcessReservation* old = sched_swap_reservations(process, table, count);
 
-			while (entry)
+		if (old)
+			delete[] old;
+
+		return &table[first];
+	}
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+	/***********************************************************************************/
+	/// @brief First fit of sz bytes, over guard bytes, in the reserve window of process.
+	/// Only process maps this window in its address space, so its table is the whole map,
+	/// and a released range is found free again.
+	/// @return The start of the range, zero if the window is full.
+	/***********************************************************************************/
+
+	STATIC UIntPtr sched_find_range(UserProcess& process, const SizeT sz, const SizeT guard)
+	{
+		// leave an unmapped page between ranges, so that overflows fault.
+		UIntPtr start = kSchedReserveStart + guard;
+
+		// each move goes past a range for good, so this settles within count + 1 passes.
+		for (SizeT pass = 0; pass <= process.ProcessReserveCount; ++pass)
+		{
+			Bool moved = No;
+
+			for (SizeT index = 0; index < process.ProcessReserveCount; ++index)
 			{
-				if (entry->MemoryEntry == nullptr)
-					break; // chose to break here, when we get an already allocated memory entry for our needs.
+				UserProcess::ProcessReservation& reserve = process.ProcessReserve[index];
 
-				prev_entry = entry;
-				entry	   = entry->MemoryNext;
-			}
+				if (!reserve.fSize)
+					continue;
 
-			entry->MemoryNext			   = new ProcessMemoryHeapList();
-			entry->MemoryNext->MemoryEntry = ptr;
+				UIntPtr low	 = reserve.fStart - reserve.fGuard;
+				UIntPtr high = reserve.fStart + reserve.fSize + kPageSize;
+
+				if (start - guard < high && low < start + sz + kPageSize)
+				{
+					start = high + guard;
+					moved = Yes;
+				}
+			}
 
-			entry->MemoryNext->MemoryPrev = entry;
-			entry->MemoryNext->MemoryNext = nullptr;
+			if (!moved)
+				break;
 		}
 
-		this->UsedMemory += sz;
+		if (start + sz + kPageSize > kSchedReserveEnd)
+			return 0UL;
+
+		return start;
+	}
+#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+
+	/***********************************************************************************/
+	/** @brief Reserve a range without backing it, Fault backs it on first touch. */
+	/***********************************************************************************/
+
+	ErrorOr<VoidPtr> UserProcess::Reserve(const SizeT& sz, const SizeT& guard)
+	{
+		if (sz == 0)
+			return ErrorOr<VoidPtr>(kErrorInvalidData);
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		SizeT size		 = (sz + kPageSize - 1) & ~(kPageSize - 1);
+		SizeT guard_size = (guard + kPageSize - 1) & ~(kPageSize - 1);
+
+		ProcessReservation* reserve = sched_new_reservation(*this);
+
+		if (!reserve)
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+		// the guard goes under the range.
+		UIntPtr start = sched_find_range(*this, size, guard_size);
+
+		if (!start)
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+		reserve->fStart		   = start;
+		reserve->fSize		   = size;
+		reserve->fGuard		   = guard_size;
+		reserve->fAddressSpace = hal_read_cr3();
+
+		return ErrorOr<VoidPtr>(reinterpret_cast<VoidPtr>(reserve->fStart));
+#else
+		ProcessReservation* reserve = sched_new_reservation(*this);
+
+		if (!reserve)
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+		// no paging to defer the backing nor to guard it, take it all now.
+		auto ptr = mm_new_heap(sz, Yes, Yes);
+
+		if (!ptr)
+			return ErrorOr<VoidPtr>(kErrorHeapOutOfMemory);
+
+		reserve->fStart = reinterpret_cast<UIntPtr>(ptr);
+		reserve->fSize	= sz;
 
 		return ErrorOr<VoidPtr>(ptr);
+#endif
+	}
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+	/***********************************************************************************/
+	/// @brief Unmap a range and give back the frames and swap slots which backed it.
+	/// The address space of the range must be loaded.
+	/// @param used_memory the owner's accounting, a page less for each frame.
+	/***********************************************************************************/
+
+	STATIC Void sched_free_range(const UIntPtr start, const SizeT size, SizeT& used_memory)
+	{
+		constexpr SizeT cBatch = kPageFlushThreshold;
+
+		VoidPtr frames[cBatch];
+		SizeT	frame_cnt = 0;
+		UIntPtr batch	  = start;
+
+		for (UIntPtr addr = start; addr < start + size; addr += kPageSize)
+		{
+			UInt64 phys = HAL::hal_get_phys_address(reinterpret_cast<VoidPtr>(addr));
+
+			if (phys)
+			{
+				frames[frame_cnt++] = reinterpret_cast<VoidPtr>(phys);
+
+				// shared pages were accounted for by the parent.
+				if (used_memory >= kPageSize)
+					used_memory -= kPageSize;
+			}
+			else
+			{
+				SwapDisk::The().FreeSlot(HAL::mm_swap_slot(reinterpret_cast<VoidPtr>(addr)));
+			}
+
+			// frames are freed once no core can reach them anymore.
+			if (frame_cnt == cBatch || addr + kPageSize == start + size)
+			{
+				HAL::mm_unmap_range(reinterpret_cast<VoidPtr>(batch), addr + kPageSize - batch);
+
+				while (frame_cnt)
+					HAL::mm_put_frame(frames[--frame_cnt]);
+
+				batch = addr + kPageSize;
+			}
+		}
+	}
+
+	/// @brief What's left of a process which exited on its own stack, or with its address space loaded.
+	struct SCHED_REAP_ENTRY final
+	{
+		VoidPtr fAddressSpace;
+		UIntPtr fStackStart;
+		SizeT	fStackSize;
+	};
+
+	STATIC SCHED_REAP_ENTRY kReapList[kSchedProcessLimitPerTeam];
+	STATIC Bool				kReapLock = No;
+
+	/***********************************************************************************/
+	/// @brief Queue the stack and address space of an exited process, see sched_reap.
+	/// @return if there was room for it.
+	/***********************************************************************************/
+
+	STATIC Bool sched_defer_reap(VoidPtr address_space, UIntPtr stack_start, SizeT stack_size)
+	{
+		Bool queued = No;
+
+		while (__atomic_test_and_set(&kReapLock, __ATOMIC_ACQUIRE))
+			;
+
+		for (SizeT index = 0; index < kSchedProcessLimitPerTeam; ++index)
+		{
+			if (kReapList[index].fAddressSpace)
+				continue;
+
+			kReapList[index].fAddressSpace = address_space;
+			kReapList[index].fStackStart   = stack_start;
+			kReapList[index].fStackSize	   = stack_size;
+
+			queued = Yes;
+			break;
+		}
+
+		__atomic_clear(&kReapLock, __ATOMIC_RELEASE);
+
+		return queued;
+	}
+
+	/***********************************************************************************/
+	/// @brief Free the stacks and address spaces queued by Exit.
+	/// Runs on the scheduler's stack, an address space still loaded waits for the next call.
+	/***********************************************************************************/
+
+	STATIC Void sched_reap()
+	{
+		if (__atomic_test_and_set(&kReapLock, __ATOMIC_ACQUIRE))
+			return;
+
+		auto pd = hal_read_cr3();
+
+		for (SizeT index = 0; index < kSchedProcessLimitPerTeam; ++index)
+		{
+			SCHED_REAP_ENTRY& entry = kReapList[index];
+
+			if (!entry.fAddressSpace ||
+				((UIntPtr)entry.fAddressSpace & kPageAddressMask) == ((UIntPtr)pd & kPageAddressMask))
+				continue;
+
+			SizeT used_memory = 0UL;
+
+			if (entry.fStackSize)
+			{
+				HAL::hal_switch_address_space(entry.fAddressSpace);
+				sched_free_range(entry.fStackStart, entry.fStackSize, used_memory);
+				HAL::hal_switch_address_space(pd);
+			}
+
+			HAL::mp_forget_address_space(entry.fAddressSpace);
+			HAL::mm_delete_address_space(entry.fAddressSpace);
+
+			entry = SCHED_REAP_ENTRY{};
+		}
+
+		__atomic_clear(&kReapLock, __ATOMIC_RELEASE);
+	}
+#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+
+	/***********************************************************************************/
+	/** @brief Release a reserved range and the pages which backed it. */
+	/***********************************************************************************/
+
+	Bool UserProcess::Release(VoidPtr ptr)
+	{
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		for (SizeT index = 0; index < this->ProcessReserveCount; ++index)
+		{
+			ProcessReservation& reserve = this->ProcessReserve[index];
+
+			if (!reserve.fSize || reserve.fStart != (UIntPtr)ptr)
+				continue;
+
+			auto pd = hal_read_cr3();
+			HAL::hal_switch_address_space(reserve.fAddressSpace);
+
+			// a section keeps its frames, only this mapping goes.
+			if (reserve.fSection)
+			{
+				SECTION_OBJECT* section = reserve.fSection;
+
+				HAL::mm_unmap_range(reinterpret_cast<VoidPtr>(reserve.fStart), reserve.fSize);
+				HAL::hal_switch_address_space(pd);
+
+				reserve.fStart		  = 0UL;
+				reserve.fSize		  = 0UL;
+				reserve.fGuard		  = 0UL;
+				reserve.fAddressSpace = nullptr;
+				reserve.fSection	  = nullptr;
+
+				mm_release_section(section);
+
+				return Yes;
+			}
+
+			sched_free_range(reserve.fStart, reserve.fSize, this->UsedMemory);
+
+			HAL::hal_switch_address_space(pd);
+
+			reserve.fStart		  = 0UL;
+			reserve.fSize		  = 0UL;
+			reserve.fGuard		  = 0UL;
+			reserve.fAddressSpace = nullptr;
+
+			return Yes;
+		}
+
+		return No;
+#else
+		for (SizeT index = 0; index < this->ProcessReserveCount; ++index)
+		{
+			ProcessReservation& reserve = this->ProcessReserve[index];
+
+			if (!reserve.fSize || reserve.fStart != (UIntPtr)ptr)
+				continue;
+
+			reserve.fStart = 0UL;
+			reserve.fSize  = 0UL;
+
+			return mm_delete_heap(ptr) == kErrorSuccess;
+		}
+
+		return No;
+#endif
+	}
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+	/***********************************************************************************/
+	/// @brief Key of a page of process inside the swap file.
+	/***********************************************************************************/
+
+	STATIC SWAP_DISK_HEADER sched_swap_key(UserProcess& process, VoidPtr page)
+	{
+		SWAP_DISK_HEADER key{};
+
+		key.fMagic			= kSwapMagic;
+		key.fHeaderSz		= sizeof(SWAP_DISK_HEADER);
+		key.fTeamID			= process.ProcessParentTeam ? process.ProcessParentTeam->mTeamId : 0UL;
+		key.fProcessID		= process.ProcessId;
+		key.fVirtualAddress = (UIntPtr)page;
+		key.fBlobSz			= kPageSize;
+
+		return key;
+	}
+
+	/***********************************************************************************/
+	/// @brief Write a page of process to the swap file, and give its frame back.
+	/// The page is unmapped before it is written, so no write to it can be lost.
+	/***********************************************************************************/
+
+	STATIC Bool sched_swap_out(UserProcess& process, VoidPtr page)
+	{
+		UInt64 frame = HAL::mm_swap_out_page(page);
+
+		if (!frame)
+			return No;
+
+		SWAP_DISK_HEADER key  = sched_swap_key(process, page);
+		Int64			 slot = SwapDisk::The().WriteSlot(&key, HAL::mm_phys_to_virt(frame));
+
+		if (!HAL::mm_swap_commit(page, frame, slot))
+		{
+			SwapDisk::The().FreeSlot(slot);
+			return No;
+		}
+
+		if (process.UsedMemory >= kPageSize)
+			process.UsedMemory -= kPageSize;
+
+		return Yes;
+	}
+#endif
+
+	/***********************************************************************************/
+	/** @brief Demand-zero fault, back the page of fault_addr if it was reserved. */
+	/***********************************************************************************/
+
+	Bool UserProcess::Fault(VoidPtr fault_addr)
+	{
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		UIntPtr addr = (UIntPtr)fault_addr & ~(kPageSize - 1);
+
+		for (SizeT index = 0; index < this->ProcessReserveCount; ++index)
+		{
+			ProcessReservation& reserve = this->ProcessReserve[index];
+
+			// the stack grew past its reserve, don't let it reach what lies under.
+			if (reserve.fGuard && addr < reserve.fStart && addr >= reserve.fStart - reserve.fGuard)
+			{
+				kout << "KTrace: Stack Overflow.\r";
+				return No;
+			}
+
+			if (addr < reserve.fStart || addr >= reserve.fStart + reserve.fSize)
+				continue;
+
+			// sections are mapped whole, a fault there is an access the mapping doesn't allow.
+			if (reserve.fSection)
+				return No;
+
+			// only backed inside its own address space.
+			if (((UIntPtr)hal_read_cr3() & kPageAddressMask) != ((UIntPtr)reserve.fAddressSpace & kPageAddressMask))
+				return No;
+
+			// already backed, only a write to a shared page is legal.
+			if (HAL::mm_get_page_size(reinterpret_cast<VoidPtr>(addr)))
+				return HAL::mm_cow_fault(reinterpret_cast<VoidPtr>(addr));
+
+			if (HAL::mm_is_swapped(reinterpret_cast<VoidPtr>(addr)))
+				return this->SwapIn(reinterpret_cast<VoidPtr>(addr));
+
+			// demand zero, idle cores have usually cleared one ahead of us.
+			PageMgr page_mgr;
+			VoidPtr frame = page_mgr.RequestZeroed();
+
+			if (!frame)
+				return No;
+
+			UInt32 flags = HAL::kMMFlagsPresent;
+			flags |= HAL::kMMFlagsWr;
+			flags |= HAL::kMMFlagsUser;
+
+			if (HAL::mm_map_page(reinterpret_cast<VoidPtr>(addr), frame, flags))
+			{
+				HAL::mm_free_bitmap(frame);
+				return No;
+			}
+
+			this->UsedMemory += kPageSize;
+
+			return Yes;
+		}
+
+		return No;
+#else
+		return No;
+#endif
+	}
+
+	/***********************************************************************************/
+	/** @brief Read a swapped page back, unless it is still being written out. */
+	/***********************************************************************************/
+
+	Bool UserProcess::SwapIn(VoidPtr page)
+	{
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		if (HAL::mm_swap_in_page(page, nullptr))
+			return Yes;
+
+		Int64 slot = HAL::mm_swap_slot(page);
+
+		if (slot < 0)
+			return No;
+
+		VoidPtr frame = HAL::mm_alloc_bitmap(Yes, Yes, kPageSize, Yes);
+
+		if (!frame)
+			return No;
+
+		SWAP_DISK_HEADER key = sched_swap_key(*this, page);
+
+		if (!SwapDisk::The().ReadSlot(slot, &key, HAL::mm_phys_to_virt((UIntPtr)frame)))
+		{
+			HAL::mm_free_bitmap(frame);
+			return No;
+		}
+
+		// someone else brought it back meanwhile.
+		if (!HAL::mm_swap_in_page(page, frame))
+		{
+			HAL::mm_free_bitmap(frame);
+			return HAL::mm_get_page_size(page) != 0;
+		}
+
+		SwapDisk::The().FreeSlot(slot);
+
+		this->UsedMemory += kPageSize;
+
+		return Yes;
+#else
+		return No;
+#endif
+	}
+
+	/***********************************************************************************/
+	/** @brief Share the image of parent, and copy its reserved memory on write. */
+	/** @note The child runs on a stack of its own, the parent's isn't mapped in its tables. */
+	/** Small blocks of New live in kernel memory both can write to, and go when the */
+	/** parent exits: a parent which holds any can't be duplicated. */
+	/***********************************************************************************/
+
+	Bool UserProcess::Duplicate(UserProcess& parent)
+	{
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		SizeT reserved_cnt = 0UL;
+
+		for (SizeT reserve_index = 0; reserve_index < parent.ProcessReserveCount; ++reserve_index)
+		{
+			ProcessReservation* src = &parent.ProcessReserve[reserve_index];
+
+			ARENA_ENTRY* entry = parent.ProcessArena ? parent.ProcessArena->Find(reinterpret_cast<VoidPtr>(src->fStart)) : nullptr;
+
+			if (src->fSize && entry && entry->fKind == kArenaEntryReserved)
+				++reserved_cnt;
+		}
+
+		if (parent.ProcessArena && parent.ProcessArena->Count() != reserved_cnt)
+		{
+			kout << parent.Name << ": holds small blocks, which can't be copied on write." << endl;
+			return No;
+		}
+#endif
+
+		// the image goes away with the last process running it.
+		if (!parent.Image.fShareCount)
+		{
+			parent.Image.fShareCount = new SizeT(1);
+
+			if (!parent.Image.fShareCount)
+				return No;
+		}
+
+		__atomic_add_fetch(parent.Image.fShareCount, 1, __ATOMIC_ACQ_REL);
+
+		this->Image = parent.Image;
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		// our stack may sit where a range of the parent goes, it's untouched yet, so it moves above them.
+		if (this->StackReserve)
+		{
+			this->Release(reinterpret_cast<VoidPtr>(this->StackReserve));
+			this->StackReserve = nullptr;
+		}
+
+		for (SizeT reserve_index = 0; reserve_index < parent.ProcessReserveCount; ++reserve_index)
+		{
+			ProcessReservation* src = &parent.ProcessReserve[reserve_index];
+
+			// only what New handed out, the stack has its own.
+			ARENA_ENTRY* entry = parent.ProcessArena ? parent.ProcessArena->Find(reinterpret_cast<VoidPtr>(src->fStart)) : nullptr;
+
+			if (!src->fSize || !entry || entry->fKind != kArenaEntryReserved)
+				continue;
+
+			if (!this->ProcessArena)
+				this->ProcessArena = new UserProcessArena();
+
+			if (!this->ProcessArena)
+				return No;
+
+			// the range keeps its address, so that the pointers stored in it still hold.
+			ProcessReservation* dst = sched_new_reservation(*this);
+
+			if (!dst)
+				return No;
+
+			dst->fStart		   = src->fStart;
+			dst->fSize		   = src->fSize;
+			dst->fGuard		   = src->fGuard;
+			dst->fAddressSpace = this->VMRegister;
+
+			auto pd = hal_read_cr3();
+
+			// the parent's entries are walked from its own address space.
+			HAL::hal_switch_address_space(src->fAddressSpace);
+
+			// swapped pages are read back, they can't be shared from the swap file.
+			for (UIntPtr addr = src->fStart; addr < src->fStart + src->fSize; addr += kPageSize)
+			{
+				if (HAL::mm_is_swapped(reinterpret_cast<VoidPtr>(addr)))
+					parent.SwapIn(reinterpret_cast<VoidPtr>(addr));
+			}
+
+			Bool ok = HAL::mm_cow_range(reinterpret_cast<VoidPtr>(src->fStart), this->VMRegister,
+										reinterpret_cast<VoidPtr>(dst->fStart), src->fSize) == 0;
+
+			HAL::hal_switch_address_space(pd);
+
+			if (!ok)
+				return No;
+
+			if (!this->ProcessArena->Track(reinterpret_cast<VoidPtr>(dst->fStart), entry->fSize, entry->fPad))
+				return No;
+		}
+
+		auto pd = hal_read_cr3();
+		HAL::hal_switch_address_space(this->VMRegister);
+
+		auto stack = this->Reserve(this->StackSize, kSchedStackGuardSz);
+
+		HAL::hal_switch_address_space(pd);
+
+		if (!stack)
+			return No;
+
+		this->StackReserve = reinterpret_cast<UInt8*>(stack.Leak().Leak());
+#endif
+
+		return Yes;
 	}
 
 	/***********************************************************************************/
@@ -205,40 +888,103 @@ namespace OpenNE
 
 		kLastExitCode = exit_code;
 
-		auto memory_heap_list = this->ProcessMemoryHeap;
+		// the dylib object lives in the thread's arena, so it goes first.
+		if (this->Kind == kExectuableDylibKind)
+		{
+			Bool success = false;
+
+			rtl_fini_dylib(*this, reinterpret_cast<IPEFDylibObject*>(this->DylibDelegate), &success);
+
+			if (!success)
+			{
+				ke_panic(RUNTIME_CHECK_PROCESS);
+			}
+
+			this->DylibDelegate = nullptr;
+		}
 
 #ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
 		auto pd = hal_read_cr3();
-		hal_write_cr3(this->VMRegister);
+		HAL::hal_switch_address_space(this->VMRegister);
 #endif
 
-		// Deleting memory lists. Make sure to free all of them.
-		while (memory_heap_list)
+		// the chunks go all at once, not block per block, thread-local objects with them.
+		this->LocalArena = ARENA_BUMP{};
+
+		if (this->ProcessArena)
+			delete this->ProcessArena;
+
+		this->ProcessArena = nullptr;
+
+		// then the reserved ranges, the stack is released last.
+		for (SizeT index = 0; index < this->ProcessReserveCount; ++index)
+		{
+			ProcessReservation& reserve = this->ProcessReserve[index];
+
+			if (!reserve.fSize || reserve.fStart == reinterpret_cast<UIntPtr>(this->StackReserve))
+				continue;
+
+			MUST_PASS(this->Release(reinterpret_cast<VoidPtr>(reserve.fStart)));
+		}
+
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		HAL::hal_switch_address_space(pd);
+
+		// a fault may exit us on the very stack we'd free, or with our tables loaded:
+		// the scheduler frees both later then, see sched_reap.
+		UIntPtr here	 = reinterpret_cast<UIntPtr>(&pd);
+		UIntPtr stack	 = reinterpret_cast<UIntPtr>(this->StackReserve);
+		Bool	on_stack = stack && here >= stack && here < stack + this->StackSize;
+		Bool	loaded	 = ((UIntPtr)pd & kPageAddressMask) == ((UIntPtr)this->VMRegister & kPageAddressMask);
+
+		if (on_stack || loaded)
 		{
-			if (memory_heap_list->MemoryEntry)
+			SizeT stack_size = 0UL;
+
+			for (SizeT index = 0; index < this->ProcessReserveCount; ++index)
 			{
-				MUST_PASS(mm_delete_heap(memory_heap_list->MemoryEntry));
+				if (!this->ProcessReserve[index].fSize || this->ProcessReserve[index].fStart != stack)
+					continue;
+
+				stack_size					= this->ProcessReserve[index].fSize;
+				this->ProcessReserve[index] = ProcessReservation{};
 			}
 
-#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
-			hal_write_cr3(pd);
+			if (!sched_defer_reap(this->VMRegister, stack, stack_size))
+				kout << this->Name << ": no room to reap, its stack and tables leak." << endl;
+		}
+		else
+		{
+			// the stack goes while its tables are still there.
+			if (this->StackReserve)
+				this->Release(reinterpret_cast<VoidPtr>(this->StackReserve));
+
+			//! Free the memory's page directory.
+			HAL::mp_forget_address_space(this->VMRegister);
+			HAL::mm_delete_address_space(this->VMRegister);
+		}
+
+		this->StackReserve = nullptr;
+		this->VMRegister   = nullptr;
 #endif
 
-			auto next = memory_heap_list->MemoryNext;
+		//! Delete image if not done already, a shared one goes with its last process.
+		Bool image_owner = !this->Image.fShareCount ||
+						   __atomic_sub_fetch(this->Image.fShareCount, 1, __ATOMIC_ACQ_REL) == 0;
 
-			mm_delete_heap(memory_heap_list);
-			memory_heap_list = next;
-		}
+		if (image_owner)
+		{
+			if (this->Image.fShareCount)
+				delete this->Image.fShareCount;
 
-		//! Free the memory's page directory.
-		HAL::mm_free_bitmap(this->VMRegister);
+			if (this->Image.fCode && mm_is_valid_heap(this->Image.fCode))
+				mm_delete_heap(this->Image.fCode);
 
-		//! Delete image if not done already.
-		if (this->Image.fCode && mm_is_valid_heap(this->Image.fCode))
-			mm_delete_heap(this->Image.fCode);
+			if (this->Image.fBlob && mm_is_valid_heap(this->Image.fBlob))
+				mm_delete_heap(this->Image.fBlob);
+		}
 
-		if (this->Image.fBlob && mm_is_valid_heap(this->Image.fBlob))
-			mm_delete_heap(this->Image.fBlob);
+		this->Image.fShareCount = nullptr;
 
 		if (this->StackFrame && mm_is_valid_heap(this->StackFrame))
 			mm_delete_heap((VoidPtr)this->StackFrame);
@@ -247,22 +993,18 @@ namespace OpenNE
 		this->Image.fCode = nullptr;
 		this->StackFrame  = nullptr;
 
-		if (this->Kind == kExectuableDylibKind)
-		{
-			Bool success = false;
-
-			rtl_fini_dylib(*this, reinterpret_cast<IPEFDylibObject*>(this->DylibDelegate), &success);
+#ifndef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		if (this->StackReserve)
+			this->Release(reinterpret_cast<VoidPtr>(this->StackReserve));
 
-			if (!success)
-			{
-				ke_panic(RUNTIME_CHECK_PROCESS);
-			}
+		this->StackReserve = nullptr;
+#endif
 
-			this->DylibDelegate = nullptr;
-		}
+		// every range is gone by now, and so is the need for their table.
+		ProcessReservation* table = sched_swap_reservations(*this, nullptr, 0UL);
 
-		if (this->StackReserve)
-			mm_delete_heap(reinterpret_cast<VoidPtr>(this->StackReserve));
+		if (table)
+			delete[] table;
 
 		this->ProcessId = 0;
 		this->Status	= ProcessStatusKind::kFinished;
@@ -297,19 +1039,14 @@ namespace OpenNE
 		rt_copy_memory(reinterpret_cast<VoidPtr>(const_cast<Char*>(name)), process.Name, rt_string_len(name));
 
 #ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
-		process.VMRegister = new PDE();
+		// the kernel half is shared, not copied.
+		process.VMRegister = HAL::mm_new_address_space();
 
 		if (!process.VMRegister)
 		{
 			process.Crash();
 			return kErrorProcessFault;
 		}
-
-		UInt32 flags = HAL::kMMFlagsPresent;
-		flags |= HAL::kMMFlagsWr;
-		flags |= HAL::kMMFlagsUser;
-
-		HAL::mm_map_page((VoidPtr)process.VMRegister, (VoidPtr)process.VMRegister, flags);
 #endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
 
 		process.StackFrame = new HAL::StackFrame();
@@ -321,7 +1058,7 @@ namespace OpenNE
 		}
 
 #ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
-		flags = HAL::kMMFlagsPresent;
+		UInt32 flags = HAL::kMMFlagsPresent;
 		flags |= HAL::kMMFlagsWr;
 		flags |= HAL::kMMFlagsUser;
 
@@ -341,21 +1078,25 @@ namespace OpenNE
 		}
 		}
 
-		process.StackReserve = new UInt8[process.StackSize];
+		// the stack is only backed as deep as it grows, and faults under its reserve.
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		auto pd = hal_read_cr3();
+		HAL::hal_switch_address_space(process.VMRegister);
+
+		auto stack = process.Reserve(process.StackSize, kSchedStackGuardSz);
 
-		if (!process.StackReserve)
+		HAL::hal_switch_address_space(pd);
+#else
+		auto stack = process.Reserve(process.StackSize, kSchedStackGuardSz);
+#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+
+		if (!stack)
 		{
 			process.Crash();
 			return kErrorProcessFault;
 		}
 
-#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
-		flags = HAL::kMMFlagsPresent;
-		flags |= HAL::kMMFlagsWr;
-		flags |= HAL::kMMFlagsUser;
-
-		HAL::mm_map_page((VoidPtr)process.StackReserve, (VoidPtr)process.StackReserve, flags);
-#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		process.StackReserve = reinterpret_cast<UInt8*>(stack.Leak().Leak());
 
 		process.ProcessParentTeam = &mTeam;
 
@@ -369,6 +1110,38 @@ namespace OpenNE
 		return pid;
 	}
 
+	/***********************************************************************************/
+	/// @brief Spawn a process running the image of parent.
+	/// Its reserved memory is shared copy-on-write, only the pages written to get copied.
+	/// @param name the name of the new process.
+	/// @param parent the process to duplicate.
+	/// @return the process index inside the team.
+	/***********************************************************************************/
+
+	ProcessID UserProcessScheduler::Spawn(const Char* name, UserProcess& parent)
+	{
+		ProcessID pid = this->Spawn(name, nullptr, nullptr);
+
+		if (pid < 0 || pid >= kSchedProcessLimitPerTeam ||
+			this->mTeam.mProcessList[pid].Status != ProcessStatusKind::kStarting)
+			return kErrorProcessFault;
+
+		UserProcess& process = this->mTeam.mProcessList[pid];
+
+		process.Kind		= parent.Kind;
+		process.SubSystem	= parent.SubSystem;
+		process.Owner		= parent.Owner;
+		process.MemoryLimit = parent.MemoryLimit;
+
+		if (!process.Duplicate(parent))
+		{
+			process.Crash();
+			return kErrorProcessFault;
+		}
+
+		return pid;
+	}
+
 	/***********************************************************************************/
 	/// @brief Retrieves the singleton of the process scheduler.
 	/***********************************************************************************/
@@ -424,6 +1197,11 @@ namespace OpenNE
 		SizeT process_index = 0; //! we store this guy to tell the scheduler how many
 								 //! things we have scheduled.
 
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		// what exited processes couldn't free on their own.
+		sched_reap();
+#endif // __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+
 		if (mTeam.mProcessCount < 1)
 		{
 			kout << "UserProcessScheduler::Run(): This team doesn't have any process!\r";
@@ -463,6 +1241,83 @@ namespace OpenNE
 		return process_index;
 	}
 
+	/***********************************************************************************/
+	/// @brief CLOCK over the pages of every reserved range.
+	/// An accessed page has its bit cleared and is passed, the others are swapped out.
+	/// @return The pages freed.
+	/***********************************************************************************/
+
+	SizeT UserProcessScheduler::Reclaim(const SizeT pages) noexcept
+	{
+#ifdef __OPENNE_VIRTUAL_MEMORY_SUPPORT__
+		if (!pages || __atomic_test_and_set(&kSwapLock, __ATOMIC_ACQUIRE))
+			return 0;
+
+		auto  pd		= hal_read_cr3();
+		SizeT reclaimed = 0;
+		SizeT turns		= 0;
+
+		// the first turn may only clear accessed bits, the second one finds them cold.
+		while (reclaimed < pages && turns < 2)
+		{
+			if (mClockHand.fProcess >= mTeam.AsArray().Count())
+			{
+				mClockHand.fProcess = 0;
+				mClockHand.fReserve = 0;
+				mClockHand.fOffset	= 0;
+
+				++turns;
+				continue;
+			}
+
+			UserProcess& process = mTeam.AsArray()[mClockHand.fProcess];
+
+			if (mClockHand.fReserve >= process.ProcessReserveCount)
+			{
+				mClockHand.fReserve = 0;
+				mClockHand.fOffset	= 0;
+
+				++mClockHand.fProcess;
+				continue;
+			}
+
+			UserProcess::ProcessReservation& reserve = process.ProcessReserve[mClockHand.fReserve];
+
+			// section frames are shared, they stay resident.
+			if (mClockHand.fOffset >= reserve.fSize || reserve.fSection)
+			{
+				mClockHand.fOffset = 0;
+				++mClockHand.fReserve;
+
+				continue;
+			}
+
+			VoidPtr page = reinterpret_cast<VoidPtr>(reserve.fStart + mClockHand.fOffset);
+			mClockHand.fOffset += kPageSize;
+
+			if (((UIntPtr)hal_read_cr3() & kPageAddressMask) != ((UIntPtr)reserve.fAddressSpace & kPageAddressMask))
+				HAL::hal_switch_address_space(reserve.fAddressSpace);
+
+			// unbacked, swapped, or accessed since the last turn.
+			if (HAL::mm_get_page_size(page) != kPageSize ||
+				HAL::mm_clear_accessed(page))
+				continue;
+
+			if (sched_swap_out(process, page))
+				++reclaimed;
+		}
+
+		if (((UIntPtr)hal_read_cr3() & kPageAddressMask) != ((UIntPtr)pd & kPageAddressMask))
+			HAL::hal_switch_address_space(pd);
+
+		__atomic_clear(&kSwapLock, __ATOMIC_RELEASE);
+
+		return reclaimed;
+#else
+		return 0;
+#endif
+	}
+
 	/// @brief Gets the current scheduled team.
 	/// @return
 	UserProcessTeam& UserProcessScheduler::CurrentTeam()
@@ -525,6 +1380,17 @@ namespace OpenNE
 		return kProcessScheduler.Run();
 	}
 
+	/***********************************************************************************/
+	/**
+	 * @brief Reclaim pages for the page allocator, see mm_set_reclaim.
+	 */
+	/***********************************************************************************/
+
+	SizeT UserProcessHelper::Reclaim(SizeT pages)
+	{
+		return kProcessScheduler.Reclaim(pages);
+	}
+
 	/***********************************************************************************/
 	/**
 	 * \brief Does a context switch in a CPU.
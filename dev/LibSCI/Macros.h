@@ -54,3 +54,4 @@ typedef IOObject  FSObject;
 typedef SCIObject DLLObject;
 typedef SCIObject ThreadObject;
 typedef SCIObject SocketObject;
+typedef SCIObject SectionObject;
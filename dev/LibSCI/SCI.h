@@ -135,6 +135,50 @@ IMPORT_C SInt64 MmStrCmp(_Input const Char* dest, _Input const Char* src);
 /// @brief Get length of string.
 IMPORT_C SInt64 MmStrLen(const Char* str);
 
+// ------------------------------------------------------------------------
+// Shared Section API.
+// ------------------------------------------------------------------------
+
+/// @brief Access of a section mapping.
+enum
+{
+	kSectionMapRead	 = 1 << 0,
+	kSectionMapWrite = 1 << 1,
+	kSectionMapExec	 = 1 << 2,
+};
+
+/// @brief Creates a named section of zeroed memory, other processes may open it by its name.
+/// @param name the name of the section.
+/// @param len the length of it.
+/// @return the section object, or nullptr if the name is taken.
+IMPORT_C SectionObject MmCreateSection(_Input const Char* name, _Input SizeT len);
+
+/// @brief Opens a section created by another process.
+/// @param name the name of the section.
+/// @return the section object, or nullptr if there's no such section.
+IMPORT_C SectionObject MmOpenSection(_Input const Char* name);
+
+/// @brief Closes a section object, the section stays while it is still mapped.
+/// @param section the section object.
+/// @return void.
+IMPORT_C Void MmCloseSection(_Input SectionObject section);
+
+/// @brief Gets the size of a section, rounded up to a page.
+/// @param section the section object.
+/// @return the size of it.
+IMPORT_C SizeT MmGetSectionSize(_Input SectionObject section);
+
+/// @brief Maps a whole section inside the process, every mapping has its own access.
+/// @param section the section object.
+/// @param flags kSectionMapRead, kSectionMapWrite and kSectionMapExec.
+/// @return the mapping, writes to it are seen by every other mapping.
+IMPORT_C VoidPtr MmMapSection(_Input SectionObject section, _Input UInt32 flags);
+
+/// @brief Unmaps a section, the last mapping and object of a section free it.
+/// @param mapping the mapping given by MmMapSection.
+/// @return void.
+IMPORT_C Void MmUnmapSection(_Input VoidPtr mapping);
+
 // ------------------------------------------------------------------------
 // Error API.
 // ------------------------------------------------------------------------
@@ -13,6 +13,9 @@
 
 #include <NewKit/Defines.h>
 
+/// @brief SRAT affinity flag, the entry is to be ignored without it.
+#define kSratEnabled (1U)
+
 namespace OpenNE
 {
 	class PACKED SDT
@@ -83,6 +86,70 @@ namespace OpenNE
 		UInt32 CreatorRevision;
 		UInt32 AddressArr[];
 	};
+
+	/// @brief System Resource Affinity Table, which cores and memory ranges belong to which proximity domain.
+	class PACKED SRAT final : public SDT
+	{
+	public:
+		UInt32 Reserved1;
+		UInt64 Reserved2;
+		UInt8  Entries[];
+	};
+
+	enum SRAT_ENTRY_KIND : UInt8
+	{
+		eSratLocalApic	 = 0,
+		eSratMemory		 = 1,
+		eSratLocalX2Apic = 2,
+	};
+
+	class PACKED SRAT_LOCAL_APIC final
+	{
+	public:
+		UInt8  Type;
+		UInt8  Length;
+		UInt8  DomainLow;
+		UInt8  ApicId;
+		UInt32 Flags;
+		UInt8  Sapic;
+		UInt8  DomainHigh[3];
+		UInt32 ClockDomain;
+	};
+
+	class PACKED SRAT_MEMORY final
+	{
+	public:
+		UInt8  Type;
+		UInt8  Length;
+		UInt32 Domain;
+		UInt16 Reserved1;
+		UInt64 Base;
+		UInt64 Size;
+		UInt32 Reserved2;
+		UInt32 Flags;
+		UInt64 Reserved3;
+	};
+
+	class PACKED SRAT_LOCAL_X2APIC final
+	{
+	public:
+		UInt8  Type;
+		UInt8  Length;
+		UInt16 Reserved1;
+		UInt32 Domain;
+		UInt32 X2ApicId;
+		UInt32 Flags;
+		UInt32 ClockDomain;
+		UInt32 Reserved2;
+	};
+
+	/// @brief System Locality Information Table, Entries[i * Localities + j] is the distance of domain i to j.
+	class PACKED SLIT final : public SDT
+	{
+	public:
+		UInt64 Localities;
+		UInt8  Entries[];
+	};
 } // namespace OpenNE
 
 #endif // !__ACPI__
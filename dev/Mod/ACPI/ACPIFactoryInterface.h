@@ -7,6 +7,7 @@
 #ifndef __MOD_ACPI_H__
 #define __MOD_ACPI_H__
 
+#include <ArchKit/ArchKit.h>
 #include <KernelKit/DebugOutput.h>
 #include <Mod/ACPI/ACPI.h>
 #include <NewKit/ErrorOr.h>
@@ -44,6 +45,11 @@ namespace OpenNE
 		/// @return if it succeed
 		bool Checksum(const Char* checksum, SSizeT len); // watch for collides!
 
+		/// @brief Memory locality factory, from the SRAT and SLIT.
+		/// @param topology filled with the nodes, their memory ranges, cores and distances.
+		/// @return if the SRAT gave at least one memory range.
+		Bool Topology(HAL::NUMA_TOPOLOGY& topology);
+
 	public:
 		ErrorOr<voidPtr> operator[](const Char* signature)
 		{
@@ -341,16 +341,16 @@ OpenNE::Boolean drv_std_detected(OpenNE::Void);
 /// @param buf
 /// @param sector_sz
 /// @param buf_sz
-/// @return
-OpenNE::Void drv_std_read(OpenNE::UInt64 lba, OpenNE::Char* buf, OpenNE::SizeT sector_sz, OpenNE::SizeT buf_sz);
+/// @return if the transfer was made.
+OpenNE::Boolean drv_std_read(OpenNE::UInt64 lba, OpenNE::Char* buf, OpenNE::SizeT sector_sz, OpenNE::SizeT buf_sz);
 
 /// @brief Write to AHCI disk.
 /// @param lba
 /// @param buf
 /// @param sector_sz
 /// @param buf_sz
-/// @return
-OpenNE::Void drv_std_write(OpenNE::UInt64 lba, OpenNE::Char* buf, OpenNE::SizeT sector_sz, OpenNE::SizeT buf_sz);
+/// @return if the transfer was made.
+OpenNE::Boolean drv_std_write(OpenNE::UInt64 lba, OpenNE::Char* buf, OpenNE::SizeT sector_sz, OpenNE::SizeT buf_sz);
 
 /// @brief Gets the sector count from AHCI disk.
 OpenNE::SizeT drv_get_sector_count();
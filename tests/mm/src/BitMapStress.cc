@@ -0,0 +1,247 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024-2025, Amlal EL Mahrouss, all rights reserved.
+
+------------------------------------------- */
+
+/// @file BitMapStress.cc
+/// @brief Host stress benchmark of the buddy page allocator (src/BitMapMgr.cc).
+/// The allocator is built as is, over a host buffer, the kernel services it calls are stubbed.
+/// It reports the latency of each operation and the fragmentation of the zone, then frees
+/// everything and checks the blocks merged back into the initial layout.
+/// Build: see bitmap_stress.json, or
+/// g++ -std=c++20 -O2 -fshort-wchar -fno-rtti -fno-exceptions -D__OPENNE_AMD64__ -D__OPENNE__
+///     -D__OPENNE_VIRTUAL_MEMORY_SUPPORT__ -I../../dev/Kernel -I../../dev src/BitMapStress.cc -o dist/bitmap_stress
+
+// the host headers come first, the kernel's macros (endl...) would clash with them.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <src/BitMapMgr.cc>
+
+/// @brief Pages handed to the allocator, 1 GiB.
+#define kStressZonePages (262144UL)
+
+/// @brief Operations to run, may be overridden by the first argument.
+#define kStressOpCount (3000000UL)
+
+/// @brief Live blocks kept at most, frees are forced past it.
+#define kStressMaxLive (16384UL)
+
+namespace OpenNE
+{
+	// kernel services used by the allocator, nothing is mapped on the host.
+	voidPtr rt_set_memory(voidPtr dst, UInt32 val, Size len)
+	{
+		UInt32* ptr = reinterpret_cast<UInt32*>(dst);
+
+		for (Size index = 0; index < len; ++index)
+			ptr[index] = val;
+
+		return dst;
+	}
+
+	namespace HAL
+	{
+		UInt32 hal_apic_id() noexcept
+		{
+			return 0U;
+		}
+	} // namespace HAL
+} // namespace OpenNE
+
+EXTERN_C OpenNE::Int32 mm_map_range(OpenNE::VoidPtr virtual_address, OpenNE::VoidPtr physical_address, OpenNE::SizeT size, OpenNE::UInt32 flags)
+{
+	return 0;
+}
+
+namespace
+{
+	using namespace OpenNE;
+
+	struct STRESS_BLOCK final
+	{
+		VoidPtr fPtr;
+		SizeT	fSize;
+	};
+
+	struct STRESS_FRAG final
+	{
+		SizeT fFreePages;
+		SizeT fFreeBlocks;
+		SizeT fLargestOrder;
+		SizeT fCounts[kBitMapMaxOrder + 1];
+	};
+
+	/// @brief Walk the free lists of the zone.
+	STRESS_FRAG stress_frag()
+	{
+		STRESS_FRAG frag{};
+
+		HAL::Detail::BITMAP_ZONE& zone = HAL::Detail::kBitMapZone[0];
+
+		frag.fFreePages = zone.fFreePages;
+
+		for (SizeT order = 0; order <= kBitMapMaxOrder; ++order)
+		{
+			for (auto block = zone.fFreeList[order]; block; block = block->fNext)
+				++frag.fCounts[order];
+
+			frag.fFreeBlocks += frag.fCounts[order];
+
+			if (frag.fCounts[order])
+				frag.fLargestOrder = order;
+		}
+
+		return frag;
+	}
+
+	Void stress_print_frag(const Char* when, const STRESS_FRAG& frag)
+	{
+		// share of the free pages the largest free block could hand out at once.
+		double usable = frag.fFreePages ? double(1UL << frag.fLargestOrder) / double(frag.fFreePages) : 0.0;
+
+		std::printf("%s: free pages %zu, free blocks %zu, largest order %zu, largest/free %.4f\n",
+					when, (size_t)frag.fFreePages, (size_t)frag.fFreeBlocks, (size_t)frag.fLargestOrder, usable);
+	}
+
+	/// @brief Mostly single pages, some small runs, a few big blocks.
+	SizeT stress_size(std::mt19937_64& rng)
+	{
+		UInt32 roll = rng() % 100;
+
+		if (roll < 60)
+			return kPageSize;
+
+		if (roll < 90)
+			return (1 + rng() % 16) * kPageSize;
+
+		if (roll < 99)
+			return (16 + rng() % 240) * kPageSize;
+
+		return (256 + rng() % 3840) * kPageSize;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	SizeT ops = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : kStressOpCount;
+
+	VoidPtr zone = std::aligned_alloc(kPageSize, kStressZonePages * kPageSize);
+
+	if (!zone || !HAL::mm_init_bitmap(zone, kStressZonePages * kPageSize))
+	{
+		std::printf("bitmap_stress: can't setup the zone.\n");
+		return EXIT_FAILURE;
+	}
+
+	const STRESS_FRAG cInitial = stress_frag();
+	stress_print_frag("initial", cInitial);
+
+	std::mt19937_64			  rng(0x4F70656E4E45ULL);
+	std::vector<STRESS_BLOCK> live;
+	std::vector<UInt64>		  samples;
+
+	live.reserve(kStressMaxLive);
+	samples.reserve(ops);
+
+	SizeT allocs = 0UL, frees = 0UL, failures = 0UL, corrupt = 0UL;
+
+	for (SizeT op = 0; op < ops; ++op)
+	{
+		Bool do_alloc = live.empty() || (live.size() < kStressMaxLive && (rng() & 1));
+
+		if (do_alloc)
+		{
+			SizeT size = stress_size(rng);
+
+			auto	start = std::chrono::steady_clock::now();
+			VoidPtr ptr	  = HAL::mm_alloc_bitmap(Yes, No, size, Yes);
+			auto	end	  = std::chrono::steady_clock::now();
+
+			samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+			if (!ptr)
+			{
+				++failures;
+				continue;
+			}
+
+			// blocks are whole pages, aligned on their size from the base.
+			if (HAL::mm_size_of_bitmap(ptr) < size || !HAL::mm_is_bitmap(ptr))
+				++corrupt;
+
+			// the allocator keeps nothing inside, so the whole block is ours to write.
+			std::memset(ptr, 0xAB, size);
+
+			live.push_back({ptr, size});
+			++allocs;
+		}
+		else
+		{
+			SizeT		 index = rng() % live.size();
+			STRESS_BLOCK block = live[index];
+
+			live[index] = live.back();
+			live.pop_back();
+
+			auto start = std::chrono::steady_clock::now();
+			Bool freed = HAL::mm_free_bitmap(block.fPtr);
+			auto end   = std::chrono::steady_clock::now();
+
+			samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+			if (!freed)
+				++corrupt;
+
+			++frees;
+		}
+	}
+
+	STRESS_FRAG loaded = stress_frag();
+
+	std::sort(samples.begin(), samples.end());
+
+	UInt64 total = 0UL;
+
+	for (UInt64 sample : samples)
+		total += sample;
+
+	std::printf("ops %zu, allocs %zu, frees %zu, failures %zu, corrupt %zu, live %zu\n",
+				(size_t)ops, (size_t)allocs, (size_t)frees, (size_t)failures, (size_t)corrupt, (size_t)live.size());
+
+	if (!samples.empty())
+	{
+		std::printf("latency ns: mean %.1f, p50 %llu, p99 %llu, max %llu\n",
+					double(total) / double(samples.size()),
+					(unsigned long long)samples[samples.size() / 2],
+					(unsigned long long)samples[samples.size() * 99 / 100],
+					(unsigned long long)samples.back());
+	}
+
+	stress_print_frag("loaded", loaded);
+
+	for (auto& block : live)
+	{
+		if (!HAL::mm_free_bitmap(block.fPtr))
+			++corrupt;
+	}
+
+	STRESS_FRAG drained = stress_frag();
+	stress_print_frag("drained", drained);
+
+	// everything was given back, so every buddy must have merged again.
+	Bool merged = drained.fFreePages == cInitial.fFreePages &&
+				  std::memcmp(drained.fCounts, cInitial.fCounts, sizeof(cInitial.fCounts)) == 0;
+
+	std::printf("bitmap_stress: %s\n", (merged && !corrupt) ? "pass" : "FAIL");
+
+	std::free(zone);
+
+	return (merged && !corrupt) ? EXIT_SUCCESS : EXIT_FAILURE;
+}